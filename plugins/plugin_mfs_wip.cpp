@@ -6,11 +6,16 @@
 #include <solanaceae/object_store/backends/filesystem_storage_atomic.hpp>
 #include <solanaceae/message_fragment_store/message_fragment_store.hpp>
 
+#include <solanaceae/util/utils.hpp>
+
 #include <entt/entt.hpp>
 #include <entt/fwd.hpp>
 
 #include <memory>
 #include <limits>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <iostream>
 
 static std::unique_ptr<Backends::FilesystemStorageAtomic> g_fsb = nullptr;
@@ -18,6 +23,49 @@ static std::unique_ptr<MessageFragmentStore> g_mfs = nullptr;
 
 constexpr const char* plugin_name = "MessageFragmentStore";
 
+constexpr const char* store_path = "test2_message_store/"; // TODO: use config?
+
+// <store>suffix, next to the store, not in it (the backend scans everything in there)
+static std::filesystem::path nextToStore(const char* suffix) {
+	std::filesystem::path path{store_path};
+	if (!path.has_filename()) {
+		path = path.parent_path(); // trailing slash
+	}
+	path += suffix;
+	return path;
+}
+
+// global.zdict is the default, <contact id hex>.zdict is contact specific
+// (see train_message_fragment_dict)
+static void loadDictionaries(MessageFragmentStore& mfs, const std::filesystem::path& dict_path) {
+	std::error_code ec;
+	if (!std::filesystem::is_directory(dict_path, ec)) {
+		return;
+	}
+
+	for (const auto& entry : std::filesystem::directory_iterator(dict_path, ec)) {
+		if (!entry.is_regular_file() || entry.path().extension() != ".zdict") {
+			continue;
+		}
+
+		std::ifstream file(entry.path(), std::ios::binary);
+		const std::vector<uint8_t> data{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+
+		const auto dict_id = mfs.addDictionary(ByteSpan{data});
+		if (dict_id == 0) {
+			std::cerr << "PLUGIN " << plugin_name << " failed to load dictionary " << entry.path() << "\n";
+			continue;
+		}
+
+		const auto stem = entry.path().stem().string();
+		if (stem == "global") {
+			mfs.setDictionary(dict_id);
+		} else {
+			mfs.setContactDictionary(hex2bin(stem), dict_id);
+		}
+	}
+}
+
 extern "C" {
 
 SOLANA_PLUGIN_EXPORT const char* solana_plugin_get_name(void) {
@@ -43,9 +91,22 @@ SOLANA_PLUGIN_EXPORT uint32_t solana_plugin_start(struct SolanaAPI* solana_api)
 
 		// static store, could be anywhere tho
 		// construct with fetched dependencies
-		g_fsb = std::make_unique<Backends::FilesystemStorageAtomic>(*os, "test2_message_store/"); // TODO: use config?
+		g_fsb = std::make_unique<Backends::FilesystemStorageAtomic>(*os, store_path);
 		g_mfs = std::make_unique<MessageFragmentStore>(*cs, *rmm, *os, *g_fsb, *g_fsb, *msnj);
 
+		// workers read and write the same files with their own backend
+		g_mfs->enableLoaderPool([](ObjectStore2& worker_os) {
+			return std::make_shared<Backends::FilesystemStorageAtomic>(worker_os, store_path);
+		});
+		g_mfs->enableWriteBehind([](ObjectStore2& worker_os) {
+			return std::make_shared<Backends::FilesystemStorageAtomic>(worker_os, store_path);
+		});
+
+		loadDictionaries(*g_mfs, nextToStore(".dicts"));
+
+		// next to the store, not in it
+		g_mfs->enableCatalog(nextToStore(".catalog"), store_path);
+
 		// register types
 		PLUG_PROVIDE_INSTANCE(MessageFragmentStore, plugin_name, g_mfs.get());
 	} catch (const ResolveException& e) {
@@ -67,7 +128,10 @@ SOLANA_PLUGIN_EXPORT float solana_plugin_tick(float time_delta) {
 	// HACK
 	static bool scan_triggered {false};
 	if (!scan_triggered) {
-		g_fsb->scanAsync();
+		// only scan if the catalog is missing or stale
+		if (!g_mfs->loadCatalog()) {
+			g_fsb->scanAsync();
+		}
 		scan_triggered = true;
 	}
 
@@ -1,73 +1,445 @@
-#include <solanaceae/contact/contact_store_impl.hpp>
 #include <solanaceae/object_store/object_store.hpp>
 #include <solanaceae/object_store/backends/filesystem_storage_atomic.hpp>
 #include <solanaceae/object_store/meta_components.hpp>
 #include <solanaceae/object_store/serializer_json.hpp>
 #include <solanaceae/message_fragment_store/message_fragment_store.hpp>
-#include <solanaceae/message3/message_serializer.hpp>
-
-#include <solanaceae/message3/registry_message_model_impl.hpp>
+#include <solanaceae/message_fragment_store/fragment_codec.hpp>
+#include <solanaceae/message_fragment_store/object_snapshot.hpp>
 
 #include <solanaceae/util/utils.hpp>
 
-#include <nlohmann/json.hpp>
+#include <entt/container/dense_set.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <cassert>
 
+// copies every object from input to output, discarding empty message fragments
+// and upconverting v1 (json) fragments to v2 (msgpack)
+// the scan only snapshots the objects, workers read, transcode, compress and write them,
+// each with their own stores and backends (the object registry is not thread safe)
+// finished objects are appended to a journal, so an interrupted run can be resumed
+// (objects in the journal are skipped, anything else already in the output is unfinished and overwritten)
+
+struct Job {
+	ObjectSnapshot snapshot; // with serialized, for the meta
+};
+
+struct Done {
+	std::vector<uint8_t> id;
+
+	enum class Status : uint8_t {
+		converted,
+		discarded, // empty
+		failed,
+	} status {Status::failed};
+
+	size_t bytes_read {0};
+	size_t bytes_written {0}; // uncompressed
+};
+
+class Converter {
+	const std::filesystem::path _src_path;
+	const std::filesystem::path _dst_path;
+
+	std::mutex _mutex;
+	std::condition_variable _cv; // for workers
+	std::condition_variable _cv_space; // for the scan
+	std::deque<Job> _queue;
+	std::vector<Done> _done;
+	bool _scan_done {false};
+	const size_t _max_queued;
+
+	std::vector<std::thread> _workers;
+
+	public:
+		Converter(std::filesystem::path src_path, std::filesystem::path dst_path, size_t worker_count) :
+			_src_path(std::move(src_path)),
+			_dst_path(std::move(dst_path)),
+			_max_queued(worker_count*8) // bounds memory, snapshots are small
+		{
+			for (size_t i = 0; i < worker_count; i++) {
+				_workers.emplace_back([this]() { workerMain(); });
+			}
+		}
+
+		~Converter(void) {
+			finish();
+		}
+
+		// blocks while the queue is full
+		void submit(Job&& job) {
+			std::unique_lock lk{_mutex};
+			_cv_space.wait(lk, [this]() { return _queue.size() < _max_queued; });
+			_queue.push_back(std::move(job));
+			lk.unlock();
+			_cv.notify_one();
+		}
+
+		// no more jobs, workers exit once the queue is empty
+		void finish(void) {
+			{
+				std::lock_guard lg{_mutex};
+				if (_scan_done) {
+					return;
+				}
+				_scan_done = true;
+			}
+			_cv.notify_all();
+
+			for (auto& worker : _workers) {
+				worker.join();
+			}
+		}
+
+		std::vector<Done> collect(void) {
+			std::vector<Done> done;
+			std::lock_guard lg{_mutex};
+			done.swap(_done);
+			return done;
+		}
+
+	private:
+		// files of an unfinished object, eg. written right before a crash
+		// (same layout as the filesystem backend)
+		void removeOutputObject(const std::vector<uint8_t>& id) const {
+			const auto id_hex = bin2hex(id);
+			std::filesystem::path object_file_path;
+			if (id_hex.size() < 6) {
+				object_file_path = _dst_path / id_hex;
+			} else {
+				object_file_path = std::filesystem::path{_dst_path.string() + id_hex.substr(0, 2)} / id_hex.substr(2);
+			}
+
+			std::error_code ec;
+			for (const char* suffix : {"", ".meta.msgpack", ".meta.json"}) {
+				auto path = object_file_path;
+				path += suffix;
+				std::filesystem::remove(path, ec);
+			}
+		}
+
+		void workerMain(void) {
+			ObjectStore2 os_src;
+			ObjectStore2 os_dst;
+			MessageFragmentStore::registerSerializers(os_src.registry().ctx().get<SerializerJsonCallbacks<Object>>());
+			MessageFragmentStore::registerSerializers(os_dst.registry().ctx().get<SerializerJsonCallbacks<Object>>());
+
+			Backends::FilesystemStorageAtomic fsb_src(os_src, _src_path.string());
+			Backends::FilesystemStorageAtomic fsb_dst(os_dst, _dst_path.string());
+
+			std::vector<uint8_t> data;
+			std::vector<uint8_t> transcoded;
+			DecodedMessages msgs;
+			MessagesMsgPackWriter msgpack_writer;
+
+			while (true) {
+				Job job;
+				{
+					std::unique_lock lk{_mutex};
+					_cv.wait(lk, [this]() { return _scan_done || !_queue.empty(); });
+					if (_queue.empty()) {
+						return; // scan done
+					}
+
+					job = std::move(_queue.front());
+					_queue.pop_front();
+				}
+				_cv_space.notify_one();
+
+				Done done;
+				done.id = job.snapshot.id;
+
+				data.clear();
+				auto src_oh = job.snapshot.apply(os_src);
+				std::function<StorageBackendIAtomic::read_from_storage_put_data_cb> cb = [&data](const ByteSpan buffer) {
+					data.insert(data.end(), buffer.cbegin(), buffer.cend());
+				};
+				const bool read_ok = static_cast<StorageBackendIAtomic&>(fsb_src).read(src_oh, cb);
+				const bool has_dict = src_oh.all_of<ObjComp::MessagesDictionary>();
+				uint16_t version = src_oh.all_of<ObjComp::MessagesVersion>() ? src_oh.get<ObjComp::MessagesVersion>().v : ObjComp::MessagesVersion{}.v;
+				src_oh.destroy();
+
+				done.bytes_read = data.size();
+
+				if (!read_ok) {
+					std::cerr << "failed to read obj '" << bin2hex(done.id) << "'\n";
+					pushDone(std::move(done));
+					continue;
+				}
+
+				// dictionary compressed data is copied as is
+				if (data.empty()) {
+					done.status = Done::Status::discarded;
+				} else if (!has_dict && version == 1) {
+					// parsed once, for both the empty check and the upconvert
+					msgs.components.clear();
+					msgs.entry_ends.clear();
+					if (!decodeMessages(1, ByteSpan{data}, msgs)) {
+						std::cerr << "failed to parse v1 obj '" << bin2hex(done.id) << "'\n";
+						pushDone(std::move(done));
+						continue;
+					}
+
+					if (msgs.entry_ends.empty()) {
+						done.status = Done::Status::discarded;
+					} else {
+						// v1 to v2
+						transcoded.clear();
+						msgpack_writer.beginArray(transcoded, msgs.entry_ends.size());
+						size_t comp_i {0};
+						for (const size_t entry_end : msgs.entry_ends) {
+							msgpack_writer.beginEntry();
+							for (; comp_i < entry_end; comp_i++) {
+								const auto& comp = msgs.components.at(comp_i);
+								msgpack_writer.component(comp.type_id, comp.name, comp.value);
+							}
+							msgpack_writer.endEntry(transcoded);
+						}
+						data.swap(transcoded);
+						version = 2;
+					}
+				} else if (!has_dict && version == 2 && data.size() == 1 && data.front() == 0x90) {
+					// empty msgpack array, eg. left behind by fragment compaction
+					done.status = Done::Status::discarded;
+				} else if (!has_dict && version == 3 && data.size() == 2 && data.at(0) == 0 && data.at(1) == 0) {
+					// empty columnar, no messages and no columns
+					done.status = Done::Status::discarded;
+				}
+
+				if (done.status == Done::Status::discarded) {
+					pushDone(std::move(done));
+					continue;
+				}
+
+				// we dont copy meta file type, it will be the same for all "new" objects
+				auto dst_oh = fsb_dst.newObject(ByteSpan{done.id});
+				if (!static_cast<bool>(dst_oh)) {
+					// not in the journal, so not finished
+					removeOutputObject(done.id);
+					dst_oh = fsb_dst.newObject(ByteSpan{done.id});
+				}
+				if (!static_cast<bool>(dst_oh)) {
+					std::cerr << "failed to create obj '" << bin2hex(done.id) << "' in output\n";
+					pushDone(std::move(done));
+					continue;
+				}
+
+				{ // sync meta
+					// some hardcoded ehpemeral (besides mft/id)
+					const auto& known = job.snapshot.known.comps;
+					dst_oh.emplace_or_replace<ObjComp::Ephemeral::MetaEncryptionType>(std::get<std::optional<ObjComp::Ephemeral::MetaEncryptionType>>(known).value_or(ObjComp::Ephemeral::MetaEncryptionType{}));
+					dst_oh.emplace_or_replace<ObjComp::Ephemeral::MetaCompressionType>(std::get<std::optional<ObjComp::Ephemeral::MetaCompressionType>>(known).value_or(ObjComp::Ephemeral::MetaCompressionType{}));
+
+					// serializable, plain copies where possible
+					job.snapshot.applyMeta(dst_oh);
+					dst_oh.emplace_or_replace<ObjComp::MessagesVersion>(version);
+				}
+
+				if (static_cast<StorageBackendIAtomic&>(fsb_dst).write(dst_oh, ByteSpan{data})) {
+					done.status = Done::Status::converted;
+					done.bytes_written = data.size();
+				} else {
+					std::cerr << "failed to write obj '" << bin2hex(done.id) << "'\n";
+				}
+				dst_oh.destroy();
+
+				pushDone(std::move(done));
+			}
+		}
+
+		void pushDone(Done&& done) {
+			std::lock_guard lg{_mutex};
+			_done.push_back(std::move(done));
+		}
+};
+
+// hex ids, one per line, appended as objects finish
+class Journal {
+	std::filesystem::path _path;
+	std::ofstream _file;
+	entt::dense_set<std::string> _finished;
+
+	public:
+		explicit Journal(std::filesystem::path path) : _path(std::move(path)) {
+			std::ifstream file(_path);
+			std::string line;
+			while (std::getline(file, line)) {
+				// a torn last line just does not match anything
+				if (!line.empty()) {
+					_finished.emplace(std::move(line));
+				}
+			}
+			file.close();
+
+			_file.open(_path, std::ios::app);
+		}
+
+		bool good(void) const { return _file.good(); }
+		size_t size(void) const { return _finished.size(); }
+
+		bool finished(const std::string& id_hex) const {
+			return _finished.contains(id_hex);
+		}
+
+		void append(const std::string& id_hex) {
+			_file << id_hex << '\n';
+		}
+
+		void flush(void) {
+			_file.flush();
+		}
+
+		// after a clean run
+		void remove(void) {
+			_file.close();
+			std::error_code ec;
+			std::filesystem::remove(_path, ec);
+		}
+};
+
+struct Progress {
+	using clock = std::chrono::steady_clock;
+
+	const clock::time_point start {clock::now()};
+	clock::time_point next_report {start + std::chrono::seconds{1}};
+
+	size_t scanned {0};
+	size_t resumed {0}; // skipped, in the journal
+	size_t converted {0};
+	size_t discarded {0};
+	size_t failed {0};
+	size_t bytes_read {0};
+	size_t bytes_written {0};
+
+	void add(const Done& done) {
+		switch (done.status) {
+			case Done::Status::converted: converted++; break;
+			case Done::Status::discarded: discarded++; break;
+			case Done::Status::failed: failed++; break;
+		}
+		bytes_read += done.bytes_read;
+		bytes_written += done.bytes_written;
+	}
+
+	size_t finished(void) const {
+		return converted + discarded + failed;
+	}
+
+	void report(void) const {
+		const double seconds = std::max(std::chrono::duration<double>(clock::now() - start).count(), 0.001);
+		std::cout
+			<< finished() << "/" << scanned << " objs"
+			<< " (converted " << converted
+			<< ", discarded " << discarded
+			<< ", failed " << failed
+			<< ", resumed " << resumed
+			<< ") " << static_cast<size_t>(finished()/seconds) << " objs/s, "
+			<< bytes_read/seconds/(1024*1024) << " MiB/s read, "
+			<< bytes_written/seconds/(1024*1024) << " MiB/s written (uncompressed)\n"
+		;
+	}
+
+	void maybeReport(void) {
+		const auto now = clock::now();
+		if (now >= next_report) {
+			report();
+			next_report = now + std::chrono::seconds{1};
+		}
+	}
+};
+
 int main(int argc, const char** argv) {
-	if (argc != 3) {
-		std::cerr << "wrong paramter count, do " << argv[0] << " <input_folder> <output_folder>\n";
+	if (argc < 3) {
+		std::cerr << "wrong paramter count, do " << argv[0] << " <input_folder> <output_folder> [--threads <n>] [--journal <path>]\n";
 		return 1;
 	}
 
 	if (!std::filesystem::is_directory(argv[1])) {
 		std::cerr << "input folder is no folder\n";
+		return 1;
 	}
 
 	std::filesystem::create_directories(argv[2]);
 
-	// we are going to use 2 different OS for convineance, but could be done with 1 too
-	ObjectStore2 os_src;
-	ObjectStore2 os_dst;
+	// next to the output, so it is not mistaken for an object
+	auto out_dir = std::filesystem::absolute(argv[2]).lexically_normal();
+	if (!out_dir.has_filename()) {
+		out_dir = out_dir.parent_path(); // trailing separator
+	}
+	std::filesystem::path journal_path = out_dir;
+	journal_path += ".convert_journal";
+
+	size_t worker_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+	for (int i = 3; i < argc; i++) {
+		const std::string_view arg{argv[i]};
+		if (arg == "--threads" && i+1 < argc) {
+			worker_count = std::max<size_t>(std::stoull(argv[++i]), 1);
+		} else if (arg == "--journal" && i+1 < argc) {
+			journal_path = argv[++i];
+		} else {
+			std::cerr << "unknown argument '" << arg << "'\n";
+			return 1;
+		}
+	}
 
+	Journal journal{journal_path};
+	if (!journal.good()) {
+		std::cerr << "failed to open journal " << journal_path << "\n";
+		return 1;
+	}
+	if (journal.size() > 0) {
+		std::cout << "resuming, " << journal.size() << " objs already done according to " << journal_path << "\n";
+	}
+
+	ObjectStore2 os_src;
+	// for the snapshots, json only for components without a copy
+	MessageFragmentStore::registerSerializers(os_src.registry().ctx().get<SerializerJsonCallbacks<Object>>());
+	MessageFragmentStore::registerCopies(os_src.registry().ctx().emplace<ComponentCopyCallbacks>());
 	Backends::FilesystemStorageAtomic fsb_src(os_src, argv[1]);
-	Backends::FilesystemStorageAtomic fsb_dst(os_dst, argv[2]);
 
-	ContactStore4Impl cs; // dummy
-	RegistryMessageModelImpl rmm(cs); // dummy
-	// they only exist for the serializers (for now)
-	// TODO: version
-	MessageSerializerNJ msnj_src{cs, os_src, {}, {}};
-	MessageFragmentStore mfs_src(cs, rmm, os_src, fsb_src, fsb_src, msnj_src);
-	MessageSerializerNJ msnj_dst{cs, os_dst, {}, {}};
-	MessageFragmentStore mfs_dst(cs, rmm, os_dst, fsb_dst, fsb_dst, msnj_dst);
+	Converter converter{argv[1], argv[2], worker_count};
+	Progress progress;
+
+	const std::function<void(void)> drain = [&]() {
+		for (const auto& done : converter.collect()) {
+			progress.add(done);
+
+			if (done.status == Done::Status::discarded) {
+				std::cerr << "discarded empty obj '" << bin2hex(done.id) << "'\n";
+			}
 
-	// add message fragment store too (adds meta?)
+			// failed ones are retried on the next run
+			if (done.status != Done::Status::failed) {
+				journal.append(bin2hex(done.id));
+			}
+		}
+		journal.flush();
+		progress.maybeReport();
+	};
 
-	// hookup events
+	// the scan thread only snapshots
 	struct EventListener : public ObjectStoreEventI {
-		ObjectStore2& _os_src;
-		Backends::FilesystemStorageAtomic& _fsb_src;
-
-		ObjectStore2& _os_dst;
-		Backends::FilesystemStorageAtomic& _fsb_dst;
-
-		EventListener(
-			ObjectStore2& os_src,
-			Backends::FilesystemStorageAtomic& fsb_src,
-			ObjectStore2& os_dst,
-			Backends::FilesystemStorageAtomic& fsb_dst
-		) :
-			_os_src(os_src),
-			_fsb_src(fsb_src),
-			_os_dst(os_dst),
-			_fsb_dst(fsb_dst)
+		Converter& _converter;
+		Journal& _journal;
+		Progress& _progress;
+		const std::function<void(void)>& _drain;
+
+		EventListener(ObjectStore2& os, Converter& converter, Journal& journal, Progress& progress, const std::function<void(void)>& drain) :
+			_converter(converter), _journal(journal), _progress(progress), _drain(drain)
 		{
-			_os_src.subscribe(this, ObjectStore_Event::object_construct);
-			_os_src.subscribe(this, ObjectStore_Event::object_update);
+			os.subscribe(this, ObjectStore_Event::object_construct);
 		}
 
 		protected: // os
@@ -75,96 +447,40 @@ int main(int argc, const char** argv) {
 				assert(e.e.all_of<ObjComp::Ephemeral::MetaFileType>());
 				assert(e.e.all_of<ObjComp::ID>());
 
-				// !! we read the obj first, so we can discard empty objects
-				// technically we could just copy the file, but meh
-				// read src and write dst data
-				std::vector<uint8_t> tmp_buffer;
-				std::function<StorageBackendIAtomic::read_from_storage_put_data_cb> cb = [&tmp_buffer](const ByteSpan buffer) {
-					tmp_buffer.insert(tmp_buffer.end(), buffer.cbegin(), buffer.cend());
-				};
-				if (!_fsb_src.read(e.e, cb)) {
-					std::cerr << "failed to read obj '" << bin2hex(e.e.get<ObjComp::ID>().v) << "'\n";
-					return false;
-				}
-
-				if (tmp_buffer.empty()) {
-					std::cerr << "discarded empty obj '" << bin2hex(e.e.get<ObjComp::ID>().v) << "'\n";
-					return false;
-				}
-				{ // try getting lucky and see if its an empty json
-					const auto j = nlohmann::json::parse(tmp_buffer, nullptr, false);
-					if (j.is_array() && j.empty()) {
-						std::cerr << "discarded empty json array obj '" << bin2hex(e.e.get<ObjComp::ID>().v) << "'\n";
-						return false;
-					}
-				}
-
-				// WARNING: manual and hardcoded
-				// manually upconvert message json to msgpack (v1 to v2)
-				if (true && e.e.get<ObjComp::MessagesVersion>().v == 1) {
-					// TODO: error handling
-					const auto j = nlohmann::json::parse(tmp_buffer);
-
-					if (true) {
-						e.e.replace<ObjComp::MessagesVersion>(uint16_t(2));
-
-						// overwrite og
-						tmp_buffer = nlohmann::json::to_msgpack(j);
-					}
-				}
-
-				// we dont copy meta file type, it will be the same for all "new" objects
-				auto oh = _fsb_dst.newObject(ByteSpan{e.e.get<ObjComp::ID>().v});
+				_progress.scanned++;
 
-				if (!static_cast<bool>(oh)) {
-					// already exists
-					return false;
+				if (_journal.finished(bin2hex(e.e.get<ObjComp::ID>().v))) {
+					_progress.resumed++;
+				} else {
+					_converter.submit(Job{ObjectSnapshot::take(e.e, true)});
 				}
 
-				{ // sync meta
-					// some hardcoded ehpemeral (besides mft/id)
-					oh.emplace_or_replace<ObjComp::Ephemeral::MetaEncryptionType>(e.e.get_or_emplace<ObjComp::Ephemeral::MetaEncryptionType>());
-					oh.emplace_or_replace<ObjComp::Ephemeral::MetaCompressionType>(e.e.get_or_emplace<ObjComp::Ephemeral::MetaCompressionType>());
-
-					// serializable
-					for (const auto& [type, fn] : _os_src.registry().ctx().get<SerializerJsonCallbacks<Object>>()._serl) {
-						//if (!e.e.registry()->storage(type)->contains(e.e)) {
-							//continue;
-						//}
-
-						// this is hacky but we serialize and then deserialize the component
-						// raw copy might be better in the future
-						nlohmann::json tmp_j;
-						if (fn(e.e, tmp_j)) {
-							_os_dst.registry().ctx().get<SerializerJsonCallbacks<Object>>()._deserl.at(type)(oh, tmp_j);
-						}
-					}
-				}
-
-				static_cast<StorageBackendIAtomic&>(_fsb_dst).write(oh, ByteSpan{tmp_buffer});
-
-				//assert(std::filesystem::file_size(e.e.get<ObjComp::Ephemeral::FilePath>().path) == std::filesystem::file_size(oh.get<ObjComp::Ephemeral::FilePath>().path));
+				_drain();
 
+				// we dont need the objects after
 				return false;
 			}
 
 			bool onEvent(const ObjectStore::Events::ObjectUpdate&) override {
-				std::cerr << "Update called\n";
-				assert(false);
 				return false;
 			}
-	} el {
-		os_src,
-		fsb_src,
-		os_dst,
-		fsb_dst,
 	};
+	EventListener el{os_src, converter, journal, progress, drain};
 
 	// perform scan (which triggers events)
-	fsb_dst.scanAsync(); // fill with existing?
-	fsb_src.scanAsync(); // the scan
+	fsb_src.scanAsync();
+
+	converter.finish();
+	drain();
+	progress.report();
+
+	if (progress.failed > 0) {
+		std::cerr << progress.failed << " objs failed, run again to retry them (journal " << journal_path << ")\n";
+		return 2;
+	}
+
+	journal.remove();
 
 	// done
 	return 0;
 }
-
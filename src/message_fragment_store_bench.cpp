@@ -0,0 +1,359 @@
+#include <solanaceae/object_store/object_store.hpp>
+#include <solanaceae/object_store/meta_components.hpp>
+#include <solanaceae/message_fragment_store/meta_messages_components.hpp>
+#include <solanaceae/message_fragment_store/internal_mfs_contexts.hpp>
+#include <solanaceae/message_fragment_store/fragment_codec.hpp>
+#include <solanaceae/message3/components.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <entt/core/hashed_string.hpp>
+#include <entt/core/type_info.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// microbenchmarks for the mfs hot paths
+// prints one json object per line (json lines), so runs can be diffed or plotted across commits:
+//   {"bench":"<name>","n":<problem size>,"iterations":..,"ns_per_op":..[,"mib_per_s":..,"bytes":..]}
+// usage: solanaceae_message_fragment_store_bench [name filter] [--min-time <ms>]
+
+using clock_type = std::chrono::steady_clock;
+
+struct Bench {
+	std::string filter;
+	double min_time_s {0.2};
+
+	bool wanted(std::string_view name) const {
+		return filter.empty() || name.find(filter) != std::string_view::npos;
+	}
+
+	// runs fn (ops operations per call) until min_time is reached
+	// bytes is per call, for throughput
+	void run(std::string_view name, size_t n, size_t ops, size_t bytes, const std::function<void(void)>& fn) const {
+		if (!wanted(name)) {
+			return;
+		}
+
+		fn(); // warmup
+
+		size_t iterations {0};
+		const auto start = clock_type::now();
+		double elapsed {0.0};
+		do {
+			fn();
+			iterations++;
+			elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+		} while (elapsed < min_time_s);
+
+		nlohmann::json j {
+			{"bench", name},
+			{"n", n},
+			{"iterations", iterations},
+			{"ns_per_op", elapsed * 1e9 / static_cast<double>(iterations * ops)},
+		};
+		if (bytes > 0) {
+			j["bytes"] = bytes;
+			j["mib_per_s"] = static_cast<double>(bytes * iterations) / elapsed / (1024.0*1024.0);
+		}
+		std::cout << j.dump() << std::endl;
+	}
+};
+
+// prevents the compiler from dropping results
+static volatile uint64_t g_sink {0};
+static void keep(uint64_t v) {
+	g_sink = g_sink + v;
+}
+
+static void benchContactFragments(const Bench& bench, size_t n) {
+	ObjectStore2 os;
+	std::mt19937_64 rng{n};
+
+	// fragments of ~1h, slightly overlapping, in random insert order
+	std::vector<Object> frags;
+	frags.reserve(n);
+	for (size_t i = 0; i < n; i++) {
+		ObjectHandle oh{os.registry(), os.registry().create()};
+		const uint64_t begin = i * 3600*1000;
+		oh.emplace<ObjComp::MessagesTSRange>(begin, begin + 3600*1000 + rng()%(60*1000));
+		std::vector<uint8_t> id(32);
+		for (auto& byte : id) {
+			byte = static_cast<uint8_t>(rng());
+		}
+		oh.emplace<ObjComp::ID>(std::move(id));
+		frags.push_back(oh);
+	}
+	std::shuffle(frags.begin(), frags.end(), rng);
+
+	const auto fill = [&](Message::Contexts::ContactFragments& cf) {
+		for (const auto frag : frags) {
+			cf.insert(ObjectHandle{os.registry(), frag});
+		}
+	};
+
+	bench.run("contact_fragments.insert", n, n, 0, [&]() {
+		Message::Contexts::ContactFragments cf;
+		fill(cf);
+		keep(cf.size());
+	});
+
+	bench.run("contact_fragments.erase", n, n, 0, [&]() {
+		// includes the fill, see insert
+		Message::Contexts::ContactFragments cf;
+		fill(cf);
+		for (const auto frag : frags) {
+			cf.erase(frag);
+		}
+		keep(cf.size());
+	});
+
+	Message::Contexts::ContactFragments cf;
+	fill(cf);
+
+	bench.run("contact_fragments.prev", n, n, 0, [&]() {
+		size_t steps {0};
+		for (Object frag = cf.back(); frag != entt::null; frag = cf.prev(frag)) {
+			steps++;
+		}
+		keep(steps);
+	});
+
+	bench.run("contact_fragments.next", n, n, 0, [&]() {
+		size_t steps {0};
+		for (Object frag = cf.front(); frag != entt::null; frag = cf.next(frag)) {
+			steps++;
+		}
+		keep(steps);
+	});
+
+	const uint64_t ts_max = n * 3600*1000;
+	std::vector<Object> out;
+	bench.run("contact_fragments.overlapping", n, 1000, 0, [&]() {
+		for (size_t i = 0; i < 1000; i++) {
+			const uint64_t ts = rng() % ts_max;
+			out.clear();
+			cf.overlapping(ts, ts + 6*3600*1000, out);
+			keep(out.size());
+		}
+	});
+}
+
+static void benchRangeVisible(const Bench& bench, size_t cursor_count) {
+	Message3Registry reg;
+	std::mt19937_64 rng{cursor_count};
+
+	const uint64_t ts_max = 365ull*24*3600*1000;
+	for (size_t i = 0; i < cursor_count; i++) {
+		const uint64_t ts = rng() % ts_max;
+		const auto begin = reg.create();
+		const auto end = reg.create();
+		reg.emplace<Message::Components::Timestamp>(begin, ts + 3600*1000);
+		reg.emplace<Message::Components::Timestamp>(end, ts);
+		reg.emplace<Message::Components::ViewCurserBegin>(begin, end);
+		reg.emplace<Message::Components::ViewCurserEnd>(end, begin);
+	}
+
+	// mostly misses, like most fragments of a contact
+	bench.run("range_visible", cursor_count, 1000, 0, [&]() {
+		size_t hits {0};
+		for (size_t i = 0; i < 1000; i++) {
+			const uint64_t ts = rng() % ts_max;
+			// begin is the newer end
+			hits += Message::Contexts::rangeVisible(ts + 60*1000, ts, reg) ? 1 : 0;
+		}
+		keep(hits);
+	});
+}
+
+// messages as they are serialized, roughly like a chat
+struct Messages {
+	struct Comp {
+		entt::id_type type_id {0};
+		std::string name;
+		nlohmann::json value;
+	};
+	std::vector<std::vector<Comp>> entries;
+};
+
+static Messages makeMessages(size_t count, size_t text_size) {
+	Messages msgs;
+	std::mt19937_64 rng{count * 31 + text_size};
+
+	const auto contact_id = [&rng]() {
+		std::vector<uint8_t> id(32);
+		for (auto& byte : id) {
+			byte = static_cast<uint8_t>(rng());
+		}
+		return id;
+	};
+	const std::vector<std::vector<uint8_t>> contacts {contact_id(), contact_id()};
+
+	uint64_t ts {1700000000000};
+	for (size_t i = 0; i < count; i++) {
+		ts += 1000 + rng() % 60000;
+
+		std::string text(text_size, ' ');
+		for (auto& c : text) {
+			c = static_cast<char>('a' + rng() % 26);
+		}
+
+		auto& entry = msgs.entries.emplace_back();
+		entry.push_back({
+			entt::type_hash<Message::Components::Timestamp>::value(),
+			"Message::Components::Timestamp",
+			nlohmann::json{{"ts", ts}},
+		});
+		entry.push_back({
+			entt::hashed_string::value("Message::Components::TimestampProcessed"),
+			"Message::Components::TimestampProcessed",
+			nlohmann::json{{"ts", ts + rng() % 100}},
+		});
+		entry.push_back({
+			entt::hashed_string::value("Message::Components::ContactFrom"),
+			"Message::Components::ContactFrom",
+			nlohmann::json{{"c", nlohmann::json::binary(contacts.at(rng() % 2))}},
+		});
+		entry.push_back({
+			entt::hashed_string::value("Message::Components::MessageText"),
+			"Message::Components::MessageText",
+			nlohmann::json{{"text", std::move(text)}},
+		});
+	}
+
+	return msgs;
+}
+
+// like syncFragToStorage()
+static void encode(uint16_t version, const Messages& msgs, MessagesMsgPackWriter& msgpack_writer, MessagesColumnarWriter& columnar_writer, std::vector<uint8_t>& out) {
+	out.clear();
+	if (version == 1) {
+		auto j = nlohmann::json::array();
+		for (const auto& entry : msgs.entries) {
+			auto& j_entry = j.emplace_back(nlohmann::json::object());
+			for (const auto& comp : entry) {
+				j_entry[comp.name] = comp.value;
+			}
+		}
+		const auto j_dump = j.dump(2, ' ', true);
+		out.assign(j_dump.cbegin(), j_dump.cend());
+	} else if (version == 2) {
+		msgpack_writer.beginArray(out, msgs.entries.size());
+		for (const auto& entry : msgs.entries) {
+			msgpack_writer.beginEntry();
+			for (const auto& comp : entry) {
+				msgpack_writer.component(comp.type_id, comp.name, comp.value);
+			}
+			msgpack_writer.endEntry(out);
+		}
+	} else if (version == 3) {
+		columnar_writer.begin(msgs.entries.size());
+		for (const auto& entry : msgs.entries) {
+			columnar_writer.beginEntry();
+			for (const auto& comp : entry) {
+				columnar_writer.component(comp.type_id, comp.name, comp.value);
+			}
+			columnar_writer.endEntry();
+		}
+		columnar_writer.end(out);
+	}
+}
+
+// counts instead of buffering, so only the decoding is measured
+struct CountingSink : public MessagesDecodeSinkI {
+	size_t entries {0};
+	size_t components {0};
+
+	void beginEntry(void) override {}
+	void component(entt::id_type, std::string_view, const nlohmann::json&) override { components++; }
+	void endEntry(void) override { entries++; }
+};
+
+static void benchCodec(const Bench& bench, size_t message_count, size_t text_size) {
+	const auto msgs = makeMessages(message_count, text_size);
+
+	MessagesMsgPackWriter msgpack_writer;
+	MessagesColumnarWriter columnar_writer;
+	// like the mfs
+	columnar_writer.setRowIndex(entt::type_hash<Message::Components::Timestamp>::value(), 64);
+
+	std::vector<uint8_t> data;
+	for (const uint16_t version : {1, 2, 3}) {
+		const std::string v = "v" + std::to_string(version);
+
+		encode(version, msgs, msgpack_writer, columnar_writer, data);
+		const size_t encoded_size = data.size();
+
+		bench.run("codec.encode." + v + ".text" + std::to_string(text_size), message_count, message_count, encoded_size, [&]() {
+			encode(version, msgs, msgpack_writer, columnar_writer, data);
+			keep(data.size());
+		});
+
+		encode(version, msgs, msgpack_writer, columnar_writer, data);
+
+		bench.run("codec.decode." + v + ".text" + std::to_string(text_size), message_count, message_count, encoded_size, [&]() {
+			CountingSink sink;
+			decodeMessages(version, ByteSpan{data}, sink);
+			keep(sink.entries);
+		});
+
+		// like a loader pool job, into a buffer for the main thread
+		bench.run("codec.decode_buffered." + v + ".text" + std::to_string(text_size), message_count, message_count, encoded_size, [&]() {
+			DecodedMessages decoded;
+			decodeMessages(version, ByteSpan{data}, decoded);
+			keep(decoded.entry_ends.size());
+		});
+
+		if (version == 3) {
+			// a view of ~10 messages in the middle, with the row index
+			const auto& ts_mid = msgs.entries.at(message_count/2).front().value.at("ts");
+			FragmentSlice slice;
+			slice.mode = FragmentSlice::Mode::view;
+			slice.ts_lo = ts_mid.get<uint64_t>();
+			slice.ts_hi = slice.ts_lo + 10*30000;
+
+			bench.run("codec.decode_view.v3.text" + std::to_string(text_size), message_count, 1, 0, [&]() {
+				CountingSink sink;
+				MessageRows rows;
+				decodeFragmentSlice(3, ByteSpan{data}, slice, sink, rows);
+				keep(sink.entries);
+			});
+		}
+	}
+}
+
+int main(int argc, const char** argv) {
+	Bench bench;
+	for (int i = 1; i < argc; i++) {
+		const std::string_view arg{argv[i]};
+		if (arg == "--min-time" && i+1 < argc) {
+			bench.min_time_s = std::stod(argv[++i]) / 1000.0;
+		} else {
+			bench.filter = arg;
+		}
+	}
+
+	for (const size_t n : {1000, 10000, 100000}) {
+		benchContactFragments(bench, n);
+	}
+
+	for (const size_t cursor_count : {1, 16, 256}) {
+		benchRangeVisible(bench, cursor_count);
+	}
+
+	// small and large fragments, short and long messages
+	for (const size_t message_count : {100, 2000}) {
+		for (const size_t text_size : {32, 512}) {
+			benchCodec(bench, message_count, text_size);
+		}
+	}
+
+	return 0;
+}
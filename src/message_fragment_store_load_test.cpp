@@ -0,0 +1,490 @@
+#include <solanaceae/contact/contact_store_impl.hpp>
+#include <solanaceae/contact/components.hpp>
+#include <solanaceae/object_store/object_store.hpp>
+#include <solanaceae/object_store/meta_components.hpp>
+#include <solanaceae/message_fragment_store/message_fragment_store.hpp>
+#include <solanaceae/message_fragment_store/testing/memory_storage.hpp>
+#include <solanaceae/message_fragment_store/testing/workload.hpp>
+#include <solanaceae/message3/message_serializer.hpp>
+#include <solanaceae/message3/registry_message_model_impl.hpp>
+#include <solanaceae/message3/components.hpp>
+
+#include <solanaceae/util/time.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <cassert>
+#include <cstdlib>
+
+// end-to-end load test of the mfs on an in-memory backend
+// 1. history: a first session fills the storage with the workload's history
+// 2. startup: a fresh session scans the storage
+// 3. session: the workload runs in real time (new messages, scrolling views), the mfs ticks like in an app
+// 4. shutdown: the session is destroyed (flushing)
+// prints one json object per phase (json lines), with tick latency, save lag and load time percentiles
+
+using clock_type = std::chrono::steady_clock;
+
+static double msSince(clock_type::time_point start) {
+	return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+static nlohmann::json percentiles(std::vector<double> samples) {
+	if (samples.empty()) {
+		return {{"count", 0}};
+	}
+
+	std::sort(samples.begin(), samples.end());
+	const auto at = [&samples](double p) {
+		return samples.at(std::min<size_t>(samples.size()-1, static_cast<size_t>(p * samples.size())));
+	};
+
+	double sum {0.0};
+	for (const double s : samples) {
+		sum += s;
+	}
+
+	return {
+		{"count", samples.size()},
+		{"mean", sum / samples.size()},
+		{"p50", at(0.5)},
+		{"p90", at(0.9)},
+		{"p99", at(0.99)},
+		{"max", samples.back()},
+	};
+}
+
+// what an app would have around the mfs
+struct Session {
+	ContactStore4Impl cs;
+	const Contact4 self;
+	const std::vector<Contact4> contacts; // index is the workload's contact
+	RegistryMessageModelImpl rmm{cs};
+	ObjectStore2 os;
+	Backends::MemoryStorage ms;
+	MessageSerializerNJ msnj{cs, os, {}, {}};
+	MessageFragmentStore mfs;
+
+	// open views, by contact index
+	struct View {
+		Message3 begin {entt::null};
+		Message3 end {entt::null};
+	};
+	std::map<size_t, View> views;
+
+	static Contact4 createSelf(ContactStore4Impl& cs) {
+		const auto c = cs.registry().create();
+		cs.registry().emplace<Contact::Components::ID>(c, std::vector<uint8_t>(32, 0x42));
+		return c;
+	}
+
+	static std::vector<Contact4> createContacts(ContactStore4Impl& cs, const WorkloadGenerator& gen) {
+		// before the mfs, it only gets events for later ones
+		std::vector<Contact4> contacts;
+		for (size_t i = 0; i < gen.config().contacts; i++) {
+			const auto c = cs.registry().create();
+			cs.registry().emplace<Contact::Components::ID>(c, gen.contactID(i));
+			contacts.push_back(c);
+		}
+		return contacts;
+	}
+
+	Session(const WorkloadGenerator& gen, std::shared_ptr<Backends::MemoryStorage::Device> device, size_t workers, MessageFragmentStore::LogLevel log_level) :
+		self(createSelf(cs)),
+		contacts(createContacts(cs, gen)),
+		ms(os, device),
+		mfs(cs, rmm, os, ms, ms, msnj)
+	{
+		registerMessageComponents(msnj);
+		mfs.setLogLevel(log_level);
+
+		if (workers > 0) {
+			const auto factory = [device](ObjectStore2& worker_os) {
+				return std::make_shared<Backends::MemoryStorage>(worker_os, device);
+			};
+			mfs.enableLoaderPool(factory, workers);
+			mfs.enableWriteBehind(factory);
+		}
+	}
+
+	Message3Registry& reg(size_t contact) {
+		auto* reg_ptr = rmm.get(contacts.at(contact));
+		assert(reg_ptr != nullptr);
+		return *reg_ptr;
+	}
+
+	Message3 addMessage(size_t contact, uint64_t ts, bool outgoing, const std::string& text) {
+		auto& msg_reg = reg(contact);
+		const auto c = contacts.at(contact);
+
+		const auto m = msg_reg.create();
+		msg_reg.emplace<Message::Components::Timestamp>(m, ts);
+		msg_reg.emplace<Message::Components::ContactFrom>(m, outgoing ? self : c);
+		msg_reg.emplace<Message::Components::ContactTo>(m, outgoing ? c : self);
+		msg_reg.emplace<Message::Components::MessageText>(m, text);
+		rmm.throwEventConstruct(msg_reg, m);
+
+		return m;
+	}
+
+	void openView(size_t contact, uint64_t ts_begin, uint64_t ts_end) {
+		auto& msg_reg = reg(contact);
+
+		View view;
+		view.begin = msg_reg.create();
+		view.end = msg_reg.create();
+		msg_reg.emplace<Message::Components::Timestamp>(view.begin, ts_begin);
+		msg_reg.emplace<Message::Components::ViewCurserBegin>(view.begin, view.end);
+		msg_reg.emplace<Message::Components::Timestamp>(view.end, ts_end);
+		msg_reg.emplace<Message::Components::ViewCurserEnd>(view.end, view.begin);
+		rmm.throwEventConstruct(msg_reg, view.begin);
+		rmm.throwEventConstruct(msg_reg, view.end);
+
+		views[contact] = view;
+	}
+
+	void moveView(size_t contact, uint64_t ts_begin, uint64_t ts_end) {
+		const auto it = views.find(contact);
+		if (it == views.end()) {
+			return;
+		}
+
+		auto& msg_reg = reg(contact);
+		msg_reg.replace<Message::Components::Timestamp>(it->second.begin, ts_begin);
+		msg_reg.replace<Message::Components::Timestamp>(it->second.end, ts_end);
+		rmm.throwEventUpdate(msg_reg, it->second.begin);
+		rmm.throwEventUpdate(msg_reg, it->second.end);
+	}
+
+	void closeView(size_t contact) {
+		const auto it = views.find(contact);
+		if (it == views.end()) {
+			return;
+		}
+
+		auto& msg_reg = reg(contact);
+		for (const auto m : {it->second.begin, it->second.end}) {
+			rmm.throwEventDestroy(msg_reg, m);
+			msg_reg.destroy(m);
+		}
+		views.erase(it);
+	}
+
+	bool hasMessagesIn(size_t contact, uint64_t ts_begin, uint64_t ts_end) {
+		auto& msg_reg = reg(contact);
+		for (const auto& [m, ts] : msg_reg.view<Message::Components::Timestamp, Message::Components::MessageText>().each()) {
+			if (ts.ts >= ts_end && ts.ts <= ts_begin) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// of the message's fragment, false if not yet
+	bool savedAt(size_t contact, Message3 m, clock_type::time_point& time) {
+		auto& msg_reg = reg(contact);
+		if (!msg_reg.valid(m) || !msg_reg.all_of<Message::Components::MFSObj>(m)) {
+			return false;
+		}
+
+		const auto fh = os.objectHandle(msg_reg.get<Message::Components::MFSObj>(m).o);
+		if (!static_cast<bool>(fh) || !fh.all_of<ObjComp::ID>()) {
+			return false;
+		}
+
+		return ms.device().lastWrite(fh.get<ObjComp::ID>().v, time);
+	}
+};
+
+static nlohmann::json storageStats(const Backends::MemoryStorage::Device& device) {
+	const auto& stats = device.stats();
+	return {
+		{"objects", device.objectCount()},
+		{"stored_bytes", device.storedBytes()},
+		{"reads", stats.reads.load()},
+		{"writes", stats.writes.load()},
+		{"bytes_read", stats.bytes_read.load()},
+		{"bytes_written", stats.bytes_written.load()},
+	};
+}
+
+static nlohmann::json histogram(const FragmentLatencyHistogram& h) {
+	return {
+		{"count", h.count},
+		{"mean_us", h.meanUS()},
+		{"p50_us", h.percentileUS(0.5f)},
+		{"p99_us", h.percentileUS(0.99f)},
+		{"max_us", h.max_us},
+	};
+}
+
+static nlohmann::json mfsMetrics(const FragmentStoreMetrics& m) {
+	return {
+		{"fragments_loaded", m.fragments_loaded},
+		{"fragments_load_failed", m.fragments_load_failed},
+		{"fragments_saved", m.fragments_saved},
+		{"fragments_save_failed", m.fragments_save_failed},
+		{"fragments_evicted", m.fragments_evicted},
+		{"bytes_read", m.bytes_read},
+		{"bytes_written", m.bytes_written},
+		{"messages_loaded", m.messages_loaded},
+		{"messages_unloaded", m.messages_unloaded},
+		{"dedup_hits", m.dedup_hits},
+		{"load_latency", histogram(m.load_latency)},
+		{"save_latency", histogram(m.save_latency)},
+		{"save_age", histogram(m.save_age)},
+		{"tick_time", histogram(m.tick_time)},
+		{"save_queue_depth", m.save_queue_depth},
+		{"save_queue_oldest_ms", m.save_queue_oldest_ms},
+		{"event_check_queue_depth", m.event_check_queue_depth},
+		{"loaded_messages", m.loaded_messages},
+		{"loaded_bytes", m.loaded_bytes},
+	};
+}
+
+int main(int argc, const char** argv) {
+	WorkloadConfig config;
+	Backends::MemoryStorage::Limits limits;
+	float session_seconds {30.f};
+	float frame_ms {10.f}; // main loop interval, like an app
+	size_t workers {2}; // 0 is loading and writing on the main thread
+	bool verbose {false};
+
+	for (int i = 1; i < argc; i++) {
+		const std::string_view arg{argv[i]};
+		const auto value = [&]() -> std::string {
+			if (i+1 >= argc) {
+				std::cerr << "missing value for " << arg << "\n";
+				std::exit(1);
+			}
+			return argv[++i];
+		};
+
+		if (arg == "--seed") {
+			config.seed = std::stoull(value());
+		} else if (arg == "--contacts") {
+			config.contacts = std::stoull(value());
+		} else if (arg == "--rate") {
+			config.max_msgs_per_hour = std::stof(value());
+		} else if (arg == "--history-days") {
+			config.history_days = std::stof(value());
+		} else if (arg == "--views") {
+			config.open_views = std::stoull(value());
+		} else if (arg == "--scroll-rate") {
+			config.scroll_rate = std::stof(value());
+		} else if (arg == "--seconds") {
+			session_seconds = std::stof(value());
+		} else if (arg == "--frame-ms") {
+			frame_ms = std::stof(value());
+		} else if (arg == "--workers") {
+			workers = std::stoull(value());
+		} else if (arg == "--read-latency-us") {
+			limits.read_latency = std::chrono::microseconds{std::stoll(value())};
+		} else if (arg == "--write-latency-us") {
+			limits.write_latency = std::chrono::microseconds{std::stoll(value())};
+		} else if (arg == "--read-mibps") {
+			limits.read_bytes_per_second = static_cast<size_t>(std::stod(value()) * 1024*1024);
+		} else if (arg == "--write-mibps") {
+			limits.write_bytes_per_second = static_cast<size_t>(std::stod(value()) * 1024*1024);
+		} else if (arg == "--verbose") {
+			verbose = true;
+		} else {
+			std::cerr << "unknown argument '" << arg << "'\n";
+			std::cerr << "usage: " << argv[0] << " [--seed n] [--contacts n] [--rate msgs/h] [--history-days d] [--views n] [--scroll-rate steps/s]"
+				" [--seconds s] [--frame-ms ms] [--workers n] [--read-latency-us us] [--write-latency-us us] [--read-mibps x] [--write-mibps x] [--verbose]\n";
+			return 1;
+		}
+	}
+
+	const auto log_level = verbose ? MessageFragmentStore::LogLevel::debug : MessageFragmentStore::LogLevel::warning;
+
+	// results go to stdout, other logging is dropped unless verbose
+	std::ostream out{std::cout.rdbuf()};
+	std::ostringstream dropped;
+	if (!verbose) {
+		std::cout.rdbuf(dropped.rdbuf());
+	}
+	const auto drop_log = [&]() {
+		dropped.str({});
+	};
+
+	auto device = std::make_shared<Backends::MemoryStorage::Device>();
+	WorkloadGenerator gen{config, getTimeMS()};
+
+	{ // history, not limited
+		const auto start = clock_type::now();
+		size_t messages {0};
+		{
+			Session s{gen, device, 0, log_level};
+			for (size_t c = 0; c < config.contacts; c++) {
+				for (const auto& msg : gen.history(c)) {
+					s.addMessage(c, msg.ts, msg.outgoing, msg.text);
+					messages++;
+				}
+				drop_log();
+			}
+			s.mfs.flush();
+		}
+		drop_log();
+
+		out << nlohmann::json{
+			{"phase", "history"},
+			{"messages", messages},
+			{"ms", msSince(start)},
+			{"storage", storageStats(*device)},
+		}.dump() << std::endl;
+	}
+
+	device->setLimits(limits);
+
+	std::vector<double> tick_ms;
+	std::vector<double> save_lag_ms;
+	std::vector<double> load_ms;
+	size_t loads_abandoned {0};
+	size_t live_messages {0};
+
+	struct PendingSave {
+		size_t contact {0};
+		Message3 m {entt::null};
+		clock_type::time_point created;
+	};
+	std::vector<PendingSave> pending_saves;
+
+	struct PendingLoad {
+		uint64_t ts_begin {0};
+		uint64_t ts_end {0};
+		clock_type::time_point requested;
+	};
+	std::map<size_t, PendingLoad> pending_loads; // by contact, one view each
+
+	auto session = std::make_unique<Session>(gen, device, workers, log_level);
+
+	{ // startup
+		const auto start = clock_type::now();
+		session->ms.scan();
+		drop_log();
+
+		out << nlohmann::json{
+			{"phase", "startup"},
+			{"fragments", session->os.registry().view<ObjComp::MessagesTSRange>().size()},
+			{"scan_ms", msSince(start)},
+		}.dump() << std::endl;
+	}
+
+	const auto apply = [&](const WorkloadGenerator::Event& e) {
+		using Type = WorkloadGenerator::Event::Type;
+		switch (e.type) {
+			case Type::message: {
+				const auto m = session->addMessage(e.contact, e.ts, e.outgoing, e.text);
+				pending_saves.push_back({e.contact, m, clock_type::now()});
+				live_messages++;
+			} break;
+			case Type::view_open:
+				session->openView(e.contact, e.view_ts_begin, e.view_ts_end);
+				break;
+			case Type::view_move:
+				session->moveView(e.contact, e.view_ts_begin, e.view_ts_end);
+				break;
+			case Type::view_close:
+				session->closeView(e.contact);
+				break;
+		}
+
+		if (e.type == Type::view_open || e.type == Type::view_move || e.type == Type::view_close) {
+			if (pending_loads.erase(e.contact) > 0) {
+				loads_abandoned++; // moved on before it loaded
+			}
+			if (e.expects_messages && e.type != Type::view_close) {
+				pending_loads[e.contact] = {e.view_ts_begin, e.view_ts_end, clock_type::now()};
+			}
+		}
+	};
+
+	{ // session
+		const auto start = clock_type::now();
+		for (const auto& e : gen.begin()) {
+			apply(e);
+		}
+
+		auto last_tick = clock_type::now();
+		while (msSince(start) < session_seconds * 1000.) {
+			const auto frame_start = clock_type::now();
+
+			for (const auto& e : gen.advance(getTimeMS())) {
+				apply(e);
+			}
+
+			const float time_delta = std::chrono::duration<float>(frame_start - last_tick).count();
+			last_tick = frame_start;
+
+			const auto tick_start = clock_type::now();
+			const float wait = session->mfs.tick(time_delta);
+			tick_ms.push_back(msSince(tick_start));
+
+			for (auto it = pending_loads.begin(); it != pending_loads.end();) {
+				if (session->hasMessagesIn(it->first, it->second.ts_begin, it->second.ts_end)) {
+					load_ms.push_back(msSince(it->second.requested));
+					it = pending_loads.erase(it);
+				} else {
+					it++;
+				}
+			}
+
+			pending_saves.erase(std::remove_if(pending_saves.begin(), pending_saves.end(), [&](const PendingSave& ps) {
+				clock_type::time_point saved;
+				if (!session->savedAt(ps.contact, ps.m, saved) || saved < ps.created) {
+					return false;
+				}
+				save_lag_ms.push_back(std::chrono::duration<double, std::milli>(saved - ps.created).count());
+				return true;
+			}), pending_saves.end());
+
+			drop_log();
+
+			const float sleep_ms = std::clamp(wait * 1000.f, 0.f, frame_ms) - static_cast<float>(msSince(frame_start));
+			if (sleep_ms > 0.f) {
+				std::this_thread::sleep_for(std::chrono::duration<float, std::milli>(sleep_ms));
+			}
+		}
+
+		out << nlohmann::json{
+			{"phase", "session"},
+			{"ms", msSince(start)},
+			{"live_messages", live_messages},
+			{"tick_ms", percentiles(tick_ms)},
+			{"save_lag_ms", percentiles(save_lag_ms)},
+			{"saves_pending", pending_saves.size()},
+			{"load_ms", percentiles(load_ms)},
+			{"loads_abandoned", loads_abandoned},
+			{"loads_pending", pending_loads.size()},
+			{"mfs", mfsMetrics(session->mfs.metrics())},
+			{"storage", storageStats(*device)},
+		}.dump() << std::endl;
+	}
+
+	{ // shutdown
+		const auto start = clock_type::now();
+		session.reset();
+		drop_log();
+
+		out << nlohmann::json{
+			{"phase", "shutdown"},
+			{"ms", msSince(start)},
+			{"storage", storageStats(*device)},
+		}.dump() << std::endl;
+	}
+
+	std::cout.rdbuf(out.rdbuf());
+
+	return 0;
+}
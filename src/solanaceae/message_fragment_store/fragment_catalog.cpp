@@ -0,0 +1,282 @@
+#include "./fragment_catalog.hpp"
+
+#include <solanaceae/object_store/meta_components.hpp>
+
+#include "./meta_messages_components.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <utility>
+
+// bump on incompatible changes, old catalogs are then just rebuilt
+static constexpr uint64_t catalog_format {2};
+
+bool FragmentCatalog::Entry::operator==(const Entry& other) const {
+	return
+		contact_id == other.contact_id &&
+		ts_begin == other.ts_begin &&
+		ts_end == other.ts_end &&
+		version == other.version &&
+		dict_id == other.dict_id &&
+		file_path == other.file_path &&
+		meta_file_type == other.meta_file_type &&
+		meta_encryption == other.meta_encryption &&
+		meta_compression == other.meta_compression &&
+		data_encryption == other.data_encryption &&
+		data_compression == other.data_compression
+	;
+}
+
+static int64_t dirMTime(const std::filesystem::path& path, bool& ok) {
+	std::error_code ec;
+	const auto t = std::filesystem::last_write_time(path, ec);
+	ok = !ec;
+	return ok ? static_cast<int64_t>(t.time_since_epoch().count()) : 0;
+}
+
+FragmentCatalog::FragmentCatalog(std::filesystem::path catalog_path, std::filesystem::path storage_path) :
+	_catalog_path(std::move(catalog_path)),
+	_storage_path(std::move(storage_path))
+{
+}
+
+bool FragmentCatalog::load(void) {
+	_entries.clear();
+	_dirty = false;
+	_on_disk = false;
+	_stale_reason = nullptr;
+
+	std::ifstream file(_catalog_path, std::ios::binary);
+	if (!file.is_open()) {
+		return false; // first run
+	}
+	const std::vector<uint8_t> data{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+	file.close();
+
+	const auto j = nlohmann::json::from_msgpack(data, true, false);
+
+	const auto stale = [this](const char* reason) {
+		_stale_reason = reason;
+		_entries.clear();
+		std::error_code ec;
+		std::filesystem::remove(_catalog_path, ec);
+		return false;
+	};
+
+	if (j.is_discarded() || !j.is_array() || j.size() != 5 || j.at(0) != catalog_format) {
+		return stale("broken or old");
+	}
+
+	try {
+		// before the checks, they stay valid
+		for (const auto& j_id : j.at(4)) {
+			_retired.emplace(j_id.get_binary());
+		}
+
+		// any change to the directories means files were added or removed
+		bool has_root {false};
+		for (const auto& j_dir : j.at(1)) {
+			const std::filesystem::path dir_path{j_dir.at(0).get<std::string>()};
+			bool ok {false};
+			if (dirMTime(dir_path, ok) != j_dir.at(1).get<int64_t>() || !ok) {
+				return stale("is stale");
+			}
+			has_root = has_root || dir_path == _storage_path;
+		}
+		if (!has_root) {
+			return stale("is for a different store");
+		}
+
+		const auto& j_contacts = j.at(2);
+		for (const auto& j_frag : j.at(3)) {
+			Entry entry;
+			entry.contact_id = j_contacts.at(j_frag.at(1).get<size_t>()).get_binary();
+			entry.ts_begin = j_frag.at(2);
+			entry.ts_end = j_frag.at(3);
+			entry.version = j_frag.at(4);
+			entry.dict_id = j_frag.at(5);
+			entry.file_path = j_frag.at(6);
+			entry.meta_file_type = j_frag.at(7);
+			entry.meta_encryption = j_frag.at(8);
+			entry.meta_compression = j_frag.at(9);
+			entry.data_encryption = j_frag.at(10);
+			entry.data_compression = j_frag.at(11);
+
+			_entries.insert_or_assign(j_frag.at(0).get_binary(), std::move(entry));
+		}
+	} catch (...) {
+		return stale("is broken");
+	}
+
+	_on_disk = true;
+	return true;
+}
+
+bool FragmentCatalog::save(void) {
+	auto j_dirs = nlohmann::json::array();
+	auto j_contacts = nlohmann::json::array();
+	auto j_frags = nlohmann::json::array();
+	auto j_retired = nlohmann::json::array();
+
+	// contacts only once
+	entt::dense_map<std::vector<uint8_t>, size_t, IDHash> contact_index;
+	std::vector<std::filesystem::path> dirs{_storage_path};
+
+	for (const auto& [id, entry] : _entries) {
+		auto [contact_it, contact_new] = contact_index.emplace(entry.contact_id, contact_index.size());
+		if (contact_new) {
+			j_contacts.push_back(nlohmann::json::binary(entry.contact_id));
+		}
+
+		auto dir_path = std::filesystem::path{entry.file_path}.parent_path();
+		if (std::find(dirs.cbegin(), dirs.cend(), dir_path) == dirs.cend()) {
+			dirs.push_back(std::move(dir_path));
+		}
+
+		j_frags.push_back(nlohmann::json::array({
+			nlohmann::json::binary(id),
+			contact_it->second,
+			entry.ts_begin,
+			entry.ts_end,
+			entry.version,
+			entry.dict_id,
+			entry.file_path,
+			entry.meta_file_type,
+			entry.meta_encryption,
+			entry.meta_compression,
+			entry.data_encryption,
+			entry.data_compression,
+		}));
+	}
+
+	for (const auto& id : _retired) {
+		j_retired.push_back(nlohmann::json::binary(id));
+	}
+
+	// after all writes to the store
+	for (const auto& dir_path : dirs) {
+		bool ok {false};
+		const auto mtime = dirMTime(dir_path, ok);
+		if (!ok) {
+			std::cerr << "MFS error: failed to stat " << dir_path << " for the fragment catalog\n";
+			return false;
+		}
+		j_dirs.push_back(nlohmann::json::array({dir_path.generic_string(), mtime}));
+	}
+
+	const auto data = nlohmann::json::to_msgpack(nlohmann::json::array({catalog_format, j_dirs, j_contacts, j_frags, j_retired}));
+
+	// write and swap, a half written catalog is just broken
+	auto tmp_path = _catalog_path;
+	tmp_path += ".tmp";
+	{
+		std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		if (!file.good()) {
+			std::cerr << "MFS error: failed to write fragment catalog " << tmp_path << "\n";
+			return false;
+		}
+	}
+	std::error_code ec;
+	std::filesystem::rename(tmp_path, _catalog_path, ec);
+	if (ec) {
+		std::cerr << "MFS error: failed to replace fragment catalog " << _catalog_path << ": " << ec.message() << "\n";
+		return false;
+	}
+
+	_file_size = data.size();
+	_dirty = false;
+	_on_disk = true;
+	return true;
+}
+
+void FragmentCatalog::invalidateOnDisk(void) {
+	if (!_on_disk) {
+		return;
+	}
+
+	std::error_code ec;
+	std::filesystem::remove(_catalog_path, ec);
+	_on_disk = false;
+}
+
+// default constructed if missing, like the backend assumes
+template<typename Comp, typename Member>
+static uint8_t enumValue(ObjectHandle oh, Member Comp::* member) {
+	return static_cast<uint8_t>(oh.all_of<Comp>() ? oh.get<Comp>().*member : Comp{}.*member);
+}
+
+bool FragmentCatalog::update(ObjectHandle oh) {
+	if (!oh.all_of<ObjComp::ID, ObjComp::MessagesContact, ObjComp::MessagesTSRange, ObjComp::Ephemeral::FilePath>()) {
+		return false;
+	}
+	if (retired(oh.get<ObjComp::ID>().v)) {
+		return false;
+	}
+
+	Entry entry;
+	entry.contact_id = oh.get<ObjComp::MessagesContact>().id;
+	entry.ts_begin = oh.get<ObjComp::MessagesTSRange>().begin;
+	entry.ts_end = oh.get<ObjComp::MessagesTSRange>().end;
+	entry.version = oh.all_of<ObjComp::MessagesVersion>() ? oh.get<ObjComp::MessagesVersion>().v : ObjComp::MessagesVersion{}.v;
+	entry.dict_id = oh.all_of<ObjComp::MessagesDictionary>() ? oh.get<ObjComp::MessagesDictionary>().id : 0;
+	entry.file_path = oh.get<ObjComp::Ephemeral::FilePath>().path;
+	entry.meta_file_type = enumValue(oh, &ObjComp::Ephemeral::MetaFileType::type);
+	entry.meta_encryption = enumValue(oh, &ObjComp::Ephemeral::MetaEncryptionType::enc);
+	entry.meta_compression = enumValue(oh, &ObjComp::Ephemeral::MetaCompressionType::comp);
+	entry.data_encryption = enumValue(oh, &ObjComp::DataEncryptionType::enc);
+	entry.data_compression = enumValue(oh, &ObjComp::DataCompressionType::comp);
+
+	auto it = _entries.find(oh.get<ObjComp::ID>().v);
+	if (it == _entries.end()) {
+		_entries.emplace(oh.get<ObjComp::ID>().v, std::move(entry));
+	} else if (it->second == entry) {
+		return false;
+	} else {
+		it->second = std::move(entry);
+	}
+
+	_dirty = true;
+	return true;
+}
+
+void FragmentCatalog::retire(const std::vector<uint8_t>& id) {
+	_entries.erase(id);
+	if (_retired.emplace(id).second) {
+		_dirty = true;
+	}
+}
+
+bool FragmentCatalog::retired(const std::vector<uint8_t>& id) const {
+	return _retired.contains(id);
+}
+
+void FragmentCatalog::restore(ObjectStore2& os, StorageBackendIMeta& sbm, StorageBackendIAtomic& sba, const std::function<void(ObjectHandle)>& fn) const {
+	for (const auto& [id, entry] : _entries) {
+		ObjectHandle oh{os.registry(), os.registry().create()};
+
+		oh.emplace<ObjComp::ID>(id);
+		oh.emplace<ObjComp::Ephemeral::BackendMeta>(&sbm);
+		oh.emplace<ObjComp::Ephemeral::BackendAtomic>(&sba);
+		oh.emplace<ObjComp::Ephemeral::FilePath>(entry.file_path);
+		oh.emplace<ObjComp::Ephemeral::MetaFileType>().type = static_cast<decltype(ObjComp::Ephemeral::MetaFileType::type)>(entry.meta_file_type);
+		oh.emplace<ObjComp::Ephemeral::MetaEncryptionType>().enc = static_cast<decltype(ObjComp::Ephemeral::MetaEncryptionType::enc)>(entry.meta_encryption);
+		oh.emplace<ObjComp::Ephemeral::MetaCompressionType>().comp = static_cast<decltype(ObjComp::Ephemeral::MetaCompressionType::comp)>(entry.meta_compression);
+		oh.emplace<ObjComp::DataEncryptionType>().enc = static_cast<decltype(ObjComp::DataEncryptionType::enc)>(entry.data_encryption);
+		oh.emplace<ObjComp::DataCompressionType>().comp = static_cast<decltype(ObjComp::DataCompressionType::comp)>(entry.data_compression);
+
+		oh.emplace<ObjComp::MessagesContact>(entry.contact_id);
+		oh.emplace<ObjComp::MessagesTSRange>(entry.ts_begin, entry.ts_end);
+		oh.emplace<ObjComp::MessagesVersion>(entry.version);
+		if (entry.dict_id != 0) {
+			oh.emplace<ObjComp::MessagesDictionary>(entry.dict_id);
+		}
+
+		fn(oh);
+	}
+}
+
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <solanaceae/object_store/object_store.hpp>
+
+#include "./id_hash.hpp"
+
+#include <entt/container/dense_map.hpp>
+#include <entt/container/dense_set.hpp>
+
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// compact list of all message fragments of a store, in a single file
+// on startup, the fragment objects are recreated from it instead of reading every meta file.
+// only holds what the mfs and the backend need (range, contact, version, paths, encodings),
+// other meta is not restored.
+// validated against the mtimes of the storage directories, so added or removed files
+// (eg. by other tools) invalidate it. the file is removed before the store is written to,
+// so a crash before the next checkpoint can not leave a stale catalog behind.
+// also remembers retired (emptied by compaction) fragments, the backend can not delete them.
+class FragmentCatalog {
+	public:
+		struct Entry {
+			std::vector<uint8_t> contact_id;
+			uint64_t ts_begin {0};
+			uint64_t ts_end {0};
+			uint16_t version {0};
+			uint32_t dict_id {0}; // 0 is none
+
+			// for the backend
+			std::string file_path;
+			uint8_t meta_file_type {0};
+			uint8_t meta_encryption {0};
+			uint8_t meta_compression {0};
+			uint8_t data_encryption {0};
+			uint8_t data_compression {0};
+
+			bool operator==(const Entry& other) const;
+		};
+
+	private:
+		const std::filesystem::path _catalog_path;
+		const std::filesystem::path _storage_path;
+
+		// by object id
+		entt::dense_map<std::vector<uint8_t>, Entry, IDHash> _entries;
+		// kept even if the rest is stale, they are empty on disk either way
+		entt::dense_set<std::vector<uint8_t>, IDHash> _retired;
+
+		bool _dirty {false}; // entries changed since load/save
+		bool _on_disk {false}; // the file matches the store
+
+		// for the caller to log, nullptr if it was not stale
+		const char* _stale_reason {nullptr};
+		size_t _file_size {0}; // of the last save
+
+	public:
+		FragmentCatalog(std::filesystem::path catalog_path, std::filesystem::path storage_path);
+
+		// returns false if the file is missing, broken or stale
+		bool load(void);
+		// checkpoint, only while nothing is written to the store
+		bool save(void);
+		// call before writing to the store
+		void invalidateOnDisk(void);
+
+		bool needsSave(void) const { return _dirty || !_on_disk; }
+		size_t size(void) const { return _entries.size(); }
+		// why the last load() failed, nullptr if the file was missing (or it did not fail)
+		const char* staleReason(void) const { return _stale_reason; }
+		size_t fileSize(void) const { return _file_size; }
+
+		// from the object's meta, returns true if the entry changed
+		bool update(ObjectHandle oh);
+
+		// drops the entry, and ignores the object from now on
+		void retire(const std::vector<uint8_t>& id);
+		bool retired(const std::vector<uint8_t>& id) const;
+
+		// creates an object per entry, fn is called for each (eg. to throw the construct event)
+		void restore(ObjectStore2& os, StorageBackendIMeta& sbm, StorageBackendIAtomic& sba, const std::function<void(ObjectHandle)>& fn) const;
+};
+
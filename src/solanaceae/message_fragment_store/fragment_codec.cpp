@@ -0,0 +1,916 @@
+#include "./fragment_codec.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <entt/core/hashed_string.hpp>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <iostream>
+#include <cassert>
+
+namespace {
+
+// sax handler for [ { "comp_name": value, ... }, ... ]
+// builds a json value per component only
+struct MessagesSAX {
+	using number_integer_t = nlohmann::json::number_integer_t;
+	using number_unsigned_t = nlohmann::json::number_unsigned_t;
+	using number_float_t = nlohmann::json::number_float_t;
+	using string_t = nlohmann::json::string_t;
+	using binary_t = nlohmann::json::binary_t;
+
+	MessagesDecodeSinkI& _sink;
+
+	// 0 outside, 1 in messages array, 2 in message entry
+	size_t _level {0};
+	bool _was_array {false};
+	bool _error {false};
+
+	std::string _comp_name;
+	entt::id_type _comp_type {0};
+
+	// component value under construction
+	nlohmann::json _value;
+	std::vector<nlohmann::json*> _value_stack;
+	nlohmann::json* _object_element {nullptr};
+
+	explicit MessagesSAX(MessagesDecodeSinkI& sink) : _sink(sink) {}
+
+	bool inValue(void) const {
+		return !_value_stack.empty();
+	}
+
+	void emitValue(void) {
+		_sink.component(_comp_type, _comp_name, _value);
+		_value = nullptr;
+	}
+
+	// mirrors the dom parser
+	template<typename Value>
+	bool handleValue(Value&& v) {
+		if (!inValue()) {
+			if (_level == 0) {
+				// top level scalar, wrong data
+				return false;
+			} else if (_level == 1) {
+				// scalar instead of a message, skip
+				return true;
+			}
+
+			_value = nlohmann::json(std::forward<Value>(v));
+			emitValue();
+			return true;
+		}
+
+		auto* parent = _value_stack.back();
+		if (parent->is_array()) {
+			parent->emplace_back(std::forward<Value>(v));
+		} else {
+			assert(_object_element != nullptr);
+			*_object_element = nlohmann::json(std::forward<Value>(v));
+		}
+		return true;
+	}
+
+	template<typename Value>
+	nlohmann::json* openValue(Value&& v) {
+		if (!inValue()) {
+			_value = nlohmann::json(std::forward<Value>(v));
+			_value_stack.push_back(&_value);
+			return &_value;
+		}
+
+		auto* parent = _value_stack.back();
+		nlohmann::json* new_value {nullptr};
+		if (parent->is_array()) {
+			parent->emplace_back(std::forward<Value>(v));
+			new_value = &parent->back();
+		} else {
+			assert(_object_element != nullptr);
+			*_object_element = nlohmann::json(std::forward<Value>(v));
+			new_value = _object_element;
+		}
+		_value_stack.push_back(new_value);
+		return new_value;
+	}
+
+	void closeValue(void) {
+		_value_stack.pop_back();
+		if (!inValue()) {
+			emitValue();
+		}
+	}
+
+	bool null(void) { return handleValue(nullptr); }
+	bool boolean(bool val) { return handleValue(val); }
+	bool number_integer(number_integer_t val) { return handleValue(val); }
+	bool number_unsigned(number_unsigned_t val) { return handleValue(val); }
+	bool number_float(number_float_t val, const string_t&) { return handleValue(val); }
+	bool string(string_t& val) { return handleValue(val); }
+	bool binary(binary_t& val) { return handleValue(std::move(val)); }
+
+	bool start_object(std::size_t) {
+		if (inValue() || _level == 2) {
+			openValue(nlohmann::json::value_t::object);
+			return true;
+		}
+
+		if (_level == 1) {
+			_level = 2;
+			_sink.beginEntry();
+			return true;
+		}
+
+		// top level object, wrong data
+		return false;
+	}
+
+	bool key(string_t& val) {
+		if (inValue()) {
+			_object_element = &(*_value_stack.back())[val];
+			return true;
+		}
+
+		assert(_level == 2);
+		_comp_name = val;
+		_comp_type = entt::hashed_string::value(_comp_name.data(), _comp_name.size());
+		return true;
+	}
+
+	bool end_object(void) {
+		if (inValue()) {
+			closeValue();
+			return true;
+		}
+
+		assert(_level == 2);
+		_level = 1;
+		_sink.endEntry();
+		return true;
+	}
+
+	bool start_array(std::size_t elements) {
+		if (inValue() || _level == 2) {
+			openValue(nlohmann::json::value_t::array);
+			return true;
+		}
+
+		if (_level == 0) {
+			_level = 1;
+			_was_array = true;
+			if (elements != std::size_t(-1)) {
+				// msgpack knows, json does not
+				_sink.messageCount(elements);
+			}
+			return true;
+		}
+
+		// array as message entry
+		_error = true;
+		return false;
+	}
+
+	bool end_array(void) {
+		if (inValue()) {
+			closeValue();
+			return true;
+		}
+
+		assert(_level == 1);
+		_level = 0;
+		return true;
+	}
+
+	bool parse_error(std::size_t position, const std::string&, const nlohmann::json::exception& ex) {
+		std::cerr << "MFS error: failed parsing messages at " << position << ": " << ex.what() << "\n";
+		_error = true;
+		return false;
+	}
+};
+
+} // namespace
+
+bool decodeMessages(uint16_t version, ByteSpan data, MessagesDecodeSinkI& sink) {
+	if (version == 3) {
+		return decodeMessageColumns(data, sink, nullptr);
+	}
+
+	MessagesSAX sax{sink};
+
+	bool res {false};
+	if (version == 1) {
+		res = nlohmann::json::sax_parse(data.cbegin(), data.cend(), &sax, nlohmann::json::input_format_t::json);
+	} else if (version == 2) {
+		res = nlohmann::json::sax_parse(data.cbegin(), data.cend(), &sax, nlohmann::json::input_format_t::msgpack);
+	} else {
+		assert(false);
+		return false;
+	}
+
+	if (sax._level == 2) {
+		// broken in the middle of an entry, we still finish it
+		// (the sink decides what to do with the partial message)
+		sink.endEntry();
+	}
+
+	return res && sax._was_array && !sax._error;
+}
+
+void DecodedMessages::component(entt::id_type type_id, std::string_view name, const nlohmann::json& value) {
+	components.push_back({type_id, std::string{name}, value});
+}
+
+void DecodedMessages::endEntry(void) {
+	entry_ends.push_back(components.size());
+}
+
+void DecodedMessages::messageCount(uint64_t count) {
+	has_message_count = true;
+	message_count = count;
+}
+
+void DecodedMessages::replay(MessagesDecodeSinkI& sink) const {
+	if (has_message_count) {
+		sink.messageCount(message_count);
+	}
+
+	size_t comp_i {0};
+	for (const size_t entry_end : entry_ends) {
+		sink.beginEntry();
+		for (; comp_i < entry_end; comp_i++) {
+			const auto& comp = components.at(comp_i);
+			sink.component(comp.type_id, comp.name, comp.value);
+		}
+		sink.endEntry();
+	}
+}
+
+static void writeBE(std::vector<uint8_t>& out, uint64_t value, size_t bytes) {
+	for (size_t i = bytes; i > 0; i--) {
+		out.push_back(static_cast<uint8_t>(value >> ((i-1)*8)));
+	}
+}
+
+// same size classes as nlohmann
+static void writeArrayHeader(std::vector<uint8_t>& out, size_t count) {
+	if (count <= 15) {
+		out.push_back(static_cast<uint8_t>(0x90 | count));
+	} else if (count <= 0xffff) {
+		out.push_back(0xdc);
+		writeBE(out, count, 2);
+	} else {
+		out.push_back(0xdd);
+		writeBE(out, count, 4);
+	}
+}
+
+static void writeMapHeader(std::vector<uint8_t>& out, size_t count) {
+	if (count <= 15) {
+		out.push_back(static_cast<uint8_t>(0x80 | count));
+	} else if (count <= 0xffff) {
+		out.push_back(0xde);
+		writeBE(out, count, 2);
+	} else {
+		out.push_back(0xdf);
+		writeBE(out, count, 4);
+	}
+}
+
+void MessagesMsgPackWriter::beginArray(std::vector<uint8_t>& out, size_t message_count) {
+	writeArrayHeader(out, message_count);
+}
+
+void MessagesMsgPackWriter::beginEntry(void) {
+	_values.clear();
+	_entry.clear();
+}
+
+void MessagesMsgPackWriter::component(entt::id_type type_id, std::string_view name, const nlohmann::json& value) {
+	if (!_key_cache.contains(type_id)) {
+		std::vector<uint8_t> key;
+		nlohmann::json::to_msgpack(nlohmann::json(std::string{name}), key);
+		_key_cache.emplace(type_id, std::move(key));
+	}
+
+	const size_t value_begin = _values.size();
+	nlohmann::json::to_msgpack(value, _values);
+	_entry.push_back({name, type_id, value_begin, _values.size()});
+}
+
+void MessagesMsgPackWriter::endEntry(std::vector<uint8_t>& out) {
+	// json objects are ordered by key
+	std::sort(_entry.begin(), _entry.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.name < rhs.name;
+	});
+
+	writeMapHeader(out, _entry.size());
+	for (const auto& comp : _entry) {
+		const auto& key = _key_cache.at(comp.type_id);
+		out.insert(out.end(), key.cbegin(), key.cend());
+		out.insert(out.end(), _values.cbegin() + comp.value_begin, _values.cbegin() + comp.value_end);
+	}
+
+	_values.clear();
+	_entry.clear();
+}
+
+
+static void writeVarint(std::vector<uint8_t>& out, uint64_t value) {
+	while (value >= 0x80) {
+		out.push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+static bool readVarint(const uint8_t*& it, const uint8_t* end, uint64_t& value) {
+	value = 0;
+	for (size_t shift = 0; shift < 64; shift += 7) {
+		if (it == end) {
+			return false;
+		}
+		const uint8_t byte = *it++;
+		value |= uint64_t(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0) {
+			return true;
+		}
+	}
+	return false; // too long
+}
+
+static void writeString(std::vector<uint8_t>& out, std::string_view str) {
+	writeVarint(out, str.size());
+	out.insert(out.end(), str.cbegin(), str.cend());
+}
+
+static bool readString(const uint8_t*& it, const uint8_t* end, std::string_view& str) {
+	uint64_t size {0};
+	if (!readVarint(it, end, size) || size > uint64_t(end - it)) {
+		return false;
+	}
+	str = {reinterpret_cast<const char*>(it), size};
+	it += size;
+	return true;
+}
+
+static uint64_t zigzag(uint64_t delta) {
+	return (delta << 1) ^ (0 - (delta >> 63));
+}
+
+static uint64_t unzigzag(uint64_t value) {
+	return (value >> 1) ^ (0 - (value & 1));
+}
+
+namespace {
+	enum class ColumnKind : uint8_t {
+		msgpack = 0,
+		unsigned_delta = 1,
+		member_unsigned_delta = 2,
+	};
+} // namespace
+
+void MessagesColumnarWriter::begin(size_t message_count) {
+	for (auto&& [_, col] : _columns) {
+		col.count = 0;
+		col.presence.assign((message_count+7)/8, 0);
+		col.values.clear();
+		col.value_offsets.clear();
+		col.all_unsigned = true;
+		col.all_single_member = true;
+		col.member_key.clear();
+		col.numbers.clear();
+	}
+
+	_message_count = message_count;
+	_entry = 0;
+}
+
+void MessagesColumnarWriter::beginEntry(void) {
+	assert(_entry < _message_count);
+}
+
+void MessagesColumnarWriter::component(entt::id_type type_id, std::string_view name, const nlohmann::json& value) {
+	auto col_it = _columns.find(type_id);
+	if (col_it == _columns.end()) {
+		col_it = _columns.emplace(type_id, Column{}).first;
+		col_it->second.presence.assign((_message_count+7)/8, 0);
+	}
+	auto& col = col_it->second;
+
+	if (col.name.empty()) {
+		col.name = name;
+	}
+
+	col.count++;
+	col.presence.at(_entry/8) |= uint8_t(1) << (_entry%8);
+
+	// length prefixed, so values can be skipped without parsing
+	const auto value_msgpack = nlohmann::json::to_msgpack(value);
+	col.value_offsets.push_back(col.values.size());
+	writeVarint(col.values, value_msgpack.size());
+	col.values.insert(col.values.end(), value_msgpack.cbegin(), value_msgpack.cend());
+
+	if (col.all_unsigned && !value.is_number_unsigned()) {
+		col.all_unsigned = false;
+	}
+	if (col.all_single_member) {
+		if (
+			!value.is_object() || value.size() != 1 ||
+			!value.begin().value().is_number_unsigned() ||
+			(col.count > 1 && value.begin().key() != col.member_key)
+		) {
+			col.all_single_member = false;
+		} else if (col.count == 1) {
+			col.member_key = value.begin().key();
+		}
+	}
+
+	if (col.all_unsigned) {
+		col.numbers.push_back(value.get<uint64_t>());
+	} else if (col.all_single_member) {
+		col.numbers.push_back(value.begin().value().get<uint64_t>());
+	}
+}
+
+void MessagesColumnarWriter::endEntry(void) {
+	_entry++;
+}
+
+void MessagesColumnarWriter::setRowIndex(entt::id_type ts_type_id, size_t interval) {
+	_index_type_id = ts_type_id;
+	_index_interval = interval;
+}
+
+void MessagesColumnarWriter::end(std::vector<uint8_t>& out) {
+	assert(_entry == _message_count);
+
+	std::vector<Column*> cols;
+	for (auto&& [_, col] : _columns) {
+		if (col.count > 0) {
+			cols.push_back(&col);
+		}
+	}
+	// same order as the v2 entries
+	std::sort(cols.begin(), cols.end(), [](const Column* lhs, const Column* rhs) {
+		return lhs->name < rhs->name;
+	});
+
+	writeVarint(out, _message_count);
+	writeVarint(out, cols.size());
+
+	std::vector<uint8_t> payload;
+	for (auto* col : cols) {
+		writeString(out, col->name);
+
+		ColumnKind kind {ColumnKind::msgpack};
+		if (col->all_unsigned) {
+			kind = ColumnKind::unsigned_delta;
+		} else if (col->all_single_member) {
+			kind = ColumnKind::member_unsigned_delta;
+		}
+		out.push_back(static_cast<uint8_t>(kind));
+
+		if (col->count == _message_count) {
+			out.push_back(0);
+		} else {
+			out.push_back(1);
+			out.insert(out.end(), col->presence.cbegin(), col->presence.cend());
+		}
+
+		const std::vector<uint8_t>* payload_ptr {&payload};
+		payload.clear();
+		if (kind == ColumnKind::msgpack) {
+			payload_ptr = &col->values;
+		} else {
+			if (kind == ColumnKind::member_unsigned_delta) {
+				writeString(payload, col->member_key);
+			}
+
+			col->value_offsets.clear();
+			uint64_t prev {0};
+			for (const uint64_t number : col->numbers) {
+				col->value_offsets.push_back(payload.size());
+				writeVarint(payload, zigzag(number - prev));
+				prev = number;
+			}
+		}
+
+		writeVarint(out, payload_ptr->size());
+		out.insert(out.end(), payload_ptr->cbegin(), payload_ptr->cend());
+		col->payload_size = payload_ptr->size();
+	}
+
+	// row index footer, only if the ts column is delta coded, complete and sorted
+	if (_index_interval == 0 || _message_count == 0) {
+		return;
+	}
+	const auto ts_col_it = _columns.find(_index_type_id);
+	if (
+		ts_col_it == _columns.end() ||
+		ts_col_it->second.count != _message_count ||
+		!(ts_col_it->second.all_unsigned || ts_col_it->second.all_single_member) ||
+		!std::is_sorted(ts_col_it->second.numbers.cbegin(), ts_col_it->second.numbers.cend())
+	) {
+		return;
+	}
+	const auto& ts_numbers = ts_col_it->second.numbers;
+
+	const size_t checkpoint_count = (_message_count + _index_interval - 1) / _index_interval;
+	writeVarint(out, _index_interval);
+	writeVarint(out, checkpoint_count);
+
+	// cursor of each column at the current row
+	std::vector<size_t> values_before(cols.size(), 0);
+	size_t row {0};
+	for (size_t cp = 0; cp < checkpoint_count; cp++) {
+		const size_t cp_row = cp * _index_interval;
+		for (size_t col_i = 0; col_i < cols.size(); col_i++) {
+			const auto& col = *cols[col_i];
+			for (size_t r = row; r < cp_row; r++) {
+				if ((col.presence.at(r/8) >> (r%8)) & 1) {
+					values_before[col_i]++;
+				}
+			}
+		}
+		row = cp_row;
+
+		writeVarint(out, ts_numbers.at(cp_row));
+		for (size_t col_i = 0; col_i < cols.size(); col_i++) {
+			const auto& col = *cols[col_i];
+			const size_t value_i = values_before[col_i];
+			writeVarint(out, value_i < col.value_offsets.size() ? col.value_offsets[value_i] : col.payload_size);
+			if (col.all_unsigned || col.all_single_member) {
+				// to continue the deltas
+				writeVarint(out, value_i > 0 ? col.numbers.at(value_i-1) : 0);
+			}
+		}
+	}
+}
+
+namespace {
+	struct ColumnReader {
+		std::string_view name;
+		entt::id_type type_id {0};
+		ColumnKind kind {ColumnKind::msgpack};
+		const uint8_t* presence {nullptr}; // nullptr if all present
+		std::string member_key;
+		bool wanted {true};
+
+		const uint8_t* begin {nullptr}; // payload
+		const uint8_t* it {nullptr};
+		const uint8_t* end {nullptr};
+		uint64_t prev {0};
+
+		bool present(uint64_t entry) const {
+			return presence == nullptr || (presence[entry/8] >> (entry%8)) & 1;
+		}
+
+		bool next(nlohmann::json& value) {
+			if (kind == ColumnKind::msgpack) {
+				uint64_t size {0};
+				if (!readVarint(it, end, size) || size > uint64_t(end - it)) {
+					return false;
+				}
+				value = nlohmann::json::from_msgpack(it, it + size, true, false);
+				it += size;
+				return !value.is_discarded();
+			}
+
+			uint64_t delta {0};
+			if (!readVarint(it, end, delta)) {
+				return false;
+			}
+			prev += unzigzag(delta);
+
+			if (kind == ColumnKind::unsigned_delta) {
+				value = prev;
+			} else {
+				value = nlohmann::json::object();
+				value[member_key] = prev;
+			}
+			return true;
+		}
+
+		// like next(), without decoding
+		bool skip(void) {
+			uint64_t size {0};
+			if (!readVarint(it, end, size)) {
+				return false;
+			}
+
+			if (kind == ColumnKind::msgpack) {
+				if (size > uint64_t(end - it)) {
+					return false;
+				}
+				it += size;
+			} else {
+				prev += unzigzag(size);
+			}
+			return true;
+		}
+	};
+
+	struct ColumnarData {
+		uint64_t message_count {0};
+		std::vector<ColumnReader> columns;
+
+		// row index, optional
+		uint64_t index_interval {0};
+		uint64_t checkpoint_count {0};
+		const uint8_t* index_begin {nullptr};
+		const uint8_t* index_end {nullptr};
+
+		bool parse(ByteSpan data, const std::function<bool(entt::id_type type_id, std::string_view name)>& want_column) {
+			const uint8_t* it = data.cbegin();
+			const uint8_t* const end = data.cend();
+
+			uint64_t column_count {0};
+			if (!readVarint(it, end, message_count) || !readVarint(it, end, column_count)) {
+				std::cerr << "MFS error: broken columnar header\n";
+				return false;
+			}
+
+			// every message has at least one component, which takes at least a byte
+			if (message_count > data.size) {
+				std::cerr << "MFS error: broken columnar header\n";
+				return false;
+			}
+			const uint64_t presence_size = (message_count+7)/8;
+
+			for (uint64_t i = 0; i < column_count; i++) {
+				ColumnReader col;
+				if (!readString(it, end, col.name) || end - it < 2) {
+					std::cerr << "MFS error: broken columnar column header\n";
+					return false;
+				}
+				col.type_id = entt::hashed_string::value(col.name.data(), col.name.size());
+
+				const uint8_t kind = *it++;
+				if (kind > static_cast<uint8_t>(ColumnKind::member_unsigned_delta)) {
+					std::cerr << "MFS error: unknown column kind " << int(kind) << "\n";
+					return false;
+				}
+				col.kind = static_cast<ColumnKind>(kind);
+
+				const uint8_t presence = *it++;
+				if (presence == 1) {
+					if (presence_size > uint64_t(end - it)) {
+						std::cerr << "MFS error: broken columnar presence\n";
+						return false;
+					}
+					col.presence = it;
+					it += presence_size;
+				} else if (presence != 0) {
+					std::cerr << "MFS error: broken columnar presence\n";
+					return false;
+				}
+
+				uint64_t payload_size {0};
+				if (!readVarint(it, end, payload_size) || payload_size > uint64_t(end - it)) {
+					std::cerr << "MFS error: broken columnar payload\n";
+					return false;
+				}
+				col.begin = it;
+				col.it = it;
+				col.end = it + payload_size;
+				it += payload_size;
+
+				col.wanted = !want_column || want_column(col.type_id, col.name);
+
+				if (col.kind == ColumnKind::member_unsigned_delta) {
+					std::string_view key;
+					if (!readString(col.it, col.end, key)) {
+						std::cerr << "MFS error: broken columnar payload\n";
+						return false;
+					}
+					col.member_key = key;
+				}
+
+				columns.push_back(std::move(col));
+			}
+
+			// optional footer
+			if (it != end) {
+				if (!readVarint(it, end, index_interval) || !readVarint(it, end, checkpoint_count) || index_interval == 0) {
+					std::cerr << "MFS error: broken columnar row index\n";
+					index_interval = 0;
+					checkpoint_count = 0;
+					return true; // the data itself is fine
+				}
+				index_begin = it;
+				index_end = end;
+			}
+
+			return true;
+		}
+
+		bool hasIndex(void) const {
+			return index_interval != 0 && checkpoint_count == (message_count + index_interval - 1) / index_interval;
+		}
+
+		// positions all columns at the checkpoint, returns false if broken
+		bool seek(uint64_t checkpoint, uint64_t& ts) {
+			const uint8_t* it = index_begin;
+			for (uint64_t cp = 0; cp <= checkpoint; cp++) {
+				if (!readVarint(it, index_end, ts)) {
+					return false;
+				}
+				for (auto& col : columns) {
+					uint64_t offset {0};
+					if (!readVarint(it, index_end, offset)) {
+						return false;
+					}
+					uint64_t prev {0};
+					if (col.kind != ColumnKind::msgpack && !readVarint(it, index_end, prev)) {
+						return false;
+					}
+
+					if (cp == checkpoint) {
+						if (offset > uint64_t(col.end - col.begin)) {
+							return false;
+						}
+						col.it = col.begin + offset;
+						col.prev = prev;
+					}
+				}
+			}
+			return true;
+		}
+
+		// checkpoint timestamps, in order
+		bool checkpointTimestamps(std::vector<uint64_t>& out) const {
+			const uint8_t* it = index_begin;
+			for (uint64_t cp = 0; cp < checkpoint_count; cp++) {
+				uint64_t ts {0};
+				if (!readVarint(it, index_end, ts)) {
+					return false;
+				}
+				out.push_back(ts);
+
+				uint64_t tmp {0};
+				for (const auto& col : columns) {
+					if (!readVarint(it, index_end, tmp)) {
+						return false;
+					}
+					if (col.kind != ColumnKind::msgpack && !readVarint(it, index_end, tmp)) {
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+
+		// columns need to be positioned at row_begin
+		bool decodeRows(MessagesDecodeSinkI& sink, uint64_t row_begin, uint64_t row_end) {
+			nlohmann::json value;
+			for (uint64_t entry = row_begin; entry < row_end; entry++) {
+				sink.beginEntry();
+				for (auto& col : columns) {
+					if (!col.present(entry)) {
+						continue;
+					}
+
+					if (!col.wanted) {
+						if (!col.skip()) {
+							std::cerr << "MFS error: broken column '" << col.name << "'\n";
+							sink.endEntry();
+							return false;
+						}
+						continue;
+					}
+
+					if (!col.next(value)) {
+						std::cerr << "MFS error: broken column '" << col.name << "'\n";
+						// finish the entry, like the other versions
+						sink.endEntry();
+						return false;
+					}
+					sink.component(col.type_id, col.name, value);
+				}
+				sink.endEntry();
+			}
+
+			return true;
+		}
+
+		bool skipRows(uint64_t row_begin, uint64_t row_end) {
+			for (uint64_t entry = row_begin; entry < row_end; entry++) {
+				for (auto& col : columns) {
+					if (col.present(entry) && !col.skip()) {
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+	};
+} // namespace
+
+bool decodeMessageColumns(ByteSpan data, MessagesDecodeSinkI& sink, const std::function<bool(entt::id_type type_id, std::string_view name)>& want_column) {
+	ColumnarData cd;
+	if (!cd.parse(data, want_column)) {
+		return false;
+	}
+
+	// skip the unwanted ones completely
+	cd.columns.erase(std::remove_if(cd.columns.begin(), cd.columns.end(), [](const ColumnReader& col) { return !col.wanted; }), cd.columns.end());
+
+	sink.messageCount(cd.message_count);
+	return cd.decodeRows(sink, 0, cd.message_count);
+}
+
+bool messageRowsForRange(ByteSpan data, uint64_t ts_lo, uint64_t ts_hi, MessageRows& rows) {
+	ColumnarData cd;
+	if (!cd.parse(data, nullptr) || !cd.hasIndex()) {
+		return false;
+	}
+
+	std::vector<uint64_t> cp_ts;
+	if (!cd.checkpointTimestamps(cp_ts) || cp_ts.empty()) {
+		return false;
+	}
+
+	rows = {};
+	rows.total = cd.message_count;
+
+	// last checkpoint with ts < lo, every row before it has ts < lo too
+	size_t cp_begin {0};
+	while (cp_begin+1 < cp_ts.size() && cp_ts[cp_begin+1] < ts_lo) {
+		cp_begin++;
+	}
+	rows.begin = cp_begin * cd.index_interval;
+	rows.ts_after = cp_ts[cp_begin];
+
+	// first checkpoint with ts > hi, every row from there has ts > hi
+	size_t cp_end {cp_begin+1};
+	while (cp_end < cp_ts.size() && cp_ts[cp_end] <= ts_hi) {
+		cp_end++;
+	}
+	if (cp_end < cp_ts.size()) {
+		rows.end = cp_end * cd.index_interval;
+		rows.ts_before = cp_ts[cp_end];
+	} else {
+		rows.end = rows.total;
+	}
+
+	return true;
+}
+
+bool decodeMessageRows(ByteSpan data, MessagesDecodeSinkI& sink, uint64_t row_begin, uint64_t row_end) {
+	ColumnarData cd;
+	if (!cd.parse(data, nullptr)) {
+		return false;
+	}
+
+	row_end = std::min(row_end, cd.message_count);
+	if (row_begin >= row_end) {
+		return true;
+	}
+
+	uint64_t row {0};
+	if (cd.hasIndex()) {
+		// jump to the closest checkpoint
+		const uint64_t cp = row_begin / cd.index_interval;
+		uint64_t ts {0};
+		if (!cd.seek(cp, ts)) {
+			std::cerr << "MFS error: broken columnar row index\n";
+			return false;
+		}
+		row = cp * cd.index_interval;
+	}
+
+	if (!cd.skipRows(row, row_begin)) {
+		std::cerr << "MFS error: broken columnar data\n";
+		return false;
+	}
+
+	return cd.decodeRows(sink, row_begin, row_end);
+}
+
+bool decodeFragmentSlice(uint16_t version, ByteSpan data, const FragmentSlice& slice, MessagesDecodeSinkI& sink, MessageRows& loaded_rows) {
+	loaded_rows = {};
+
+	if (slice.mode == FragmentSlice::Mode::view && version == 3) {
+		MessageRows rows;
+		if (messageRowsForRange(data, slice.ts_lo, slice.ts_hi, rows) && rows.partial()) {
+			loaded_rows = rows;
+			return decodeMessageRows(data, sink, rows.begin, rows.end);
+		}
+		// no index or everything, load all
+	} else if (slice.mode == FragmentSlice::Mode::rest) {
+		if (version != 3) {
+			return false; // can not happen
+		}
+
+		// the rows around the loaded ones
+		return
+			decodeMessageRows(data, sink, 0, slice.loaded.begin) &&
+			decodeMessageRows(data, sink, slice.loaded.end, slice.loaded.total)
+		;
+	}
+
+	return decodeMessages(version, data, sink);
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <solanaceae/util/span.hpp>
+
+#include <entt/core/fwd.hpp>
+#include <entt/container/dense_map.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// (de)serialization of the messages data of a fragment, without going through a full json tree
+
+// receives messages as they are decoded, one entry (message) at a time
+struct MessagesDecodeSinkI {
+	virtual ~MessagesDecodeSinkI(void) = default;
+
+	virtual void beginEntry(void) = 0;
+	// type_id is the hashed component name
+	virtual void component(entt::id_type type_id, std::string_view name, const nlohmann::json& value) = 0;
+	virtual void endEntry(void) = 0;
+
+	// number of messages the data claims to hold, before the first entry
+	// not called if the format does not tell (v1), or only some rows are decoded
+	virtual void messageCount(uint64_t) {}
+};
+
+// decodes v1 (json), v2 (msgpack) and v3 (columnar) messages data
+// only one component value is ever held as json
+// returns false if the data is not an array of messages, or broken
+// (entries decoded before an error are still passed to the sink)
+bool decodeMessages(uint16_t version, ByteSpan data, MessagesDecodeSinkI& sink);
+
+// v3 only, columns where want_column returns false are skipped without decoding
+// (messages will be missing those components)
+bool decodeMessageColumns(ByteSpan data, MessagesDecodeSinkI& sink, const std::function<bool(entt::id_type type_id, std::string_view name)>& want_column);
+
+// rows (messages) of a v3 fragment, as found with the row index
+struct MessageRows {
+	uint64_t begin {0};
+	uint64_t end {0};
+	uint64_t total {0};
+
+	// every message with ts_after < ts < ts_before is in [begin, end)
+	// (no limit if begin == 0 or end == total)
+	uint64_t ts_after {0};
+	uint64_t ts_before {UINT64_MAX};
+
+	bool partial(void) const {
+		return begin > 0 || end < total;
+	}
+
+	// if all messages in [ts_lo, ts_hi] are in the rows
+	bool covers(uint64_t ts_lo, uint64_t ts_hi) const {
+		return (begin == 0 || ts_lo > ts_after) && (end == total || ts_hi < ts_before);
+	}
+
+	bool operator==(const MessageRows& other) const {
+		return begin == other.begin && end == other.end && total == other.total;
+	}
+};
+
+// v3 only, returns false if the data has no row index
+// rows is a superset of the messages in [ts_lo, ts_hi], at checkpoint granularity
+bool messageRowsForRange(ByteSpan data, uint64_t ts_lo, uint64_t ts_hi, MessageRows& rows);
+
+// v3 only, decodes only the rows [row_begin, row_end)
+// starts at the closest checkpoint if there is a row index
+bool decodeMessageRows(ByteSpan data, MessagesDecodeSinkI& sink, uint64_t row_begin, uint64_t row_end);
+
+// what part of a fragment to load
+struct FragmentSlice {
+	enum class Mode : uint8_t {
+		all,
+		view, // only the rows around [ts_lo, ts_hi], if the fragment has a row index
+		rest, // everything not in loaded
+	} mode {Mode::all};
+
+	uint64_t ts_lo {0};
+	uint64_t ts_hi {UINT64_MAX};
+
+	MessageRows loaded; // for rest
+};
+
+// decodes according to slice, loaded_rows is set if only a part was decoded (total == 0 otherwise)
+bool decodeFragmentSlice(uint16_t version, ByteSpan data, const FragmentSlice& slice, MessagesDecodeSinkI& sink, MessageRows& loaded_rows);
+
+// buffers decoded messages, so decoding can happen somewhere else (eg. another thread)
+// and the messages are replayed later into the real sink
+struct DecodedMessages : public MessagesDecodeSinkI {
+	struct Component {
+		entt::id_type type_id {0};
+		std::string name;
+		nlohmann::json value;
+	};
+	std::vector<Component> components;
+	// end index into components, per entry
+	std::vector<size_t> entry_ends;
+	bool has_message_count {false};
+	uint64_t message_count {0};
+
+	void beginEntry(void) override {}
+	void component(entt::id_type type_id, std::string_view name, const nlohmann::json& value) override;
+	void endEntry(void) override;
+	void messageCount(uint64_t count) override;
+
+	void replay(MessagesDecodeSinkI& sink) const;
+};
+
+// writes v2 (msgpack) messages data straight into a byte buffer
+// produces the same bytes as nlohmann::json::to_msgpack() on the equivalent json array
+// keep it around, component names are encoded only once per type
+class MessagesMsgPackWriter {
+	// type -> msgpack encoded component name
+	entt::dense_map<entt::id_type, std::vector<uint8_t>> _key_cache;
+
+	// encoded values of the current entry
+	std::vector<uint8_t> _values;
+	struct EntryComponent {
+		std::string_view name;
+		entt::id_type type_id {0};
+		size_t value_begin {0};
+		size_t value_end {0};
+	};
+	std::vector<EntryComponent> _entry;
+
+	public:
+		// appends the array header
+		void beginArray(std::vector<uint8_t>& out, size_t message_count);
+
+		void beginEntry(void);
+		// name needs to outlive the entry
+		void component(entt::id_type type_id, std::string_view name, const nlohmann::json& value);
+		// appends the entry (components sorted by name, like a json object)
+		void endEntry(std::vector<uint8_t>& out);
+};
+
+// writes v3 (columnar) messages data
+// layout (varint is unsigned leb128):
+//   varint message count, varint column count
+//   per column, sorted by name:
+//     varint name length, name
+//     u8 kind
+//       0 - msgpack values, each prefixed with its varint length
+//       1 - unsigned integers, zigzag varint delta to the previous value in the column
+//       2 - objects with one unsigned integer member (eg. timestamps),
+//           varint key length, key, then like 1
+//     u8 presence, 0 - every message has the component, 1 - followed by a bitmap (lsb first)
+//     varint payload size, payload
+// optionally followed by a row index (only if the timestamp column is kind 1/2, complete and sorted):
+//   varint interval, varint checkpoint count
+//   per checkpoint (row k*interval):
+//     varint ts
+//     per column, in file order: varint payload offset of the next value, for kind 1/2 also varint previous value
+// component names are stored once per fragment and similar values sit next to each other.
+// columns are buffered until end(), keep it around to reuse the buffers
+class MessagesColumnarWriter {
+	struct Column {
+		std::string name;
+		size_t count {0}; // values in the column
+
+		std::vector<uint8_t> presence; // bitmap
+		// kind 0 encoding, always kept
+		std::vector<uint8_t> values;
+		std::vector<size_t> value_offsets; // into the payload, per value
+		size_t payload_size {0};
+
+		// for kind 1 and 2, as long as possible
+		bool all_unsigned {true};
+		bool all_single_member {true};
+		std::string member_key;
+		std::vector<uint64_t> numbers;
+	};
+	entt::dense_map<entt::id_type, Column> _columns;
+
+	size_t _message_count {0};
+	size_t _entry {0}; // current message
+
+	entt::id_type _index_type_id {0};
+	size_t _index_interval {0}; // 0 is no row index
+
+	public:
+		// write a row index every interval messages, keyed by the ts_type_id column
+		void setRowIndex(entt::id_type ts_type_id, size_t interval);
+
+		void begin(size_t message_count);
+
+		void beginEntry(void);
+		void component(entt::id_type type_id, std::string_view name, const nlohmann::json& value);
+		void endEntry(void);
+
+		// appends everything
+		void end(std::vector<uint8_t>& out);
+};
+
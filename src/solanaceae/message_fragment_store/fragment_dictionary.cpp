@@ -0,0 +1,85 @@
+#include "./fragment_dictionary.hpp"
+
+#include <zstd.h>
+#include <zdict.h>
+
+#include <iostream>
+
+// contexts are not thread safe, but can be reused
+static ZSTD_CCtx* threadCCtx(void) {
+	static thread_local std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> cctx{ZSTD_createCCtx(), &ZSTD_freeCCtx};
+	return cctx.get();
+}
+
+static ZSTD_DCtx* threadDCtx(void) {
+	static thread_local std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx{ZSTD_createDCtx(), &ZSTD_freeDCtx};
+	return dctx.get();
+}
+
+FragmentDictionary::~FragmentDictionary(void) {
+	ZSTD_freeCDict(_cdict);
+	ZSTD_freeDDict(_ddict);
+}
+
+std::shared_ptr<const FragmentDictionary> FragmentDictionary::create(ByteSpan data, int level) {
+	const uint32_t id = ZDICT_getDictID(data.ptr, data.size);
+	if (id == 0) {
+		std::cerr << "MFS error: not a zstd dictionary\n";
+		return nullptr;
+	}
+
+	// private ctor
+	std::shared_ptr<FragmentDictionary> dict{new FragmentDictionary};
+	dict->_id = id;
+	// both copy the data
+	dict->_cdict = ZSTD_createCDict(data.ptr, data.size, level);
+	dict->_ddict = ZSTD_createDDict(data.ptr, data.size);
+	if (dict->_cdict == nullptr || dict->_ddict == nullptr) {
+		std::cerr << "MFS error: failed to create zstd dictionary " << id << "\n";
+		return nullptr;
+	}
+
+	return dict;
+}
+
+bool FragmentDictionary::compress(ByteSpan data, std::vector<uint8_t>& out) const {
+	out.resize(ZSTD_compressBound(data.size));
+	// writes the content size, which decompress() relies on
+	const size_t ret = ZSTD_compress_usingCDict(threadCCtx(), out.data(), out.size(), data.ptr, data.size, _cdict);
+	if (ZSTD_isError(ret)) {
+		std::cerr << "MFS error: zstd compress failed: " << ZSTD_getErrorName(ret) << "\n";
+		out.clear();
+		return false;
+	}
+
+	out.resize(ret);
+	return true;
+}
+
+bool FragmentDictionary::decompress(ByteSpan data, std::vector<uint8_t>& out) const {
+	if (ZSTD_getDictID_fromFrame(data.ptr, data.size) != _id) {
+		std::cerr << "MFS error: zstd frame does not use dictionary " << _id << "\n";
+		return false;
+	}
+
+	const auto content_size = ZSTD_getFrameContentSize(data.ptr, data.size);
+	if (content_size == ZSTD_CONTENTSIZE_UNKNOWN || content_size == ZSTD_CONTENTSIZE_ERROR) {
+		std::cerr << "MFS error: zstd frame without content size\n";
+		return false;
+	}
+	if (content_size > max_content_size) {
+		std::cerr << "MFS error: zstd frame claims " << content_size << " bytes, more than a fragment can have\n";
+		return false;
+	}
+
+	out.resize(content_size);
+	const size_t ret = ZSTD_decompress_usingDDict(threadDCtx(), out.data(), out.size(), data.ptr, data.size, _ddict);
+	if (ZSTD_isError(ret) || ret != content_size) {
+		std::cerr << "MFS error: zstd decompress failed: " << (ZSTD_isError(ret) ? ZSTD_getErrorName(ret) : "size mismatch") << "\n";
+		out.clear();
+		return false;
+	}
+
+	return true;
+}
+
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <solanaceae/util/span.hpp>
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+// forward decl, so zstd.h does not leak
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+// trained zstd dictionary for fragment data
+// most fragments are only a few KiB, so they share little with themselves but alot with each other
+// (component names, contact ids ...).
+// fragments compressed with it are marked with ObjComp::MessagesDictionary and store the raw zstd frame
+// with the backend compression set to none.
+// immutable after creation, so it can be shared with the loader and writer threads
+class FragmentDictionary {
+	uint32_t _id {0};
+	ZSTD_CDict_s* _cdict {nullptr};
+	ZSTD_DDict_s* _ddict {nullptr};
+
+	FragmentDictionary(void) = default;
+
+	public:
+		// decompress() refuses frames claiming more, the header is untrusted
+		// (fragments are sealed at a few hundred KiB)
+		static constexpr uint64_t max_content_size {64*1024*1024};
+
+		~FragmentDictionary(void);
+		FragmentDictionary(const FragmentDictionary&) = delete;
+		FragmentDictionary& operator=(const FragmentDictionary&) = delete;
+
+		// returns nullptr if data is not a zstd dictionary (raw content dictionaries have no id)
+		static std::shared_ptr<const FragmentDictionary> create(ByteSpan data, int level = 3);
+
+		// the zstd dictionary id, also written into every frame
+		uint32_t id(void) const { return _id; }
+
+		// out is overwritten
+		bool compress(ByteSpan data, std::vector<uint8_t>& out) const;
+		bool decompress(ByteSpan data, std::vector<uint8_t>& out) const;
+};
+
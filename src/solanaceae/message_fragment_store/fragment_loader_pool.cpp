@@ -0,0 +1,193 @@
+#include "./fragment_loader_pool.hpp"
+
+#include <solanaceae/util/utils.hpp>
+
+#include <algorithm>
+#include <utility>
+#include <iostream>
+#include <cassert>
+
+FragmentLoaderPool::FragmentLoaderPool(BackendFactory backend_factory, size_t worker_count, size_t max_in_flight) :
+	_backend_factory(std::move(backend_factory)),
+	_max_in_flight(std::max<size_t>(max_in_flight, 1))
+{
+	assert(_backend_factory);
+
+	worker_count = std::max<size_t>(worker_count, 1);
+	for (size_t i = 0; i < worker_count; i++) {
+		_workers.emplace_back([this]() { workerMain(); });
+	}
+}
+
+FragmentLoaderPool::~FragmentLoaderPool(void) {
+	{
+		std::lock_guard lg{_mutex};
+		_stop = true;
+		_queue.clear();
+	}
+	_cv.notify_all();
+
+	for (auto& worker : _workers) {
+		worker.join();
+	}
+}
+
+void FragmentLoaderPool::workerMain(void) {
+	// private store, objects only live here for the duration of a job
+	ObjectStore2 os;
+	auto backend = _backend_factory(os);
+	if (!backend) {
+		std::cerr << "MFS error: loader worker failed to create backend\n";
+	}
+
+	std::vector<uint8_t> data;
+	std::vector<uint8_t> dict_data;
+
+	while (true) {
+		Job job;
+		{
+			std::unique_lock lk{_mutex};
+			_cv.wait(lk, [this]() { return _stop || !_queue.empty(); });
+			if (_stop) {
+				return;
+			}
+
+			job = std::move(_queue.front());
+			_queue.pop_front();
+		}
+
+		DoneJob done;
+		done.seq = job.seq;
+		done.res.frag = job.frag;
+		done.res.c = job.c;
+		done.res.slice = job.slice;
+		done.res.submitted = job.submitted;
+
+		data.clear();
+		if (backend) {
+			auto oh = job.snapshot.apply(os);
+
+			std::function<StorageBackendIAtomic::read_from_storage_put_data_cb> cb = [&data](const ByteSpan buffer) {
+				data.insert(data.end(), buffer.cbegin(), buffer.cend());
+			};
+			done.res.read_ok = backend->read(oh, cb);
+			if (!done.res.read_ok) {
+				std::cerr << "failed to read obj '" << bin2hex(job.snapshot.id) << "'\n";
+			}
+
+			oh.destroy();
+		}
+
+		done.res.data_size = data.size();
+		if (done.res.read_ok && !data.empty() && job.dict) {
+			done.res.read_ok = job.dict->decompress(ByteSpan{data}, dict_data);
+			data.swap(dict_data);
+		}
+		if (done.res.read_ok && !data.empty()) {
+			done.res.decode_ok = decodeFragmentSlice(job.version, ByteSpan{data}, job.slice, done.res.msgs, done.res.rows);
+		}
+
+		{
+			std::lock_guard lg{_mutex};
+			_done.push_back(std::move(done));
+		}
+	}
+}
+
+bool FragmentLoaderPool::submit(ObjectHandle fh, Contact4 c, uint16_t version, std::shared_ptr<const FragmentDictionary> dict, const FragmentSlice& slice) {
+	if (_in_flight.contains(fh) || full()) {
+		return false;
+	}
+
+	Job job;
+	job.seq = _next_seq++;
+	job.frag = fh;
+	job.c = c;
+	job.version = version;
+	job.dict = std::move(dict);
+	job.slice = slice;
+	job.snapshot = ObjectSnapshot::take(fh, false);
+	job.submitted = std::chrono::steady_clock::now();
+
+	_in_flight.emplace(fh, InFlight{job.seq, c});
+
+	{
+		std::lock_guard lg{_mutex};
+		_queue.push_back(std::move(job));
+	}
+	_cv.notify_one();
+
+	return true;
+}
+
+bool FragmentLoaderPool::pending(Object frag) const {
+	return _in_flight.contains(frag);
+}
+
+bool FragmentLoaderPool::full(void) const {
+	return _in_flight.size() + _canceled.size() >= _max_in_flight;
+}
+
+bool FragmentLoaderPool::idle(void) const {
+	return _in_flight.empty() && _canceled.empty();
+}
+
+void FragmentLoaderPool::cancel(Object frag) {
+	const auto it = _in_flight.find(frag);
+	if (it == _in_flight.end()) {
+		return;
+	}
+
+	const uint64_t seq = it->second.seq;
+	_in_flight.erase(it);
+
+	// drop it if no worker picked it up yet,
+	// a running (or done, not collected) one is ignored in collect()
+	std::lock_guard lg{_mutex};
+	const auto queue_it = std::find_if(_queue.begin(), _queue.end(), [seq](const Job& job) { return job.seq == seq; });
+	if (queue_it != _queue.end()) {
+		_queue.erase(queue_it);
+	} else {
+		_canceled.emplace(seq);
+	}
+}
+
+void FragmentLoaderPool::cancelIf(const std::function<bool(Contact4 c)>& fn) {
+	std::vector<Object> to_cancel;
+	for (const auto& [frag, in_flight] : _in_flight) {
+		if (fn(in_flight.c)) {
+			to_cancel.push_back(frag);
+		}
+	}
+
+	for (const auto frag : to_cancel) {
+		cancel(frag);
+	}
+}
+
+std::vector<FragmentLoaderPool::Result> FragmentLoaderPool::collect(void) {
+	std::vector<DoneJob> done;
+	{
+		std::lock_guard lg{_mutex};
+		done.swap(_done);
+	}
+
+	std::vector<Result> results;
+	for (auto& it : done) {
+		if (_canceled.erase(it.seq) != 0) {
+			continue;
+		}
+
+		const auto in_flight_it = _in_flight.find(it.res.frag);
+		if (in_flight_it == _in_flight.end() || in_flight_it->second.seq != it.seq) {
+			// canceled (or superseded)
+			continue;
+		}
+		_in_flight.erase(in_flight_it);
+
+		results.push_back(std::move(it.res));
+	}
+
+	return results;
+}
+
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <solanaceae/object_store/object_store.hpp>
+#include <solanaceae/contact/fwd.hpp>
+
+#include "./fragment_codec.hpp"
+#include "./fragment_dictionary.hpp"
+#include "./object_snapshot.hpp"
+
+#include <entt/container/dense_map.hpp>
+#include <entt/container/dense_set.hpp>
+
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <cstdint>
+
+// reads and decodes fragments on worker threads
+// the object registry is not thread safe, so every worker has its own ObjectStore2
+// and backend instance, the object is recreated there from a snapshot.
+// submit(), cancel() and collect() are to be called from the thread owning the main ObjectStore2
+class FragmentLoaderPool {
+	public:
+		using BackendFactory = StorageBackendAtomicFactory;
+
+		struct Result {
+			Object frag {entt::null};
+			Contact4 c {entt::null};
+			bool read_ok {false};
+			bool decode_ok {false};
+			size_t data_size {0};
+			FragmentSlice slice; // as submitted
+			MessageRows rows; // see decodeFragmentSlice()
+			DecodedMessages msgs;
+			std::chrono::steady_clock::time_point submitted; // for latency
+		};
+
+	private:
+		struct Job {
+			uint64_t seq {0};
+			Object frag {entt::null};
+			Contact4 c {entt::null};
+			uint16_t version {0};
+			std::shared_ptr<const FragmentDictionary> dict;
+			FragmentSlice slice;
+			ObjectSnapshot snapshot;
+			std::chrono::steady_clock::time_point submitted;
+		};
+
+		struct DoneJob {
+			uint64_t seq {0};
+			Result res;
+		};
+
+		BackendFactory _backend_factory;
+		const size_t _max_in_flight;
+
+		std::vector<std::thread> _workers;
+
+		std::mutex _mutex;
+		std::condition_variable _cv;
+		bool _stop {false};
+		std::deque<Job> _queue;
+		std::vector<DoneJob> _done;
+
+		// only touched by the owning thread
+		uint64_t _next_seq {1};
+		struct InFlight {
+			uint64_t seq {0};
+			Contact4 c {entt::null};
+		};
+		// latest job per fragment, queued or running
+		entt::dense_map<Object, InFlight> _in_flight;
+		// canceled while a worker had them, still occupy the pool until collect() sees them
+		entt::dense_set<uint64_t> _canceled;
+
+		void workerMain(void);
+
+	public:
+		FragmentLoaderPool(BackendFactory backend_factory, size_t worker_count, size_t max_in_flight);
+		~FragmentLoaderPool(void);
+
+		// returns false if the fragment is already in flight, or the pool is saturated
+		// dict is required for dictionary compressed fragments
+		bool submit(ObjectHandle fh, Contact4 c, uint16_t version, std::shared_ptr<const FragmentDictionary> dict = nullptr, const FragmentSlice& slice = {});
+
+		bool pending(Object frag) const;
+		bool full(void) const;
+		bool idle(void) const;
+
+		// results of canceled jobs are discarded
+		// the fragment can be submitted again right away, but a running job still counts towards full()
+		void cancel(Object frag);
+		// cancel all jobs for contacts where fn returns true
+		void cancelIf(const std::function<bool(Contact4 c)>& fn);
+
+		// finished jobs, in order of completion
+		std::vector<Result> collect(void);
+};
+
@@ -0,0 +1,42 @@
+#include "./fragment_store_metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void FragmentLatencyHistogram::record(std::chrono::steady_clock::duration d) {
+	const auto us = static_cast<uint64_t>(std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count(), 0));
+
+	// index of the highest bit + 1, 0 for 0
+	size_t bucket {0};
+	for (uint64_t v = us; v != 0; v >>= 1) {
+		bucket++;
+	}
+	buckets[std::min(bucket, buckets.size()-1)]++;
+
+	count++;
+	sum_us += us;
+	max_us = std::max(max_us, us);
+}
+
+uint64_t FragmentLatencyHistogram::meanUS(void) const {
+	return count == 0 ? 0 : sum_us / count;
+}
+
+uint64_t FragmentLatencyHistogram::percentileUS(float p) const {
+	if (count == 0) {
+		return 0;
+	}
+
+	const auto rank = static_cast<uint64_t>(std::ceil(std::clamp(p, 0.f, 1.f) * static_cast<float>(count)));
+	uint64_t seen {0};
+	for (size_t i = 0; i < buckets.size(); i++) {
+		seen += buckets[i];
+		if (seen >= std::max<uint64_t>(rank, 1)) {
+			// the last bucket is open ended
+			return i+1 == buckets.size() ? max_us : std::min(uint64_t(1) << i, max_us);
+		}
+	}
+
+	return max_us;
+}
+
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// log2 buckets of microseconds
+// cheap enough to record every load and save
+struct FragmentLatencyHistogram final {
+	// bucket i counts samples below 2^i us, the last one also everything above (~71min)
+	std::array<uint64_t, 32> buckets {};
+	uint64_t count {0};
+	uint64_t sum_us {0};
+	uint64_t max_us {0};
+
+	void record(std::chrono::steady_clock::duration d);
+
+	uint64_t meanUS(void) const;
+	// upper bound of the bucket the p quantile (0-1) falls into, 0 if empty
+	uint64_t percentileUS(float p) const;
+};
+
+// runtime state of a MessageFragmentStore, for watching it under load
+// counters only grow, gauges are updated every tick
+struct FragmentStoreMetrics final {
+	// counters
+	uint64_t fragments_loaded {0}; // including partial loads and the rest of them
+	uint64_t fragments_load_failed {0}; // unreadable or undecodable
+	uint64_t fragments_saved {0};
+	uint64_t fragments_save_failed {0};
+	uint64_t fragments_evicted {0};
+	uint64_t bytes_read {0}; // as returned by the backend
+	uint64_t bytes_written {0}; // of completed writes, serialized, before compression
+	uint64_t messages_loaded {0}; // new messages created from fragments
+	uint64_t messages_unloaded {0}; // by eviction
+	uint64_t dedup_hits {0}; // loaded messages that already existed
+
+	// request to commit, including the time queued on the loader pool
+	FragmentLatencyHistogram load_latency;
+	// serialize to write done, including the time queued on the writer
+	FragmentLatencyHistogram save_latency;
+	// first change to save (the save delay, backoff and budget)
+	FragmentLatencyHistogram save_age;
+	// wall clock time of tick()
+	FragmentLatencyHistogram tick_time;
+
+	// gauges
+	size_t save_queue_depth {0};
+	uint64_t save_queue_oldest_ms {0}; // since the first change
+	size_t save_failures_pending {0}; // waiting for a retry
+	size_t event_check_queue_depth {0};
+	size_t dirty_contacts {0};
+	// updated on eviction checks (every second)
+	size_t loaded_messages {0}; // belonging to a fragment, loaded or new
+	size_t loaded_bytes {0}; // memory budget accounting
+};
+
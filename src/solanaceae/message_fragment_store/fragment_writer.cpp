@@ -0,0 +1,134 @@
+#include "./fragment_writer.hpp"
+
+#include <solanaceae/util/utils.hpp>
+
+#include <algorithm>
+#include <utility>
+#include <iostream>
+#include <cassert>
+
+FragmentWriter::FragmentWriter(StorageBackendAtomicFactory backend_factory) :
+	_backend_factory(std::move(backend_factory))
+{
+	assert(_backend_factory);
+	_thread = std::thread([this]() { writerMain(); });
+}
+
+FragmentWriter::~FragmentWriter(void) {
+	{
+		std::lock_guard lg{_mutex};
+		_stop = true;
+	}
+	_cv.notify_all();
+
+	_thread.join();
+}
+
+void FragmentWriter::writerMain(void) {
+	// private store, objects only live here for the duration of a write
+	ObjectStore2 os;
+	auto backend = _backend_factory(os);
+	if (!backend) {
+		std::cerr << "MFS error: fragment writer failed to create backend\n";
+	}
+
+	std::vector<uint8_t> dict_data;
+
+	while (true) {
+		Job job;
+		{
+			std::unique_lock lk{_mutex};
+			_cv.wait(lk, [this]() { return _stop || !_queue.empty(); });
+			if (_stop) {
+				return;
+			}
+
+			job = std::move(_queue.front());
+			_queue.pop_front();
+			_busy = true;
+		}
+
+		Completion done;
+		done.frag = job.frag;
+		done.c = job.c;
+		done.submitted = job.submitted;
+
+		if (backend && job.dict && !job.dict->compress(ByteSpan{job.data}, dict_data)) {
+			std::cerr << "MFS error: failed to compress obj '" << bin2hex(job.snapshot.id) << "'\n";
+		} else if (backend) {
+			auto oh = job.snapshot.apply(os);
+
+			done.ok = backend->write(oh, job.dict ? ByteSpan{dict_data} : ByteSpan{job.data});
+			if (!done.ok) {
+				std::cerr << "MFS error: failed to write obj '" << bin2hex(job.snapshot.id) << "'\n";
+			}
+
+			oh.destroy();
+		}
+
+		done.bytes = job.data.size();
+		done.buffer = std::move(job.data);
+		done.buffer.clear();
+
+		{
+			std::lock_guard lg{_mutex};
+			_done.push_back(std::move(done));
+			_busy = false;
+		}
+		_cv_idle.notify_all();
+	}
+}
+
+void FragmentWriter::submit(ObjectHandle fh, Contact4 c, std::vector<uint8_t>&& data, std::shared_ptr<const FragmentDictionary> dict) {
+	// needs to happen on this thread
+	auto snapshot = ObjectSnapshot::take(fh, true);
+
+	{
+		std::lock_guard lg{_mutex};
+
+		const auto it = std::find_if(_queue.begin(), _queue.end(), [&fh](const Job& job) { return job.frag == fh; });
+		if (it != _queue.end()) {
+			// still waiting, just replace the content
+			it->snapshot = std::move(snapshot);
+			it->data = std::move(data);
+			it->dict = std::move(dict);
+			return;
+		}
+
+		_queue.push_back({fh, c, std::move(snapshot), std::move(data), std::move(dict), std::chrono::steady_clock::now()});
+	}
+	_pending[fh]++;
+	_cv.notify_one();
+}
+
+bool FragmentWriter::idle(void) const {
+	return _pending.empty();
+}
+
+bool FragmentWriter::pending(Object frag) const {
+	return _pending.contains(frag);
+}
+
+void FragmentWriter::flush(void) {
+	std::unique_lock lk{_mutex};
+	_cv_idle.wait(lk, [this]() { return _queue.empty() && !_busy; });
+}
+
+std::vector<FragmentWriter::Completion> FragmentWriter::collect(void) {
+	std::vector<Completion> done;
+	{
+		std::lock_guard lg{_mutex};
+		done.swap(_done);
+	}
+
+	for (const auto& completion : done) {
+		const auto it = _pending.find(completion.frag);
+		assert(it != _pending.end() && it->second > 0);
+		if (--it->second == 0) {
+			_pending.erase(it);
+		}
+	}
+
+	return done;
+}
+
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <solanaceae/object_store/object_store.hpp>
+#include <solanaceae/contact/fwd.hpp>
+
+#include "./fragment_dictionary.hpp"
+#include "./object_snapshot.hpp"
+
+#include <entt/container/dense_map.hpp>
+
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <cstdint>
+
+// write-behind for fragments
+// the payload is serialized on the owning thread, compression and the backend write
+// happen on a single writer thread (so writes to the same object keep their order).
+// like the loader pool, the writer has its own ObjectStore2 and backend instance,
+// the object (including all serializable meta) is recreated there from a snapshot.
+// submit(), collect() and flush() are to be called from the thread owning the main ObjectStore2
+class FragmentWriter {
+	public:
+		struct Completion {
+			Object frag {entt::null};
+			Contact4 c {entt::null};
+			bool ok {false};
+			size_t bytes {0}; // serialized, before compression
+			// of the first submit, replaced writes keep it
+			std::chrono::steady_clock::time_point submitted;
+			// the (cleared) payload buffer, for reuse
+			std::vector<uint8_t> buffer;
+		};
+
+	private:
+		struct Job {
+			Object frag {entt::null};
+			Contact4 c {entt::null};
+			ObjectSnapshot snapshot;
+			std::vector<uint8_t> data;
+			std::shared_ptr<const FragmentDictionary> dict;
+			std::chrono::steady_clock::time_point submitted;
+		};
+
+		StorageBackendAtomicFactory _backend_factory;
+
+		std::thread _thread;
+
+		std::mutex _mutex;
+		std::condition_variable _cv; // new jobs
+		std::condition_variable _cv_idle; // for flush
+		bool _stop {false};
+		bool _busy {false};
+		std::deque<Job> _queue;
+		std::vector<Completion> _done;
+
+		// only touched by the owning thread
+		// completions to collect, per fragment
+		entt::dense_map<Object, size_t> _pending;
+
+		void writerMain(void);
+
+	public:
+		explicit FragmentWriter(StorageBackendAtomicFactory backend_factory);
+		~FragmentWriter(void); // does not flush
+
+		// replaces a queued (not yet started) write of the same fragment
+		// if dict is set, data is compressed with it on the writer thread
+		void submit(ObjectHandle fh, Contact4 c, std::vector<uint8_t>&& data, std::shared_ptr<const FragmentDictionary> dict = nullptr);
+
+		// submitted but not collected
+		bool idle(void) const;
+		bool pending(Object frag) const;
+
+		// blocks until every submitted write finished
+		// completions still need to be collected
+		void flush(void);
+
+		std::vector<Completion> collect(void);
+};
+
@@ -0,0 +1,12 @@
+#include "./id_hash.hpp"
+
+size_t IDHash::operator()(const std::vector<uint8_t>& id) const noexcept {
+	// fnv-1a, ids are mostly random bytes anyway
+	uint64_t h {0xcbf29ce484222325};
+	for (const auto byte : id) {
+		h ^= byte;
+		h *= 0x100000001b3;
+	}
+	return static_cast<size_t>(h);
+}
+
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// for maps keyed by contact or object ids
+struct IDHash final {
+	size_t operator()(const std::vector<uint8_t>& id) const noexcept;
+};
+
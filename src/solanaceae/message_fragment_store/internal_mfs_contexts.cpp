@@ -6,6 +6,8 @@
 #include <solanaceae/message3/components.hpp>
 #include <solanaceae/message3/contact_components.hpp>
 
+#include <algorithm>
+#include <cassert>
 #include <iostream>
 
 static bool isLess(const std::vector<uint8_t>& lhs, const std::vector<uint8_t>& rhs) {
@@ -25,76 +27,181 @@ static bool isLess(const std::vector<uint8_t>& lhs, const std::vector<uint8_t>&
 	return lhs.size() < rhs.size();
 }
 
-bool Message::Contexts::ContactFragments::insert(ObjectHandle frag) {
-	if (sorted_frags.contains(frag)) {
+bool Message::Contexts::ContactFragments::nodeLess(uint32_t lhs, uint32_t rhs, size_t tree) const {
+	const auto& l = _nodes[lhs];
+	const auto& r = _nodes[rhs];
+	const uint64_t l_ts = tree == 0 ? l.begin : l.end;
+	const uint64_t r_ts = tree == 0 ? r.begin : r.end;
+	if (l_ts < r_ts) {
+		return true;
+	} else if (l_ts > r_ts) {
 		return false;
+	} else {
+		// equal ts, we need to fall back to id (id can not be equal)
+		return isLess(l.id, r.id);
 	}
+}
 
-	// both sorted arrays are sorted ascending
-	// so for insertion we search for the last index that is <= and insert after it
-	// or we search for the first > (or end) and insert before it    <---
-	// since equal fragments are UB, we can assume they are only > or <
-
-	size_t begin_index {0};
-	{ // begin
-		const auto pos = std::find_if(
-			sorted_begin.cbegin(),
-			sorted_begin.cend(),
-			[frag](const Object a) -> bool {
-				const auto begin_a = frag.registry()->get<ObjComp::MessagesTSRange>(a).begin;
-				const auto begin_frag = frag.get<ObjComp::MessagesTSRange>().begin;
-				if (begin_a > begin_frag) {
-					return true;
-				} else if (begin_a < begin_frag) {
-					return false;
-				} else {
-					// equal ts, we need to fall back to id (id can not be equal)
-					return isLess(frag.get<ObjComp::ID>().v, frag.registry()->get<ObjComp::ID>(a).v);
-				}
-			}
-		);
-
-		begin_index = std::distance(sorted_begin.cbegin(), pos);
-
-		// we need to insert before pos (end is valid here)
-		sorted_begin.insert(pos, frag);
-	}
-
-	size_t end_index {0};
-	{ // end
-		const auto pos = std::find_if_not(
-			sorted_end.cbegin(),
-			sorted_end.cend(),
-			[frag](const Object a) -> bool {
-				const auto end_a = frag.registry()->get<ObjComp::MessagesTSRange>(a).end;
-				const auto end_frag = frag.get<ObjComp::MessagesTSRange>().end;
-				if (end_a > end_frag) {
-					return true;
-				} else if (end_a < end_frag) {
-					return false;
-				} else {
-					// equal ts, we need to fall back to id (id can not be equal)
-					return isLess(frag.get<ObjComp::ID>().v, frag.registry()->get<ObjComp::ID>(a).v);
-				}
-			}
-		);
+void Message::Contexts::ContactFragments::nodeUpdate(uint32_t n) {
+	// only the begin tree is augmented
+	auto& node = _nodes[n];
+	node.max_end = node.end;
+	for (const auto c : node.child[0]) {
+		if (c != npos && _nodes[c].max_end > node.max_end) {
+			node.max_end = _nodes[c].max_end;
+		}
+	}
+}
+
+// splits t into l (< key) and r (> key)
+void Message::Contexts::ContactFragments::nodeSplit(uint32_t t, uint32_t key, size_t tree, uint32_t& l, uint32_t& r) {
+	if (t == npos) {
+		l = r = npos;
+		return;
+	}
+
+	auto& child = _nodes[t].child[tree];
+	if (nodeLess(t, key, tree)) {
+		nodeSplit(child[1], key, tree, child[1], r);
+		l = t;
+	} else {
+		nodeSplit(child[0], key, tree, l, child[0]);
+		r = t;
+	}
+
+	if (tree == 0) {
+		nodeUpdate(t);
+	}
+}
+
+uint32_t Message::Contexts::ContactFragments::nodeMerge(uint32_t l, uint32_t r, size_t tree) {
+	if (l == npos) {
+		return r;
+	} else if (r == npos) {
+		return l;
+	}
+
+	if (_nodes[l].prio > _nodes[r].prio) {
+		_nodes[l].child[tree][1] = nodeMerge(_nodes[l].child[tree][1], r, tree);
+		if (tree == 0) {
+			nodeUpdate(l);
+		}
+		return l;
+	} else {
+		_nodes[r].child[tree][0] = nodeMerge(l, _nodes[r].child[tree][0], tree);
+		if (tree == 0) {
+			nodeUpdate(r);
+		}
+		return r;
+	}
+}
+
+uint32_t Message::Contexts::ContactFragments::nodeInsert(uint32_t t, uint32_t n, size_t tree) {
+	if (t == npos) {
+		return n;
+	}
+
+	if (_nodes[n].prio > _nodes[t].prio) {
+		uint32_t l {npos};
+		uint32_t r {npos};
+		nodeSplit(t, n, tree, l, r);
+		_nodes[n].child[tree][0] = l;
+		_nodes[n].child[tree][1] = r;
+		if (tree == 0) {
+			nodeUpdate(n);
+		}
+		return n;
+	}
+
+	const size_t side = nodeLess(n, t, tree) ? 0 : 1;
+	const uint32_t new_child = nodeInsert(_nodes[t].child[tree][side], n, tree);
+	_nodes[t].child[tree][side] = new_child;
+	if (tree == 0) {
+		nodeUpdate(t);
+	}
+	return t;
+}
+
+uint32_t Message::Contexts::ContactFragments::nodeErase(uint32_t t, uint32_t n, size_t tree) {
+	if (t == npos) {
+		assert(false && "node not in tree");
+		return npos;
+	}
 
-		end_index = std::distance(sorted_end.cbegin(), pos);
+	if (t == n) {
+		return nodeMerge(_nodes[t].child[tree][0], _nodes[t].child[tree][1], tree);
+	}
+
+	const size_t side = nodeLess(n, t, tree) ? 0 : 1;
+	const uint32_t new_child = nodeErase(_nodes[t].child[tree][side], n, tree);
+	_nodes[t].child[tree][side] = new_child;
+	if (tree == 0) {
+		nodeUpdate(t);
+	}
+	return t;
+}
+
+void Message::Contexts::ContactFragments::nodeOverlapping(uint32_t t, uint64_t ts_begin, uint64_t ts_end, std::vector<Object>& out) const {
+	if (t == npos) {
+		return;
+	}
+
+	const auto& node = _nodes[t];
+	if (node.max_end < ts_begin) {
+		return; // nothing in this subtree reaches into the range
+	}
 
-		// we need to insert before pos (end is valid here)
-		sorted_end.insert(pos, frag);
+	nodeOverlapping(node.child[0][0], ts_begin, ts_end, out);
+
+	if (node.begin > ts_end) {
+		return; // self and right subtree start after the range
+	}
+
+	if (node.end >= ts_begin) {
+		out.push_back(node.frag);
 	}
 
-	sorted_frags.emplace(frag, InternalEntry{begin_index, end_index});
+	nodeOverlapping(node.child[0][1], ts_begin, ts_end, out);
+}
+
+bool Message::Contexts::ContactFragments::insert(ObjectHandle frag) {
+	if (sorted_frags.contains(frag)) {
+		return false;
+	}
 
-	// now adjust all indicies of fragments coming after the insert position
-	for (size_t i = begin_index + 1; i < sorted_begin.size(); i++) {
-		sorted_frags.at(sorted_begin[i]).i_b = i;
+	uint32_t n {npos};
+	if (!_free_nodes.empty()) {
+		n = _free_nodes.back();
+		_free_nodes.pop_back();
+	} else {
+		n = static_cast<uint32_t>(_nodes.size());
+		_nodes.emplace_back();
 	}
-	for (size_t i = end_index + 1; i < sorted_end.size(); i++) {
-		sorted_frags.at(sorted_end[i]).i_e = i;
+
+	{ // fill node
+		auto& node = _nodes[n];
+		node.frag = frag;
+		const auto& frag_range = frag.get<ObjComp::MessagesTSRange>();
+		node.begin = frag_range.begin;
+		node.end = frag_range.end;
+		node.id = frag.get<ObjComp::ID>().v;
+
+		// xorshift32
+		_prio_state ^= _prio_state << 13;
+		_prio_state ^= _prio_state >> 17;
+		_prio_state ^= _prio_state << 5;
+		node.prio = _prio_state;
+
+		node.child[0][0] = node.child[0][1] = npos;
+		node.child[1][0] = node.child[1][1] = npos;
+		node.max_end = node.end;
 	}
 
+	_root[0] = nodeInsert(_root[0], n, 0);
+	_root[1] = nodeInsert(_root[1], n, 1);
+
+	sorted_frags.emplace(frag, n);
+
 	return true;
 }
 
@@ -104,11 +211,15 @@ bool Message::Contexts::ContactFragments::erase(Object frag) {
 		return false;
 	}
 
-	assert(sorted_begin.size() == sorted_end.size());
-	assert(sorted_begin.size() > frags_it->second.i_b);
+	const uint32_t n = frags_it->second;
+	assert(n < _nodes.size());
 
-	sorted_begin.erase(sorted_begin.begin() + frags_it->second.i_b);
-	sorted_end.erase(sorted_end.begin() + frags_it->second.i_e);
+	_root[0] = nodeErase(_root[0], n, 0);
+	_root[1] = nodeErase(_root[1], n, 1);
+
+	_nodes[n].frag = entt::null;
+	_nodes[n].id.clear();
+	_free_nodes.push_back(n);
 
 	sorted_frags.erase(frags_it);
 
@@ -123,12 +234,18 @@ Object Message::Contexts::ContactFragments::prev(Object frag) const {
 		return entt::null;
 	}
 
-	const auto src_i = it->second.i_b;
-	if (src_i > 0) {
-		return sorted_begin[src_i-1];
+	// predecessor in begin tree
+	uint32_t candidate {npos};
+	for (uint32_t t = _root[0]; t != npos;) {
+		if (nodeLess(t, it->second, 0)) {
+			candidate = t;
+			t = _nodes[t].child[0][1];
+		} else {
+			t = _nodes[t].child[0][0];
+		}
 	}
 
-	return entt::null;
+	return candidate != npos ? _nodes[candidate].frag : entt::null;
 }
 
 Object Message::Contexts::ContactFragments::next(Object frag) const {
@@ -139,11 +256,207 @@ Object Message::Contexts::ContactFragments::next(Object frag) const {
 		return entt::null;
 	}
 
-	const auto src_i = it->second.i_e;
-	if (src_i+1 < sorted_end.size()) {
-		return sorted_end[src_i+1];
+	// successor in end tree
+	uint32_t candidate {npos};
+	for (uint32_t t = _root[1]; t != npos;) {
+		if (nodeLess(it->second, t, 1)) {
+			candidate = t;
+			t = _nodes[t].child[1][0];
+		} else {
+			t = _nodes[t].child[1][1];
+		}
+	}
+
+	return candidate != npos ? _nodes[candidate].frag : entt::null;
+}
+
+Object Message::Contexts::ContactFragments::front(void) const {
+	uint32_t t = _root[0];
+	if (t == npos) {
+		return entt::null;
+	}
+
+	while (_nodes[t].child[0][0] != npos) {
+		t = _nodes[t].child[0][0];
 	}
 
-	return entt::null;
+	return _nodes[t].frag;
 }
 
+Object Message::Contexts::ContactFragments::back(void) const {
+	uint32_t t = _root[1];
+	if (t == npos) {
+		return entt::null;
+	}
+
+	while (_nodes[t].child[1][1] != npos) {
+		t = _nodes[t].child[1][1];
+	}
+
+	return _nodes[t].frag;
+}
+
+Object Message::Contexts::ContactFragments::firstEndAtOrAfter(uint64_t ts) const {
+	uint32_t candidate {npos};
+	for (uint32_t t = _root[1]; t != npos;) {
+		if (_nodes[t].end >= ts) {
+			candidate = t;
+			t = _nodes[t].child[1][0];
+		} else {
+			t = _nodes[t].child[1][1];
+		}
+	}
+
+	return candidate != npos ? _nodes[candidate].frag : entt::null;
+}
+
+Object Message::Contexts::ContactFragments::lastBeginBefore(uint64_t ts) const {
+	uint32_t candidate {npos};
+	for (uint32_t t = _root[0]; t != npos;) {
+		if (_nodes[t].begin < ts) {
+			candidate = t;
+			t = _nodes[t].child[0][1];
+		} else {
+			t = _nodes[t].child[0][0];
+		}
+	}
+
+	return candidate != npos ? _nodes[candidate].frag : entt::null;
+}
+
+void Message::Contexts::ContactFragments::overlapping(uint64_t ts_begin, uint64_t ts_end, std::vector<Object>& out) const {
+	if (ts_begin > ts_end) {
+		std::swap(ts_begin, ts_end);
+	}
+
+	nodeOverlapping(_root[0], ts_begin, ts_end, out);
+}
+
+void Message::Contexts::LoadedContactFragments::setUsage(Object frag, size_t frag_bytes, uint64_t ts) {
+	auto& u = usage[frag];
+	bytes -= u.bytes;
+	bytes += frag_bytes;
+	u.bytes = frag_bytes;
+	u.ts_last_used = ts;
+}
+
+void Message::Contexts::LoadedContactFragments::touch(Object frag, uint64_t ts) {
+	if (auto it = usage.find(frag); it != usage.end()) {
+		it->second.ts_last_used = ts;
+	}
+}
+
+void Message::Contexts::LoadedContactFragments::erase(Object frag) {
+	loaded_frags.erase(frag);
+	partial.erase(frag);
+	if (auto it = usage.find(frag); it != usage.end()) {
+		bytes -= it->second.bytes;
+		usage.erase(it);
+	}
+}
+
+void Message::Contexts::ViewMotion::sample(Message3 view, uint64_t center, uint64_t ts_now) {
+	auto it = views.find(view);
+	if (it == views.end()) {
+		views.emplace(view, Track{center, ts_now, 0, 0.f});
+		return;
+	}
+
+	auto& track = it->second;
+	if (center == track.center) {
+		return;
+	}
+
+	// at least 1ms, multiple events can arrive in the same ms
+	const float dt = static_cast<float>(std::max<uint64_t>(ts_now - track.ts_last_sample, 1));
+	// difference first, the absolute values are too large for float
+	const float v = static_cast<float>(static_cast<int64_t>(center - track.center)) / dt;
+
+	if (track.ts_last_move + 1000 < ts_now) {
+		// was idle, start over
+		track.velocity = v;
+	} else {
+		track.velocity = 0.5f * track.velocity + 0.5f * v;
+	}
+
+	track.center = center;
+	track.ts_last_sample = ts_now;
+	track.ts_last_move = ts_now;
+}
+
+void Message::Contexts::FragmentMessages::add(Object frag, Message3 m) {
+	frag_msgs[frag].emplace(m);
+}
+
+void Message::Contexts::FragmentMessages::remove(Object frag, Message3 m) {
+	auto it = frag_msgs.find(frag);
+	if (it == frag_msgs.end()) {
+		return;
+	}
+
+	it->second.erase(m);
+	if (it->second.empty()) {
+		frag_msgs.erase(it);
+	}
+}
+
+void Message::Contexts::DedupIndex::add(uint64_t key, Message3 m) {
+	auto& bucket = msgs[key];
+	if (std::find(bucket.cbegin(), bucket.cend(), m) == bucket.cend()) {
+		bucket.push_back(m);
+	}
+}
+
+void Message::Contexts::DedupIndex::remove(uint64_t key, Message3 m) {
+	auto it = msgs.find(key);
+	if (it == msgs.end()) {
+		return;
+	}
+
+	auto& bucket = it->second;
+	bucket.erase(std::remove(bucket.begin(), bucket.end(), m), bucket.end());
+	if (bucket.empty()) {
+		msgs.erase(it);
+	}
+}
+
+bool Message::Contexts::rangeVisible(uint64_t range_begin, uint64_t range_end, const Message3Registry& msg_reg) {
+	// 1D collision checks:
+	//  - for range vs range:
+	//    r1 rhs >= r0 lhs AND r1 lhs <= r0 rhs
+	//  - for range vs point:
+	//    p >= r0 lhs AND p <= r0 rhs
+	// NOTE: directions for us are reversed (begin has larger values as end)
+
+	auto c_b_view = msg_reg.view<Message::Components::Timestamp, Message::Components::ViewCurserBegin>();
+	c_b_view.use<Message::Components::ViewCurserBegin>();
+	for (const auto& [m, ts_begin_comp, vcb] : c_b_view.each()) {
+		// p and r1 rhs can be seen as the same
+		// but first we need to know if a curser begin is a point or a range
+
+		// TODO: margin?
+		auto ts_begin = ts_begin_comp.ts;
+		auto ts_end = ts_begin_comp.ts; // simplyfy code by making a single begin curser act as an infinitly small range
+		if (msg_reg.valid(vcb.curser_end) && msg_reg.all_of<Message::Components::ViewCurserEnd>(vcb.curser_end)) {
+			// TODO: respect curser end's begin?
+			// TODO: remember which ends we checked and check remaining
+			ts_end = msg_reg.get<Message::Components::Timestamp>(vcb.curser_end).ts;
+
+			// sanity check curser order
+			if (ts_end > ts_begin) {
+				std::cerr << "MFS warning: begin curser and end curser of view swapped!!\n";
+				std::swap(ts_begin, ts_end);
+			}
+		}
+
+		// perform both checks here
+		if (ts_begin < range_end || ts_end > range_begin) {
+			continue;
+		}
+
+		// range hits a view
+		return true;
+	}
+
+	return false;
+}
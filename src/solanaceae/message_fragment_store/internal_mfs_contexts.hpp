@@ -1,34 +1,48 @@
 #pragma once
 
 #include <solanaceae/object_store/object_store.hpp>
+#include <solanaceae/message3/registry_message_model.hpp>
+
+#include "./fragment_codec.hpp"
 
 #include <entt/container/dense_set.hpp>
 #include <entt/container/dense_map.hpp>
 
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
 // everything assumes a single object registry (and unique objects)
 
 namespace Message::Contexts {
 
-	// ctx
-	struct OpenFragments {
-		// only contains fragments with <1024 messages and <2h tsrage (or whatever)
-		entt::dense_set<Object> open_frags;
-	};
-
 	// all message fragments of this contact
 	struct ContactFragments final {
 		// kept up-to-date by events
-		struct InternalEntry {
-			// indecies into the sorted arrays
-			size_t i_b;
-			size_t i_e;
+
+		// both orders live in the same node pool as treaps (randomized balanced bst)
+		// - begin order is an interval tree, augmented with the max range end of each subtree
+		// - end order is a plain search tree
+		// keys are cached in the node, since the object's range might change before erase()
+		static constexpr uint32_t npos {0xffffffff};
+		struct Node {
+			Object frag {entt::null};
+			uint64_t begin {0};
+			uint64_t end {0};
+			std::vector<uint8_t> id; // to break ts ties, ids can not be equal
+
+			uint32_t prio {0};
+			// [tree][side], tree 0 is begin, tree 1 is end
+			uint32_t child[2][2] {{npos, npos}, {npos, npos}};
+			uint64_t max_end {0}; // begin tree only
 		};
-		entt::dense_map<Object, InternalEntry> sorted_frags;
+		std::vector<Node> _nodes;
+		std::vector<uint32_t> _free_nodes;
+		uint32_t _root[2] {npos, npos};
+		uint32_t _prio_state {0x9e3779b9};
 
-		// add 2 sorted contact lists for both range begin and end
-		// TODO: adding and removing becomes expensive with enough frags, consider splitting or heap
-		std::vector<Object> sorted_begin;
-		std::vector<Object> sorted_end;
+		// object -> node index
+		entt::dense_map<Object, uint32_t> sorted_frags;
 
 		// api
 		// return true if it was actually inserted
@@ -36,10 +50,50 @@ namespace Message::Contexts {
 		bool erase(Object frag);
 		// update? (just erase() + insert())
 
+		bool empty(void) const { return sorted_frags.empty(); }
+		size_t size(void) const { return sorted_frags.size(); }
+		bool contains(Object frag) const { return sorted_frags.contains(frag); }
+
 		// uses range begin to go back in time
 		Object prev(Object frag) const;
 		// uses range end to go forward in time
 		Object next(Object frag) const;
+
+		// oldest by range begin
+		Object front(void) const;
+		// newest by range end
+		Object back(void) const;
+
+		// first fragment (by range end) with range end >= ts
+		Object firstEndAtOrAfter(uint64_t ts) const;
+		// last fragment (by range begin) with range begin < ts
+		Object lastBeginBefore(uint64_t ts) const;
+
+		// appends all fragments overlapping [ts_begin, ts_end] to out, ordered by range begin
+		// O(log n + k)
+		void overlapping(uint64_t ts_begin, uint64_t ts_end, std::vector<Object>& out) const;
+
+		private:
+			bool nodeLess(uint32_t lhs, uint32_t rhs, size_t tree) const;
+			void nodeUpdate(uint32_t n);
+			void nodeSplit(uint32_t t, uint32_t key, size_t tree, uint32_t& l, uint32_t& r);
+			uint32_t nodeMerge(uint32_t l, uint32_t r, size_t tree);
+			uint32_t nodeInsert(uint32_t t, uint32_t n, size_t tree);
+			uint32_t nodeErase(uint32_t t, uint32_t n, size_t tree);
+			void nodeOverlapping(uint32_t t, uint64_t ts_begin, uint64_t ts_end, std::vector<Object>& out) const;
+	};
+
+	// ctx
+	// fragments created this session, we only write to those
+	struct OpenFragments {
+		entt::dense_set<Object> open_frags;
+
+		// open fragments new messages can still be placed into, by time range
+		// sealed ones are removed (see FragmentSealPolicy), but stay open for updates
+		ContactFragments placeable;
+
+		void seal(Object frag) { placeable.erase(frag); }
+		bool sealed(Object frag) const { return open_frags.contains(frag) && !placeable.contains(frag); }
 	};
 
 	// all LOADED message fragments
@@ -47,7 +101,65 @@ namespace Message::Contexts {
 	struct LoadedContactFragments final {
 		// kept up-to-date by events
 		entt::dense_set<Object> loaded_frags;
+
+		// fragments where only the rows around a view are loaded (see FragmentSlice)
+		// not in loaded_frags, since they can not be saved or compacted like this
+		entt::dense_map<Object, MessageRows> partial;
+
+		// fully or partially
+		bool loaded(Object frag) const { return loaded_frags.contains(frag) || partial.contains(frag); }
+
+		// for eviction, only for fragments loaded from storage
+		struct Usage final {
+			size_t bytes {0}; // estimate, serialized size
+			uint64_t ts_last_used {0};
+		};
+		entt::dense_map<Object, Usage> usage;
+		size_t bytes {0}; // sum of usage
+
+		void setUsage(Object frag, size_t frag_bytes, uint64_t ts);
+		void touch(Object frag, uint64_t ts);
+		// unloaded (also partial)
+		void erase(Object frag);
+	};
+
+	// messages of each fragment, so saving does not need to walk the whole registry
+	// kept up-to-date on message events and fragment load
+	// can contain stale entries (destroyed or moved messages), check MFSObj on use
+	struct FragmentMessages final {
+		entt::dense_map<Object, entt::dense_set<Message3>> frag_msgs;
+
+		void add(Object frag, Message3 m);
+		void remove(Object frag, Message3 m);
 	};
 
+	// hash index for duplicate checks on fragment load
+	// only exists if the contact provides a Contact::Components::MessageDedupKey
+	// can contain stale entries, MessageIsSame always confirms
+	struct DedupIndex final {
+		entt::dense_map<uint64_t, std::vector<Message3>> msgs;
+
+		void add(uint64_t key, Message3 m);
+		void remove(uint64_t key, Message3 m);
+	};
+
+	// how the cursors of each view move, for prefetching
+	struct ViewMotion final {
+		struct Track final {
+			uint64_t center {0}; // between begin and end curser ts
+			uint64_t ts_last_sample {0};
+			uint64_t ts_last_move {0};
+			// smoothed, in curser ms per ms, positive is towards newer messages
+			float velocity {0.f};
+		};
+		// keyed by begin curser
+		entt::dense_map<Message3, Track> views;
+
+		void sample(Message3 view, uint64_t center, uint64_t ts_now);
+	};
+
+	// checks range against all cursers in msg_reg
+	bool rangeVisible(uint64_t range_begin, uint64_t range_end, const Message3Registry& msg_reg);
+
 } // Message::Contexts
 
@@ -1,6 +1,9 @@
 #include "./message_fragment_store.hpp"
 
 #include "./internal_mfs_contexts.hpp"
+#include "./fragment_codec.hpp"
+#include "./fragment_loader_pool.hpp"
+#include "./fragment_writer.hpp"
 #include "solanaceae/object_store/meta_components.hpp"
 #include "solanaceae/object_store/object_store.hpp"
 
@@ -17,7 +20,12 @@
 
 #include <nlohmann/json.hpp>
 
+#include <entt/core/type_info.hpp>
+
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <chrono>
 #include <string>
 #include <cstdint>
 #include <cassert>
@@ -31,12 +39,27 @@ namespace ObjectStore::Components {
 	NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(MessagesVersion, v)
 	NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(MessagesTSRange, begin, end)
 	NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(MessagesContact, id)
+	NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(MessagesDictionary, id)
 
 	namespace Ephemeral {
 		// does not contain any messges
 		// (recheck on frag update)
 		struct MessagesEmptyTag {};
 
+		// only a part could be decoded, the messages we got are kept, but
+		// the fragment is never written, since that would drop the rest.
+		// also has MessagesEmptyTag, so it is not loaded again
+		// (recheck on frag update)
+		struct MessagesDecodeErrorTag {};
+
+		// of the last complete load, messages the data holds and how many of them were decoded
+		// compaction only rewrites fragments where they match
+		// (our own writes keep them matching, so they are not updated there)
+		struct MessagesDecodedCount {
+			uint64_t stored {0};
+			uint64_t decoded {0};
+		};
+
 		// cache the contact for faster lookups
 		struct MessagesContactEntity {
 			Contact4 e {entt::null};
@@ -44,30 +67,171 @@ namespace ObjectStore::Components {
 	}
 } // ObjectStore::Component
 
-static nlohmann::json loadFromStorageNJ(ObjectHandle oh) {
+static bool readFromStorage(ObjectHandle oh, std::vector<uint8_t>& data) {
 	assert(oh.all_of<ObjComp::Ephemeral::BackendAtomic>());
 	auto* backend = oh.get<ObjComp::Ephemeral::BackendAtomic>().ptr;
 	assert(backend != nullptr);
 
-	std::vector<uint8_t> tmp_buffer;
-	std::function<StorageBackendIAtomic::read_from_storage_put_data_cb> cb = [&tmp_buffer](const ByteSpan buffer) {
-		tmp_buffer.insert(tmp_buffer.end(), buffer.cbegin(), buffer.cend());
+	std::function<StorageBackendIAtomic::read_from_storage_put_data_cb> cb = [&data](const ByteSpan buffer) {
+		data.insert(data.end(), buffer.cbegin(), buffer.cend());
 	};
 	if (!backend->read(oh, cb)) {
 		std::cerr << "failed to read obj '" << bin2hex(oh.get<ObjComp::ID>().v) << "'\n";
 		return false;
 	}
 
-	const auto obj_version = oh.get<ObjComp::MessagesVersion>().v;
+	return true;
+}
 
-	if (obj_version == 1) {
-		return nlohmann::json::parse(tmp_buffer, nullptr, false);
-	} else if (obj_version == 2) {
-		return nlohmann::json::from_msgpack(tmp_buffer, true, false);
-	} else {
-		assert(false);
+Contact4 MessageFragmentStore::contactFromID(const std::vector<uint8_t>& id) {
+	if (const auto it = _contact_id_lookup.find(id); it != _contact_id_lookup.end()) {
+		const auto c = it->second;
+		// ids can change without us noticing the old one, so verify
+		if (_cs.registry().valid(c) && _cs.registry().all_of<Contact::Components::ID>(c) && _cs.registry().get<Contact::Components::ID>(c).data == id) {
+			return c;
+		}
+		_contact_id_lookup.erase(it);
+	}
+
+	// miss, fall back to walking the contacts (unknown contact or missed event)
+	for (const auto& [c_it, id_it] : _cs.registry().view<Contact::Components::ID>().each()) {
+		if (id == id_it.data) {
+			_contact_id_lookup.emplace(id, c_it);
+			return c_it;
+		}
+	}
+
+	return entt::null;
+}
+
+static void addToFragmentMessages(Message3Registry& reg, Object frag, Message3 m) {
+	if (!reg.ctx().contains<Message::Contexts::FragmentMessages>()) {
+		reg.ctx().emplace<Message::Contexts::FragmentMessages>();
+	}
+	reg.ctx().get<Message::Contexts::FragmentMessages>().add(frag, m);
+}
+
+const Contact::Components::MessageDedupKey* MessageFragmentStore::dedupKeyOf(const Message3Registry& reg) const {
+	if (!reg.ctx().contains<Contact4>()) {
+		return nullptr;
+	}
+
+	return _cs.registry().try_get<Contact::Components::MessageDedupKey>(reg.ctx().get<Contact4>());
+}
+
+Message::Contexts::DedupIndex& MessageFragmentStore::dedupIndex(Message3Registry& reg, const Contact::Components::MessageDedupKey& dk) {
+	if (!reg.ctx().contains<Message::Contexts::DedupIndex>()) {
+		auto& di = reg.ctx().emplace<Message::Contexts::DedupIndex>();
+		// first use, index everything already there
+		for (const Message3 m : reg.view<Message::Components::Timestamp, Message::Components::ContactFrom, Message::Components::ContactTo>()) {
+			di.add(dk.fn({reg, m}), m);
+		}
+	}
+
+	return reg.ctx().get<Message::Contexts::DedupIndex>();
+}
+
+bool MessageFragmentStore::placeableInto(Message3Registry& reg, Object frag) {
+	auto& open = reg.ctx().get<Message::Contexts::OpenFragments>();
+	if (!open.placeable.contains(frag)) {
+		return false;
+	}
+
+	// count can include stale messages, good enough
+	if (const auto* fm = reg.ctx().find<Message::Contexts::FragmentMessages>(); fm != nullptr) {
+		if (const auto it = fm->frag_msgs.find(frag); it != fm->frag_msgs.cend() && it->second.size() >= _seal_policy.max_messages) {
+			if (logs(LogLevel::debug)) {
+				std::cout << "MFS: sealed fragment, message count\n";
+			}
+			open.seal(frag);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void MessageFragmentStore::setFragmentVersion(uint16_t version) {
+	if (version < 2 || version > 3) {
+		std::cerr << "MFS error: can not write fragments with version " << version << "\n";
+		return;
+	}
+	_new_fragment_version = version;
+}
+
+void MessageFragmentStore::setSealPolicy(const FragmentSealPolicy& policy) {
+	_seal_policy = policy;
+}
+
+ObjectHandle MessageFragmentStore::newFragment(Message3Registry& reg, uint64_t ts_begin, uint64_t ts_end) {
+	const auto new_uuid = _session_uuid_gen();
+	if (_catalog) {
+		// the backend might write the meta already
+		_catalog->invalidateOnDisk();
+	}
+	_fs_ignore_event = true;
+	auto fh = _sbm.newObject(ByteSpan{new_uuid});
+	// TODO: the backend should have done that?
+	fh.emplace_or_replace<ObjComp::Ephemeral::BackendAtomic>(&_sba);
+	_fs_ignore_event = false;
+	if (!static_cast<bool>(fh)) {
+		std::cout << "MFS error: failed to create new object for message\n";
 		return {};
 	}
+
+	fh.emplace_or_replace<ObjComp::Ephemeral::MetaCompressionType>().comp = Compression::ZSTD;
+	fh.emplace_or_replace<ObjComp::DataCompressionType>().comp = Compression::ZSTD;
+	fh.emplace_or_replace<ObjComp::MessagesVersion>().v = _new_fragment_version; // the default is kept for objects without version
+
+	auto& new_ts_range = fh.emplace_or_replace<ObjComp::MessagesTSRange>();
+	new_ts_range.begin = ts_begin;
+	new_ts_range.end = ts_end;
+
+	{
+		const auto msg_reg_contact = reg.ctx().get<Contact4>();
+		if (_cs.registry().all_of<Contact::Components::ID>(msg_reg_contact)) {
+			fh.emplace<ObjComp::MessagesContact>(_cs.registry().get<Contact::Components::ID>(msg_reg_contact).data);
+		} else {
+			// ? rage quit?
+		}
+	}
+
+	{ // dictionary, contact specific or default
+		uint32_t dict_id = _default_dictionary;
+		if (fh.all_of<ObjComp::MessagesContact>()) {
+			if (const auto it = _contact_dictionaries.find(fh.get<ObjComp::MessagesContact>().id); it != _contact_dictionaries.cend()) {
+				dict_id = it->second;
+			}
+		}
+
+		if (dict_id != 0 && _dictionaries.contains(dict_id)) {
+			fh.emplace_or_replace<ObjComp::MessagesDictionary>(dict_id);
+			// we compress ourselfs
+			fh.emplace_or_replace<ObjComp::DataCompressionType>().comp = Compression::NONE;
+		}
+	}
+
+	// contact frag
+	if (!reg.ctx().contains<Message::Contexts::ContactFragments>()) {
+		reg.ctx().emplace<Message::Contexts::ContactFragments>();
+	}
+	reg.ctx().get<Message::Contexts::ContactFragments>().insert(fh);
+
+	// loaded contact frag
+	if (!reg.ctx().contains<Message::Contexts::LoadedContactFragments>()) {
+		reg.ctx().emplace<Message::Contexts::LoadedContactFragments>();
+	}
+	reg.ctx().get<Message::Contexts::LoadedContactFragments>().loaded_frags.emplace(fh);
+
+	if (logs(LogLevel::info)) {
+		std::cout << "MFS: created new fragment " << bin2hex(fh.get<ObjComp::ID>().v) << "\n";
+	}
+
+	_fs_ignore_event = true;
+	_os.throwEventConstruct(fh);
+	_fs_ignore_event = false;
+
+	return fh;
 }
 
 void MessageFragmentStore::handleMessage(const Message3Handle& m) {
@@ -90,9 +254,17 @@ void MessageFragmentStore::handleMessage(const Message3Handle& m) {
 	if (m.any_of<Message::Components::ViewCurserBegin, Message::Components::ViewCurserEnd>()) {
 		// not an actual message, but we probalby need to check and see if we need to load fragments
 		//std::cout << "MFS: new or updated curser\n";
+		sampleViewMotion(m);
 		return;
 	}
 
+	if (m.all_of<Message::Components::ContactFrom, Message::Components::ContactTo>()) {
+		// keep the dedup index current, so fragment loads find live messages
+		if (const auto* dk = dedupKeyOf(*m.registry()); dk != nullptr) {
+			dedupIndex(*m.registry(), *dk).add(dk->fn(m), m);
+		}
+	}
+
 	// TODO: this is bad, we need a non persistence tag instead
 	//if (!m.any_of<Message::Components::MessageText, Message::Components::MessageFileObject>()) {
 	if (!m.any_of<Message::Components::MessageText>()) { // fix file message object storage first!
@@ -104,12 +276,15 @@ void MessageFragmentStore::handleMessage(const Message3Handle& m) {
 
 	// TODO: use fid, saving full fuid for every message consumes alot of memory (and heap frag)
 	if (!m.all_of<Message::Components::MFSObj>()) {
-		std::cout << "MFS: new msg missing Object\n";
+		if (logs(LogLevel::debug)) {
+			std::cout << "MFS: new msg missing Object\n";
+		}
 		if (!m.registry()->ctx().contains<Message::Contexts::OpenFragments>()) {
 			m.registry()->ctx().emplace<Message::Contexts::OpenFragments>();
 		}
 
-		auto& fid_open = m.registry()->ctx().get<Message::Contexts::OpenFragments>().open_frags;
+		auto& open = m.registry()->ctx().get<Message::Contexts::OpenFragments>();
+		auto& fid_open = open.open_frags;
 
 		const auto msg_ts = m.get<Message::Components::Timestamp>().ts;
 		// missing fuid
@@ -118,123 +293,72 @@ void MessageFragmentStore::handleMessage(const Message3Handle& m) {
 		Object fragment_id{entt::null};
 
 		// first search for fragment where the ts falls into the range
-		for (const auto& fid : fid_open) {
-			auto fh = _os.objectHandle(fid);
-			assert(static_cast<bool>(fh));
-
-			// assuming ts range exists
-			auto& fts_comp = fh.get<ObjComp::MessagesTSRange>();
-
-			if (fts_comp.begin <= msg_ts && fts_comp.end >= msg_ts) {
+		std::vector<Object> containing_frags;
+		open.placeable.overlapping(msg_ts, msg_ts, containing_frags);
+		for (const auto fid : containing_frags) {
+			if (placeableInto(*m.registry(), fid)) {
 				fragment_id = fid;
-				// TODO: check conditions for open here
-				// TODO: mark msg (and frag?) dirty
+				break;
 			}
 		}
 
-		// if it did not fit into an existing fragment, we next look for fragments that could be extended
-		if (!_os._reg.valid(fragment_id)) {
-			for (const auto& fid : fid_open) {
+		// if it did not fit into an existing fragment, we next look for the closest fragments that could be extended
+		// (none of them contain msg_ts, so newer ones begin after and older ones end before)
+		if (!_os.registry().valid(fragment_id)) {
+			const auto extend = [&](Object fid, bool into_past) {
 				auto fh = _os.objectHandle(fid);
 				assert(static_cast<bool>(fh));
 
 				// assuming ts range exists
 				auto& fts_comp = fh.get<ObjComp::MessagesTSRange>();
 
-				const int64_t frag_range = int64_t(fts_comp.end) - int64_t(fts_comp.begin);
-				constexpr static int64_t max_frag_ts_extent {1000*60*60};
-				//constexpr static int64_t max_frag_ts_extent {1000*60*3}; // 3min for testing
-				const int64_t possible_extention = max_frag_ts_extent - frag_range;
-
-				// which direction
-				if ((fts_comp.begin - possible_extention) <= msg_ts && fts_comp.begin > msg_ts) {
-					fragment_id = fid;
-
-					std::cout << "MFS: extended begin from " << fts_comp.begin << " to " << msg_ts << "\n";
+				const uint64_t new_extent = into_past ? fts_comp.end - msg_ts : msg_ts - fts_comp.begin;
+				if (new_extent > _seal_policy.max_ts_extent || !placeableInto(*m.registry(), fid)) {
+					return false;
+				}
 
-					// assuming ts range exists
+				if (into_past) {
+					if (logs(LogLevel::debug)) {
+						std::cout << "MFS: extended begin from " << fts_comp.begin << " to " << msg_ts << "\n";
+					}
 					fts_comp.begin = msg_ts; // extend into the past
-
-					if (m.registry()->ctx().contains<Message::Contexts::ContactFragments>()) {
-						// should be the case
-						m.registry()->ctx().get<Message::Contexts::ContactFragments>().erase(fh);
-						m.registry()->ctx().get<Message::Contexts::ContactFragments>().insert(fh);
+				} else {
+					if (logs(LogLevel::debug)) {
+						std::cout << "MFS: extended end from " << fts_comp.end << " to " << msg_ts << "\n";
 					}
-
-
-					// TODO: check conditions for open here
-					// TODO: mark msg (and frag?) dirty
-				} else if ((fts_comp.end + possible_extention) >= msg_ts && fts_comp.end < msg_ts) {
-					fragment_id = fid;
-
-					std::cout << "MFS: extended end from " << fts_comp.end << " to " << msg_ts << "\n";
-
-					// assuming ts range exists
 					fts_comp.end = msg_ts; // extend into the future
+				}
 
-					if (m.registry()->ctx().contains<Message::Contexts::ContactFragments>()) {
-						// should be the case
-						m.registry()->ctx().get<Message::Contexts::ContactFragments>().erase(fh);
-						m.registry()->ctx().get<Message::Contexts::ContactFragments>().insert(fh);
-					}
-
-					// TODO: check conditions for open here
-					// TODO: mark msg (and frag?) dirty
+				// the indices cache the range
+				open.placeable.erase(fid);
+				open.placeable.insert(fh);
+				if (m.registry()->ctx().contains<Message::Contexts::ContactFragments>()) {
+					// should be the case
+					m.registry()->ctx().get<Message::Contexts::ContactFragments>().erase(fh);
+					m.registry()->ctx().get<Message::Contexts::ContactFragments>().insert(fh);
 				}
+
+				// TODO: mark msg (and frag?) dirty
+				return true;
+			};
+
+			const Object newer = open.placeable.firstEndAtOrAfter(msg_ts);
+			const Object older = open.placeable.lastBeginBefore(msg_ts);
+			if (newer != entt::null && extend(newer, true)) {
+				fragment_id = newer;
+			} else if (older != entt::null && extend(older, false)) {
+				fragment_id = older;
 			}
 		}
 
 		// if its still not found, we need a new fragment
 		if (!_os.registry().valid(fragment_id)) {
-			const auto new_uuid = _session_uuid_gen();
-			_fs_ignore_event = true;
-			auto fh = _sbm.newObject(ByteSpan{new_uuid});
-			// TODO: the backend should have done that?
-			fh.emplace_or_replace<ObjComp::Ephemeral::BackendAtomic>(&_sba);
-			_fs_ignore_event = false;
-			if (!static_cast<bool>(fh)) {
-				std::cout << "MFS error: failed to create new object for message\n";
-				return;
-			}
-
-			fragment_id = fh;
-
-			fh.emplace_or_replace<ObjComp::Ephemeral::MetaCompressionType>().comp = Compression::ZSTD;
-			fh.emplace_or_replace<ObjComp::DataCompressionType>().comp = Compression::ZSTD;
-			fh.emplace_or_replace<ObjComp::MessagesVersion>(); // default is current
-
-			auto& new_ts_range = fh.emplace_or_replace<ObjComp::MessagesTSRange>();
-			new_ts_range.begin = msg_ts;
-			new_ts_range.end = msg_ts;
-
-			{
-				const auto msg_reg_contact = m.registry()->ctx().get<Contact4>();
-				if (_cs.registry().all_of<Contact::Components::ID>(msg_reg_contact)) {
-					fh.emplace<ObjComp::MessagesContact>(_cs.registry().get<Contact::Components::ID>(msg_reg_contact).data);
-				} else {
-					// ? rage quit?
-				}
-			}
-
-			// contact frag
-			if (!m.registry()->ctx().contains<Message::Contexts::ContactFragments>()) {
-				m.registry()->ctx().emplace<Message::Contexts::ContactFragments>();
-			}
-			m.registry()->ctx().get<Message::Contexts::ContactFragments>().insert(fh);
-
-			// loaded contact frag
-			if (!m.registry()->ctx().contains<Message::Contexts::LoadedContactFragments>()) {
-				m.registry()->ctx().emplace<Message::Contexts::LoadedContactFragments>();
+			auto fh = newFragment(*m.registry(), msg_ts, msg_ts);
+			if (static_cast<bool>(fh)) {
+				fragment_id = fh;
+				fid_open.emplace(fragment_id);
+				open.placeable.insert(fh);
 			}
-			m.registry()->ctx().get<Message::Contexts::LoadedContactFragments>().loaded_frags.emplace(fh);
-
-			fid_open.emplace(fragment_id);
-
-			std::cout << "MFS: created new fragment " << bin2hex(fh.get<ObjComp::ID>().v) << "\n";
-
-			_fs_ignore_event = true;
-			_os.throwEventConstruct(fh);
-			_fs_ignore_event = false;
 		}
 
 		// if this is still empty, something is very wrong and we exit here
@@ -244,16 +368,10 @@ void MessageFragmentStore::handleMessage(const Message3Handle& m) {
 		}
 
 		m.emplace_or_replace<Message::Components::MFSObj>(fragment_id);
+		addToFragmentMessages(*m.registry(), fragment_id, m);
 
 		// in this case we know the fragment needs an update
-		// TODO: refactor extract
-		for (const auto& it : _frag_save_queue) {
-			if (it.id == fragment_id) {
-				// already in queue
-				return; // done
-			}
-		}
-		_frag_save_queue.push_back({getTimeMS(), {_os.registry(), fragment_id}, m.registry()});
+		queueFragSave({_os.registry(), fragment_id}, m.registry());
 		return; // done
 	}
 
@@ -269,16 +387,11 @@ void MessageFragmentStore::handleMessage(const Message3Handle& m) {
 
 	auto& fid_open = m.registry()->ctx().get<Message::Contexts::OpenFragments>().open_frags;
 
+	// cheap, and makes sure messages that got their object from elsewhere are known
+	addToFragmentMessages(*m.registry(), msg_fh, m);
+
 	if (fid_open.contains(msg_fh)) {
-		// TODO: cooldown per fragsave
-		// TODO: refactor extract
-		for (const auto& it : _frag_save_queue) {
-			if (it.id == msg_fh) {
-				// already in queue
-				return; // done
-			}
-		}
-		_frag_save_queue.push_back({getTimeMS(), msg_fh, m.registry()});
+		queueFragSave(msg_fh, m.registry());
 		return;
 	}
 
@@ -292,350 +405,1929 @@ void MessageFragmentStore::handleMessage(const Message3Handle& m) {
 
 // assumes not loaded frag
 // need update from frag
-void MessageFragmentStore::loadFragment(Message3Registry& reg, ObjectHandle fh) {
+// returns 0 if the fragment can not be loaded
+static uint16_t loadableVersion(ObjectHandle fh) {
 	if (!fh) {
 		std::cerr << "MFS error: loadFragment called with invalid object!!!\n";
 		assert(false);
-		return;
+		return 0;
 	}
 
-	std::cout << "MFS: loadFragment\n";
 	// version HAS to be set, or we just fail
 	if (!fh.all_of<ObjComp::MessagesVersion>()) {
 		std::cerr << "MFS error: nope, object without version, cant load\n";
-		return;
+		return 0;
 	}
 
-	nlohmann::json j;
 	const auto obj_version = fh.get<ObjComp::MessagesVersion>().v;
-	if (obj_version == 1 || obj_version == 2) {
-		j = loadFromStorageNJ(fh); // also handles version and json/msgpack
-	} else {
+	if (obj_version < 1 || obj_version > 3) {
 		std::cerr << "MFS error: nope, object with unknown version, cant load\n";
-		return;
+		return 0;
 	}
 
-	if (!j.is_array()) {
-		// wrong data
-		fh.emplace_or_replace<ObjComp::Ephemeral::MessagesEmptyTag>();
-		return;
+	return obj_version;
+}
+
+void MessageFragmentStore::sampleViewMotion(const Message3Handle& curser) {
+	auto& reg = *curser.registry();
+
+	// motion is tracked per begin curser
+	Message3 view {entt::null};
+	if (curser.all_of<Message::Components::ViewCurserBegin>()) {
+		view = curser;
+	} else {
+		for (const auto& [m, vcb] : reg.view<Message::Components::ViewCurserBegin>().each()) {
+			if (vcb.curser_end == curser.entity()) {
+				view = m;
+				break;
+			}
+		}
 	}
 
-	if (j.size() == 0) {
-		// empty array
-		fh.emplace_or_replace<ObjComp::Ephemeral::MessagesEmptyTag>();
+	if (!reg.valid(view) || !reg.all_of<Message::Components::Timestamp>(view)) {
 		return;
 	}
 
-	// TODO: this should probably never be the case, since we already know here that it is a msg frag
-	if (!reg.ctx().contains<Message::Contexts::ContactFragments>()) {
-		reg.ctx().emplace<Message::Contexts::ContactFragments>();
+	uint64_t ts_begin = reg.get<Message::Components::Timestamp>(view).ts;
+	uint64_t ts_end = ts_begin;
+	const auto curser_end = reg.get<Message::Components::ViewCurserBegin>(view).curser_end;
+	if (reg.valid(curser_end) && reg.all_of<Message::Components::Timestamp>(curser_end)) {
+		ts_end = reg.get<Message::Components::Timestamp>(curser_end).ts;
 	}
-	reg.ctx().get<Message::Contexts::ContactFragments>().insert(fh);
 
-	// mark loaded
-	if (!reg.ctx().contains<Message::Contexts::LoadedContactFragments>()) {
-		reg.ctx().emplace<Message::Contexts::LoadedContactFragments>();
+	if (!reg.ctx().contains<Message::Contexts::ViewMotion>()) {
+		reg.ctx().emplace<Message::Contexts::ViewMotion>();
 	}
-	reg.ctx().get<Message::Contexts::LoadedContactFragments>().loaded_frags.emplace(fh);
+	reg.ctx().get<Message::Contexts::ViewMotion>().sample(view, ts_begin/2 + ts_end/2, getTimeMS());
+}
 
-	size_t messages_new_or_updated {0};
-	for (const auto& j_entry : j) {
-		auto new_real_msg = Message3Handle{reg, reg.create()};
-		// load into staging reg
-		for (const auto& [k, v] : j_entry.items()) {
-			//std::cout << "K:" << k << " V:" << v.dump() << "\n";
-			const auto type_id = entt::hashed_string(k.data(), k.size());
-			const auto deserl_fn_it = _scnj._deserl_json.find(type_id);
-			if (deserl_fn_it != _scnj._deserl_json.cend()) {
-				try {
-					if (!deserl_fn_it->second(_scnj, new_real_msg, v)) {
-						std::cerr << "MFS error: failed deserializing '" << k << "'\n";
-					}
-				} catch(...) {
-					std::cerr << "MFS error: failed deserializing (threw) '" << k << "'\n";
-				}
-			} else {
-				std::cerr << "MFS warning: missing deserializer for meta key '" << k << "'\n";
+bool MessageFragmentStore::prefetchViews(Message3Registry& reg, const Message::Contexts::ContactFragments& cf) {
+	if (_prefetch_lookahead_ms == 0 || _prefetch_max_frags == 0 || !reg.ctx().contains<Message::Contexts::ViewMotion>()) {
+		return false;
+	}
+
+	const auto ts_now = getTimeMS();
+	const auto* lcf = reg.ctx().find<Message::Contexts::LoadedContactFragments>();
+
+	for (auto&& [view, track] : reg.ctx().get<Message::Contexts::ViewMotion>().views) {
+		if (track.ts_last_move + 1000 < ts_now || track.velocity == 0.f) {
+			continue; // idle, dont speculate
+		}
+
+		if (!reg.valid(view) || !reg.all_of<Message::Components::Timestamp, Message::Components::ViewCurserBegin>(view)) {
+			continue;
+		}
+
+		auto ts_begin = reg.get<Message::Components::Timestamp>(view).ts;
+		auto ts_end = ts_begin;
+		const auto curser_end = reg.get<Message::Components::ViewCurserBegin>(view).curser_end;
+		if (reg.valid(curser_end) && reg.all_of<Message::Components::Timestamp>(curser_end)) {
+			ts_end = reg.get<Message::Components::Timestamp>(curser_end).ts;
+			if (ts_end > ts_begin) {
+				std::swap(ts_begin, ts_end);
 			}
 		}
 
-		new_real_msg.emplace_or_replace<Message::Components::MFSObj>(fh);
+		// where the view will be in lookahead time
+		const uint64_t span = static_cast<uint64_t>(std::abs(track.velocity) * static_cast<float>(_prefetch_lookahead_ms));
+		if (span == 0) {
+			continue;
+		}
 
-		// dup check (hacky, specific to protocols)
-		Message3 dup_msg {entt::null};
-		{
-			// get comparator from contact
-			if (reg.ctx().contains<Contact4>()) {
-				const auto c = reg.ctx().get<Contact4>();
-				if (_cs.registry().all_of<Contact::Components::MessageIsSame>(c)) {
-					auto& comp = _cs.registry().get<Contact::Components::MessageIsSame>(c).comp;
-					// walking EVERY existing message OOF
-					// this needs optimizing
-					for (const Message3 other_msg : reg.view<Message::Components::Timestamp, Message::Components::ContactFrom, Message::Components::ContactTo>()) {
-						if (other_msg == new_real_msg) {
-							continue; // skip self
-						}
+		const bool newer = track.velocity > 0.f;
+		Object frag = newer ? cf.firstEndAtOrAfter(ts_begin) : cf.lastBeginBefore(ts_end);
+		for (size_t i = 0; i < _prefetch_max_frags && frag != entt::null; i++, frag = newer ? cf.next(frag) : cf.prev(frag)) {
+			auto fh = _os.objectHandle(frag);
+			if (!static_cast<bool>(fh) || !fh.all_of<ObjComp::MessagesTSRange>()) {
+				continue;
+			}
 
-						if (comp({reg, other_msg}, new_real_msg)) {
-							// dup
-							dup_msg = other_msg;
-							break;
-						}
-					}
-				}
+			const auto& range = fh.get<ObjComp::MessagesTSRange>();
+			if (newer ? (range.begin > ts_begin && range.begin - ts_begin > span) : (range.end < ts_end && ts_end - range.end > span)) {
+				break; // too far ahead
 			}
-		}
 
-		if (reg.valid(dup_msg)) {
-			//  -> merge with preexisting (needs to be order independent)
-			//  -> throw update
-			reg.destroy(new_real_msg);
-			//messages_new_or_updated++; // TODO: how do i know on merging, if data was useful
-			//_rmm.throwEventUpdate(reg, new_real_msg);
-		} else {
-			if (!new_real_msg.all_of<Message::Components::Timestamp, Message::Components::ContactFrom, Message::Components::ContactTo>()) {
-				// does not have needed components to be stand alone
-				reg.destroy(new_real_msg);
-				std::cerr << "MFS warning: message with missing basic compoments\n";
+			if (
+				fh.all_of<ObjComp::Ephemeral::MessagesEmptyTag>() ||
+				(lcf != nullptr && lcf->loaded(frag)) ||
+				loadPending(frag)
+			) {
 				continue;
 			}
 
-			messages_new_or_updated++;
-			//  -> throw create
-			_rmm.throwEventConstruct(reg, new_real_msg);
+			if (logs(LogLevel::debug)) {
+				std::cout << "MFS: prefetch frag in scroll direction\n";
+			}
+			_prefetched.emplace(frag);
+			_prefetch_stats.issued++;
+			requestLoadFragment(reg, fh);
+			if (!_loader_pool || _loader_pool->full()) {
+				return true;
+			}
 		}
 	}
 
-	if (messages_new_or_updated == 0) {
-		// useless frag
-		// TODO: unload?
-		fh.emplace_or_replace<ObjComp::Ephemeral::MessagesEmptyTag>();
-	}
+	return false;
 }
 
-bool MessageFragmentStore::syncFragToStorage(ObjectHandle fh, Message3Registry& reg) {
-	auto& ftsrange = fh.get_or_emplace<ObjComp::MessagesTSRange>(getTimeMS(), getTimeMS());
+void MessageFragmentStore::setPrefetch(float lookahead_seconds, size_t max_frags) {
+	_prefetch_lookahead_ms = static_cast<uint64_t>(lookahead_seconds * 1000.f);
+	_prefetch_max_frags = max_frags;
+}
 
-	auto j = nlohmann::json::array();
+void MessageFragmentStore::loadFragment(Message3Registry& reg, ObjectHandle fh, uint64_t view_lo, uint64_t view_hi) {
+	if (logs(LogLevel::debug)) {
+		std::cout << "MFS: loadFragment\n";
+	}
+	const auto requested = std::chrono::steady_clock::now();
+	const auto obj_version = loadableVersion(fh);
+	if (obj_version == 0) {
+		if (static_cast<bool>(fh)) {
+			// dont try again
+			fh.emplace_or_replace<ObjComp::Ephemeral::MessagesEmptyTag>();
+		}
+		_metrics.fragments_load_failed++;
+		return;
+	}
 
-	// TODO: does every message have ts?
-	auto msg_view = reg.view<Message::Components::Timestamp>();
-	// we also assume all messages have an associated object
-	for (auto it = msg_view.rbegin(), it_end = msg_view.rend(); it != it_end; it++) {
-		const Message3 m = *it;
+	std::shared_ptr<const FragmentDictionary> dict;
+	if (!fragmentDictionary(fh, dict)) {
+		// dont try again
+		fh.emplace_or_replace<ObjComp::Ephemeral::MessagesEmptyTag>();
+		_metrics.fragments_load_failed++;
+		return;
+	}
 
-		if (!reg.all_of<Message::Components::MFSObj, Message::Components::ContactFrom, Message::Components::ContactTo>(m)) {
-			continue;
-		}
+	std::vector<uint8_t> data;
+	if (!readFromStorage(fh, data)) {
+		// wrong data
+		fh.emplace_or_replace<ObjComp::Ephemeral::MessagesEmptyTag>();
+		_metrics.fragments_load_failed++;
+		return;
+	}
 
-		// filter: require msg for now
-		// this will be removed in the future
-		if (!reg.any_of<Message::Components::MessageText>(m)) {
-		// fix message file objects first
-		//if (!reg.any_of<Message::Components::MessageText, Message::Components::MessageFileObject>(m)) {
-			continue;
+	if (dict && !data.empty()) {
+		std::vector<uint8_t> dict_data;
+		if (!dict->decompress(ByteSpan{data}, dict_data)) {
+			// wrong data
+			fh.emplace_or_replace<ObjComp::Ephemeral::MessagesEmptyTag>();
+			_metrics.fragments_load_failed++;
+			return;
 		}
+		data.swap(dict_data);
+	}
 
-		if (fh != reg.get<Message::Components::MFSObj>(m).o) {
-			continue; // not ours
-		}
+	const auto slice = fragmentSlice(reg, fh, obj_version, view_lo, view_hi);
+	MessageRows rows;
+	commitFragmentData(reg, fh, requested, data.size(), rows, [obj_version, &data, &slice, &rows](MessagesDecodeSinkI& sink) {
+		return decodeFragmentSlice(obj_version, ByteSpan{data}, slice, sink, rows);
+	});
+}
 
-		{ // potentially adjust tsrange (some external processes can change timestamps)
-			const auto msg_ts = msg_view.get<Message::Components::Timestamp>(m).ts;
-			if (ftsrange.begin > msg_ts) {
-				ftsrange.begin = msg_ts;
-			} else if (ftsrange.end < msg_ts) {
-				ftsrange.end = msg_ts;
-			}
+void MessageFragmentStore::requestLoadFragment(Message3Registry& reg, ObjectHandle fh, uint64_t view_lo, uint64_t view_hi) {
+	if (!_loader_pool) {
+		loadFragment(reg, fh, view_lo, view_hi);
+		return;
+	}
+
+	const auto obj_version = loadableVersion(fh);
+	if (obj_version == 0) {
+		if (static_cast<bool>(fh)) {
+			// dont try again
+			fh.emplace_or_replace<ObjComp::Ephemeral::MessagesEmptyTag>();
 		}
+		return;
+	}
 
-		auto& j_entry = j.emplace_back(nlohmann::json::object());
+	if (!reg.ctx().contains<Contact4>()) {
+		// should never happen
+		loadFragment(reg, fh, view_lo, view_hi);
+		return;
+	}
 
-		for (const auto& [type_id, storage] : reg.storage()) {
-			if (!storage.contains(m)) {
-				continue;
-			}
+	std::shared_ptr<const FragmentDictionary> dict;
+	if (!fragmentDictionary(fh, dict)) {
+		// dont try again
+		fh.emplace_or_replace<ObjComp::Ephemeral::MessagesEmptyTag>();
+		return;
+	}
 
-			//std::cout << "storage type: type_id:" << type_id << " name:" << storage.type().name() << "\n";
+	if (_loader_pool->submit(fh, reg.ctx().get<Contact4>(), obj_version, std::move(dict), fragmentSlice(reg, fh, obj_version, view_lo, view_hi))) {
+		if (logs(LogLevel::debug)) {
+			std::cout << "MFS: queued loadFragment\n";
+		}
+	}
+}
 
-			// use type_id to find serializer
-			auto s_cb_it = _scnj._serl_json.find(type_id);
-			if (s_cb_it == _scnj._serl_json.end()) {
-				// could not find serializer, not saving
-				//std::cout << "missing " << storage.type().name() << "(" << type_id << ")\n";
-				continue;
-			}
+FragmentSlice MessageFragmentStore::fragmentSlice(Message3Registry& reg, ObjectHandle fh, uint16_t version, uint64_t view_lo, uint64_t view_hi) const {
+	FragmentSlice slice;
 
-			try {
-				s_cb_it->second(_scnj, {reg, m}, j_entry[storage.type().name()]);
-			} catch (...) {
-				std::cerr << "MFS error: failed to serialize " << storage.type().name() << "(" << type_id << ")\n";
-			}
+	if (const auto* lcf = reg.ctx().find<Message::Contexts::LoadedContactFragments>(); lcf != nullptr) {
+		if (const auto it = lcf->partial.find(fh); it != lcf->partial.cend()) {
+			slice.mode = FragmentSlice::Mode::rest;
+			slice.loaded = it->second;
+			return slice;
 		}
 	}
 
-	// we cant skip if array is empty (in theory it will not be empty later on)
+	// only v3 has a row index
+	if (version != 3 || !fh.all_of<ObjComp::MessagesTSRange>()) {
+		return slice;
+	}
 
-	std::vector<uint8_t> data_to_save;
-	const auto obj_version = fh.get_or_emplace<ObjComp::MessagesVersion>().v;
-	if (obj_version == 1) {
-		auto j_dump = j.dump(2, ' ', true);
-		data_to_save = std::vector<uint8_t>(j_dump.cbegin(), j_dump.cend());
-	} else if (obj_version == 2) {
-		data_to_save = nlohmann::json::to_msgpack(j);
-	} else {
-		std::cerr << "MFS error: unknown object version\n";
-		assert(false);
+	const auto& range = fh.get<ObjComp::MessagesTSRange>();
+	if (view_lo <= range.begin && view_hi >= range.end) {
+		return slice; // view covers all of it
 	}
-	assert(fh.all_of<ObjComp::Ephemeral::BackendAtomic>());
-	auto* backend = fh.get<ObjComp::Ephemeral::BackendAtomic>().ptr;
-	if (backend->write(fh, {reinterpret_cast<const uint8_t*>(data_to_save.data()), data_to_save.size()})) {
-		// TODO: make this better, should this be called on fail? should this be called before sync? (prob not)
-		_fs_ignore_event = true;
-		_os.throwEventUpdate(fh);
-		_fs_ignore_event = false;
 
-		//std::cout << "MFS: dumped " << j_dump << "\n";
-		// succ
+	slice.mode = FragmentSlice::Mode::view;
+	slice.ts_lo = view_lo;
+	slice.ts_hi = view_hi;
+	return slice;
+}
+
+bool MessageFragmentStore::fragmentDictionary(ObjectHandle fh, std::shared_ptr<const FragmentDictionary>& dict) const {
+	dict.reset();
+	if (!fh.all_of<ObjComp::MessagesDictionary>()) {
 		return true;
 	}
 
-	// TODO: error
-	return false;
+	const auto dict_id = fh.get<ObjComp::MessagesDictionary>().id;
+	const auto it = _dictionaries.find(dict_id);
+	if (it == _dictionaries.cend()) {
+		std::cerr << "MFS error: missing dictionary " << dict_id << " for fragment " << bin2hex(fh.get<ObjComp::ID>().v) << "\n";
+		return false;
+	}
+
+	dict = it->second;
+	return true;
 }
 
-MessageFragmentStore::MessageFragmentStore(
-	ContactStore4I& cs,
-	RegistryMessageModelI& rmm,
-	ObjectStore2& os,
-	StorageBackendIMeta& sbm,
-	StorageBackendIAtomic& sba,
-	MessageSerializerNJ& scnj
-) : _cs(cs), _rmm(rmm), _rmm_sr(_rmm.newSubRef(this)), _os(os), _os_sr(_os.newSubRef(this)), _sbm(sbm), _sba(sba), _scnj(scnj) {
-	_rmm_sr
-		.subscribe(RegistryMessageModel_Event::message_construct)
-		.subscribe(RegistryMessageModel_Event::message_updated)
-		.subscribe(RegistryMessageModel_Event::message_destroy)
+uint32_t MessageFragmentStore::addDictionary(ByteSpan dict_data) {
+	auto dict = FragmentDictionary::create(dict_data);
+	if (!dict) {
+		return 0;
+	}
+
+	const auto dict_id = dict->id();
+	_dictionaries.insert_or_assign(dict_id, std::move(dict));
+	if (logs(LogLevel::info)) {
+		std::cout << "MFS: added dictionary " << dict_id << "\n";
+	}
+
+	return dict_id;
+}
+
+void MessageFragmentStore::setDictionary(uint32_t dict_id) {
+	_default_dictionary = dict_id;
+}
+
+void MessageFragmentStore::setContactDictionary(const std::vector<uint8_t>& contact_id, uint32_t dict_id) {
+	_contact_dictionaries.insert_or_assign(contact_id, dict_id);
+}
+
+void MessageFragmentStore::enableCatalog(std::filesystem::path catalog_path, std::filesystem::path storage_path) {
+	_catalog = std::make_unique<FragmentCatalog>(std::move(catalog_path), std::move(storage_path));
+}
+
+bool MessageFragmentStore::loadCatalog(void) {
+	if (!_catalog) {
+		return false;
+	}
+	if (!_catalog->load()) {
+		if (_catalog->staleReason() != nullptr && logs(LogLevel::info)) {
+			std::cout << "MFS: fragment catalog " << _catalog->staleReason() << ", rescanning\n";
+		}
+		return false;
+	}
+
+	if (logs(LogLevel::info)) {
+		std::cout << "MFS: restoring " << _catalog->size() << " fragments from catalog\n";
+	}
+	_catalog->restore(_os, _sbm, _sba, [this](ObjectHandle fh) {
+		// same as a scan, everyone gets to see it
+		_os.throwEventConstruct(fh);
+	});
+
+	return true;
+}
+
+void MessageFragmentStore::saveCatalog(void) {
+	if (!_catalog->save()) {
+		return; // logged already
+	}
+
+	if (logs(LogLevel::info)) {
+		std::cout << "MFS: saved fragment catalog with " << _catalog->size() << " fragments (" << _catalog->fileSize() << " bytes)\n";
+	}
+}
+
+void MessageFragmentStore::catalogUpdate(ObjectHandle fh) {
+	if (!_catalog || !fh.all_of<ObjComp::Ephemeral::BackendAtomic>() || fh.get<ObjComp::Ephemeral::BackendAtomic>().ptr != &_sba) {
+		return;
+	}
+
+	_catalog->update(fh);
+}
+
+bool MessageFragmentStore::loadPending(Object frag) const {
+	return _loader_pool && _loader_pool->pending(frag);
+}
+
+void MessageFragmentStore::enableLoaderPool(FragmentLoaderPool::BackendFactory backend_factory, size_t worker_count, size_t max_in_flight) {
+	_loader_pool = std::make_unique<FragmentLoaderPool>(std::move(backend_factory), worker_count, max_in_flight);
+}
+
+void MessageFragmentStore::commitFragmentData(Message3Registry& reg, ObjectHandle fh, std::chrono::steady_clock::time_point requested, size_t data_size, const MessageRows& partial_rows, const std::function<bool(MessagesDecodeSinkI&)>& decode_fn) {
+	// creates the messages while decoding
+	struct LoadSink : public MessagesDecodeSinkI {
+		MessageFragmentStore& mfs;
+		Message3Registry& reg;
+		ObjectHandle fh;
+		const Contact::Components::MessageDedupKey* dk {nullptr};
+
+		Message3Handle new_real_msg;
+		size_t entries {0};
+		size_t messages_new_or_updated {0};
+		bool has_message_count {false};
+		uint64_t message_count {0};
+
+		LoadSink(MessageFragmentStore& mfs_, Message3Registry& reg_, ObjectHandle fh_) : mfs(mfs_), reg(reg_), fh(fh_) {
+			dk = mfs.dedupKeyOf(reg);
+		}
+
+		void beginEntry(void) override {
+			if (entries++ == 0) {
+				// first entry, we now know its a messages fragment with content
+
+				// TODO: this should probably never be the case, since we already know here that it is a msg frag
+				if (!reg.ctx().contains<Message::Contexts::ContactFragments>()) {
+					reg.ctx().emplace<Message::Contexts::ContactFragments>();
+				}
+				reg.ctx().get<Message::Contexts::ContactFragments>().insert(fh);
+
+				// mark loaded
+				if (!reg.ctx().contains<Message::Contexts::LoadedContactFragments>()) {
+					reg.ctx().emplace<Message::Contexts::LoadedContactFragments>();
+				}
+				auto& lcf = reg.ctx().get<Message::Contexts::LoadedContactFragments>();
+				if (!lcf.partial.contains(fh)) {
+					lcf.loaded_frags.emplace(fh);
+				}
+			}
+
+			new_real_msg = Message3Handle{reg, reg.create()};
+		}
+
+		void component(entt::id_type type_id, std::string_view name, const nlohmann::json& v) override {
+			const auto deserl_fn_it = mfs._scnj._deserl_json.find(type_id);
+			if (deserl_fn_it != mfs._scnj._deserl_json.cend()) {
+				try {
+					if (!deserl_fn_it->second(mfs._scnj, new_real_msg, v)) {
+						std::cerr << "MFS error: failed deserializing '" << name << "'\n";
+					}
+				} catch(...) {
+					std::cerr << "MFS error: failed deserializing (threw) '" << name << "'\n";
+				}
+			} else {
+				if (mfs.logs(LogLevel::warning)) {
+					std::cerr << "MFS warning: missing deserializer for meta key '" << name << "'\n";
+				}
+			}
+		}
+
+		void endEntry(void) override {
+			mfs.commitLoadedMessage(reg, fh, new_real_msg, dk, messages_new_or_updated);
+			new_real_msg = {};
+		}
+
+		void messageCount(uint64_t count) override {
+			has_message_count = true;
+			message_count = count;
+		}
+	} sink{*this, reg, fh};
+
+	if (!reg.ctx().contains<Message::Contexts::LoadedContactFragments>()) {
+		reg.ctx().emplace<Message::Contexts::LoadedContactFragments>();
+	}
+	auto& lcf = reg.ctx().get<Message::Contexts::LoadedContactFragments>();
+
+	const auto account = [this, &sink, requested, data_size](bool ok) {
+		_metrics.messages_loaded += sink.messages_new_or_updated;
+		if (!ok) {
+			_metrics.fragments_load_failed++;
+			return;
+		}
+		_metrics.fragments_loaded++;
+		_metrics.bytes_read += data_size;
+		_metrics.load_latency.record(std::chrono::steady_clock::now() - requested);
+	};
+
+	// keeps the messages, but the fragment is neither loaded nor saveable
+	const auto decode_error = [this, &lcf, &fh, &sink]() {
+		std::cerr << "MFS error: fragment " << bin2hex(fh.get<ObjComp::ID>().v) << " is broken, only " << sink.entries << " messages could be decoded, it will not be written\n";
+		fh.emplace_or_replace<ObjComp::Ephemeral::MessagesDecodeErrorTag>();
+		fh.emplace_or_replace<ObjComp::Ephemeral::MessagesEmptyTag>();
+		lcf.erase(fh);
+		_frag_save_queue.erase(fh);
+		_save_failures.erase(fh);
+	};
+
+	if (const auto partial_it = lcf.partial.find(fh); partial_it != lcf.partial.end()) {
+		// loaded the rest
+		const auto loaded_rows = partial_it->second;
+		const bool ok = decode_fn(sink) && sink.entries == loaded_rows.total - (loaded_rows.end - loaded_rows.begin);
+		account(ok);
+		if (!ok) {
+			decode_error();
+			return;
+		}
+
+		fh.emplace_or_replace<ObjComp::Ephemeral::MessagesDecodedCount>(loaded_rows.total, (loaded_rows.end - loaded_rows.begin) + sink.entries);
+		lcf.partial.erase(fh);
+		lcf.loaded_frags.emplace(fh);
+		return;
+	}
+
+	const bool decoded = decode_fn(sink);
+	const bool complete =
+		decoded &&
+		(!sink.has_message_count || sink.entries == sink.message_count) &&
+		(!partial_rows.partial() || sink.entries == partial_rows.end - partial_rows.begin)
 	;
+	account(complete);
+	if (!complete) {
+		if (sink.entries == 0) {
+			// wrong data
+			fh.emplace_or_replace<ObjComp::Ephemeral::MessagesEmptyTag>();
+		} else {
+			decode_error();
+		}
+		return;
+	}
 
-	// TODO: move somewhere else?
-	auto& sjc = _os.registry().ctx().get<SerializerJsonCallbacks<Object>>();
+	if (sink.entries == 0) {
+		// empty array
+		fh.emplace_or_replace<ObjComp::Ephemeral::MessagesEmptyTag>();
+		return;
+	}
+
+	// whole fragment, all rows were read anyway
+	lcf.setUsage(fh, data_size, getTimeMS());
+
+	if (partial_rows.partial()) {
+		if (logs(LogLevel::debug)) {
+			std::cout << "MFS: partially loaded frag, rows " << partial_rows.begin << "-" << partial_rows.end << " of " << partial_rows.total << "\n";
+		}
+		lcf.loaded_frags.erase(fh);
+		lcf.partial.insert_or_assign(fh, partial_rows);
+		return;
+	}
+
+	// v1 does not tell, but it parsed completely
+	fh.emplace_or_replace<ObjComp::Ephemeral::MessagesDecodedCount>(sink.has_message_count ? sink.message_count : sink.entries, sink.entries);
+
+	if (sink.messages_new_or_updated == 0) {
+		// useless frag
+		// (no messages to unload, eviction only frees the accounting)
+		fh.emplace_or_replace<ObjComp::Ephemeral::MessagesEmptyTag>();
+	}
+}
+
+void MessageFragmentStore::commitLoadedMessage(Message3Registry& reg, ObjectHandle fh, Message3Handle new_real_msg, const Contact::Components::MessageDedupKey* dk, size_t& messages_new_or_updated) {
+	new_real_msg.emplace_or_replace<Message::Components::MFSObj>(fh);
+
+	// dup check (hacky, specific to protocols)
+	Message3 dup_msg {entt::null};
+	{
+		// get comparator from contact
+		if (reg.ctx().contains<Contact4>()) {
+			const auto c = reg.ctx().get<Contact4>();
+			if (_cs.registry().all_of<Contact::Components::MessageIsSame>(c)) {
+				auto& comp = _cs.registry().get<Contact::Components::MessageIsSame>(c).comp;
+				if (dk != nullptr) {
+					// only compare against messages with the same key
+					if (new_real_msg.all_of<Message::Components::Timestamp, Message::Components::ContactFrom, Message::Components::ContactTo>()) {
+						auto& di = dedupIndex(reg, *dk);
+						const auto bucket_it = di.msgs.find(dk->fn(new_real_msg));
+						if (bucket_it != di.msgs.cend()) {
+							for (const Message3 other_msg : bucket_it->second) {
+								if (other_msg == new_real_msg || !reg.valid(other_msg)) {
+									continue; // skip self and stale
+								}
+
+								if (comp({reg, other_msg}, new_real_msg)) {
+									// dup
+									dup_msg = other_msg;
+									break;
+								}
+							}
+						}
+					}
+				} else {
+					// walking EVERY existing message OOF
+					// contacts should provide a MessageDedupKey
+					for (const Message3 other_msg : reg.view<Message::Components::Timestamp, Message::Components::ContactFrom, Message::Components::ContactTo>()) {
+						if (other_msg == new_real_msg) {
+							continue; // skip self
+						}
+
+						if (comp({reg, other_msg}, new_real_msg)) {
+							// dup
+							dup_msg = other_msg;
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	if (reg.valid(dup_msg)) {
+		//  -> merge with preexisting (needs to be order independent)
+		//  -> throw update
+		reg.destroy(new_real_msg);
+		_metrics.dedup_hits++;
+		if (!reg.all_of<Message::Components::MFSObj>(dup_msg)) {
+			// not persisted anywhere else, this fragment owns it now
+			// (compaction only keeps owned messages)
+			reg.emplace<Message::Components::MFSObj>(dup_msg, fh);
+			addToFragmentMessages(reg, fh, dup_msg);
+		}
+		//messages_new_or_updated++; // TODO: how do i know on merging, if data was useful
+		//_rmm.throwEventUpdate(reg, new_real_msg);
+	} else {
+		if (!new_real_msg.all_of<Message::Components::Timestamp, Message::Components::ContactFrom, Message::Components::ContactTo>()) {
+			// does not have needed components to be stand alone
+			reg.destroy(new_real_msg);
+			if (logs(LogLevel::warning)) {
+				std::cerr << "MFS warning: message with missing basic compoments\n";
+			}
+			return;
+		}
+
+		messages_new_or_updated++;
+		addToFragmentMessages(reg, fh, new_real_msg);
+		if (dk != nullptr) {
+			dedupIndex(reg, *dk).add(dk->fn(new_real_msg), new_real_msg);
+		}
+		//  -> throw create
+		_rmm.throwEventConstruct(reg, new_real_msg);
+	}
+}
+
+// calls fn(type_id, name, value) for every component of m that has a serializer
+template<typename FN>
+static void serializeMessage(MessageSerializerNJ& scnj, Message3Registry& reg, const Message3 m, FN&& fn) {
+	nlohmann::json value;
+	for (const auto& [type_id, storage] : reg.storage()) {
+		if (!storage.contains(m)) {
+			continue;
+		}
+
+		//std::cout << "storage type: type_id:" << type_id << " name:" << storage.type().name() << "\n";
+
+		// use type_id to find serializer
+		auto s_cb_it = scnj._serl_json.find(type_id);
+		if (s_cb_it == scnj._serl_json.end()) {
+			// could not find serializer, not saving
+			//std::cout << "missing " << storage.type().name() << "(" << type_id << ")\n";
+			continue;
+		}
+
+		value = nullptr;
+		try {
+			s_cb_it->second(scnj, {reg, m}, value);
+		} catch (...) {
+			std::cerr << "MFS error: failed to serialize " << storage.type().name() << "(" << type_id << ")\n";
+		}
+		fn(type_id, storage.type().name(), value);
+	}
+}
+
+static bool savedToFragment(const Message3Registry& reg, const Message3 m) {
+	if (!reg.all_of<Message::Components::Timestamp, Message::Components::ContactFrom, Message::Components::ContactTo>(m)) {
+		return false;
+	}
+
+	// filter: require msg for now
+	// this will be removed in the future
+	return reg.any_of<Message::Components::MessageText>(m);
+	// fix message file objects first
+	//return reg.any_of<Message::Components::MessageText, Message::Components::MessageFileObject>(m);
+}
+
+bool MessageFragmentStore::syncFragToStorage(ObjectHandle fh, Message3Registry& reg, size_t& bytes, bool write_behind) {
+	const auto started = std::chrono::steady_clock::now();
+
+	if (fh.all_of<ObjComp::Ephemeral::MessagesDecodeErrorTag>()) {
+		// only a part is in memory, writing would drop the rest
+		std::cerr << "MFS error: refusing to write broken fragment " << bin2hex(fh.get<ObjComp::ID>().v) << "\n";
+		_metrics.fragments_save_failed++;
+		return false;
+	}
+
+	if (const auto* lcf = reg.ctx().find<Message::Contexts::LoadedContactFragments>(); lcf != nullptr && lcf->partial.contains(fh)) {
+		// saving now would drop the rows that are not loaded
+		loadFragment(reg, fh);
+		if (lcf->partial.contains(fh)) {
+			std::cerr << "MFS error: failed to load the rest of partial frag " << bin2hex(fh.get<ObjComp::ID>().v) << " before saving\n";
+			_metrics.fragments_save_failed++;
+			return false;
+		}
+	}
+
+	auto& ftsrange = fh.get_or_emplace<ObjComp::MessagesTSRange>(getTimeMS(), getTimeMS());
+
+	bool range_changed {false};
+
+	if (!reg.ctx().contains<Message::Contexts::FragmentMessages>()) {
+		reg.ctx().emplace<Message::Contexts::FragmentMessages>();
+	}
+	auto& frag_msgs = reg.ctx().get<Message::Contexts::FragmentMessages>().frag_msgs;
+
+	// only walk the messages associated with this fragment
+	std::vector<Message3> msgs;
+	if (auto fm_it = frag_msgs.find(fh); fm_it != frag_msgs.end()) {
+		msgs.reserve(fm_it->second.size());
+		for (const auto m : fm_it->second) {
+			// drop stale
+			if (!reg.valid(m) || !reg.all_of<Message::Components::MFSObj>(m) || reg.get<Message::Components::MFSObj>(m).o != fh) {
+				continue;
+			}
+			msgs.push_back(m);
+		}
+
+		if (msgs.size() != fm_it->second.size()) {
+			fm_it->second.clear();
+			for (const auto m : msgs) {
+				fm_it->second.emplace(m);
+			}
+		}
+	}
+
+	std::vector<Message3> save_msgs;
+	save_msgs.reserve(msgs.size());
+
+	// TODO: does every message have ts?
+	for (const Message3 m : msgs) {
+		if (!savedToFragment(reg, m)) {
+			continue;
+		}
+
+		{ // potentially adjust tsrange (some external processes can change timestamps)
+			const auto msg_ts = reg.get<Message::Components::Timestamp>(m).ts;
+			if (ftsrange.begin > msg_ts) {
+				ftsrange.begin = msg_ts;
+				range_changed = true;
+			} else if (ftsrange.end < msg_ts) {
+				ftsrange.end = msg_ts;
+				range_changed = true;
+			}
+		}
+
+		save_msgs.push_back(m);
+	}
+
+	if (range_changed && reg.ctx().contains<Message::Contexts::ContactFragments>()) {
+		// the index caches the range
+		auto& cf = reg.ctx().get<Message::Contexts::ContactFragments>();
+		if (cf.erase(fh)) {
+			cf.insert(fh);
+		}
+	}
+	if (range_changed && reg.ctx().contains<Message::Contexts::OpenFragments>()) {
+		auto& placeable = reg.ctx().get<Message::Contexts::OpenFragments>().placeable;
+		if (placeable.erase(fh)) {
+			placeable.insert(fh);
+		}
+	}
+
+	std::shared_ptr<const FragmentDictionary> dict;
+	if (!fragmentDictionary(fh, dict)) {
+		// would not be able to read it back either
+		return false;
+	}
+
+	// we cant skip if array is empty (in theory it will not be empty later on)
+
+	// reused, keeps its capacity
+	auto& data_to_save = _sync_buffer;
+	data_to_save.clear();
+
+	const auto obj_version = fh.get_or_emplace<ObjComp::MessagesVersion>().v;
+	if (obj_version == 1) {
+		auto j = nlohmann::json::array();
+		for (const Message3 m : save_msgs) {
+			auto& j_entry = j.emplace_back(nlohmann::json::object());
+			serializeMessage(_scnj, reg, m, [&j_entry](entt::id_type, std::string_view name, const nlohmann::json& value) {
+				j_entry[std::string{name}] = value;
+			});
+		}
+
+		auto j_dump = j.dump(2, ' ', true);
+		data_to_save.assign(j_dump.cbegin(), j_dump.cend());
+	} else if (obj_version == 2) {
+		// directly into msgpack, no intermediate json tree
+		_msgpack_writer.beginArray(data_to_save, save_msgs.size());
+		for (const Message3 m : save_msgs) {
+			_msgpack_writer.beginEntry();
+			serializeMessage(_scnj, reg, m, [this](entt::id_type type_id, std::string_view name, const nlohmann::json& value) {
+				_msgpack_writer.component(type_id, name, value);
+			});
+			_msgpack_writer.endEntry(data_to_save);
+		}
+	} else if (obj_version == 3) {
+		// sorted, so the timestamp deltas stay small
+		std::sort(save_msgs.begin(), save_msgs.end(), [&reg](const Message3 lhs, const Message3 rhs) {
+			return reg.get<Message::Components::Timestamp>(lhs).ts < reg.get<Message::Components::Timestamp>(rhs).ts;
+		});
+
+		_columnar_writer.begin(save_msgs.size());
+		for (const Message3 m : save_msgs) {
+			_columnar_writer.beginEntry();
+			serializeMessage(_scnj, reg, m, [this](entt::id_type type_id, std::string_view name, const nlohmann::json& value) {
+				_columnar_writer.component(type_id, name, value);
+			});
+			_columnar_writer.endEntry();
+		}
+		_columnar_writer.end(data_to_save);
+	} else {
+		std::cerr << "MFS error: unknown object version\n";
+		assert(false);
+	}
+	bytes = data_to_save.size();
+
+	if (bytes >= _seal_policy.max_bytes && reg.ctx().contains<Message::Contexts::OpenFragments>()) {
+		auto& open = reg.ctx().get<Message::Contexts::OpenFragments>();
+		if (open.placeable.contains(fh)) {
+			if (logs(LogLevel::debug)) {
+				std::cout << "MFS: sealed fragment, size\n";
+			}
+			open.seal(fh);
+		}
+	}
+
+	if (_catalog) {
+		// until the next checkpoint
+		_catalog->invalidateOnDisk();
+	}
+
+	if (_writer && write_behind) {
+		// compression and the write happen on the writer, update event once it is done
+		const Contact4 c = reg.ctx().contains<Contact4>() ? reg.ctx().get<Contact4>() : Contact4{entt::null};
+		_writer->submit(fh, c, std::move(data_to_save), std::move(dict));
+		data_to_save.clear(); // moved from
+		return true;
+	}
+
+	if (dict) {
+		if (!dict->compress(ByteSpan{data_to_save}, _dict_buffer)) {
+			_metrics.fragments_save_failed++;
+			return false;
+		}
+		data_to_save.swap(_dict_buffer);
+	}
+
+	assert(fh.all_of<ObjComp::Ephemeral::BackendAtomic>());
+	auto* backend = fh.get<ObjComp::Ephemeral::BackendAtomic>().ptr;
+	if (backend->write(fh, {reinterpret_cast<const uint8_t*>(data_to_save.data()), data_to_save.size()})) {
+		// TODO: make this better, should this be called on fail? should this be called before sync? (prob not)
+		_fs_ignore_event = true;
+		_os.throwEventUpdate(fh);
+		_fs_ignore_event = false;
+
+		_metrics.fragments_saved++;
+		_metrics.bytes_written += bytes;
+		_metrics.save_latency.record(std::chrono::steady_clock::now() - started);
+
+		//std::cout << "MFS: dumped " << j_dump << "\n";
+		// succ
+		return true;
+	}
+
+	// TODO: error
+	_metrics.fragments_save_failed++;
+	return false;
+}
+
+void MessageFragmentStore::registerSerializers(SerializerJsonCallbacks<Object>& sjc) {
 	sjc.registerSerializer<ObjComp::MessagesVersion>();
 	sjc.registerDeSerializer<ObjComp::MessagesVersion>();
 	sjc.registerSerializer<ObjComp::MessagesTSRange>();
 	sjc.registerDeSerializer<ObjComp::MessagesTSRange>();
 	sjc.registerSerializer<ObjComp::MessagesContact>();
 	sjc.registerDeSerializer<ObjComp::MessagesContact>();
+	sjc.registerSerializer<ObjComp::MessagesDictionary>();
+	sjc.registerDeSerializer<ObjComp::MessagesDictionary>();
+
+	// old frag names
+	sjc.registerSerializer<FragComp::MessagesTSRange>(sjc.component_get_json<ObjComp::MessagesTSRange>);
+	sjc.registerDeSerializer<FragComp::MessagesTSRange>(sjc.component_emplace_or_replace_json<ObjComp::MessagesTSRange>);
+	sjc.registerSerializer<FragComp::MessagesContact>(sjc.component_get_json<ObjComp::MessagesContact>);
+	sjc.registerDeSerializer<FragComp::MessagesContact>(sjc.component_emplace_or_replace_json<ObjComp::MessagesContact>);
+}
+
+void MessageFragmentStore::registerCopies(ComponentCopyCallbacks& ccc) {
+	ccc.registerCopy<ObjComp::DataEncryptionType>();
+	ccc.registerCopy<ObjComp::DataCompressionType>();
+
+	ccc.registerCopy<ObjComp::MessagesVersion>();
+	ccc.registerCopy<ObjComp::MessagesTSRange>();
+	ccc.registerCopy<ObjComp::MessagesContact>();
+	ccc.registerCopy<ObjComp::MessagesDictionary>();
+
+	// old frag names, (de)serialized from/into the new ones
+	ccc.registerCovered(entt::type_hash<FragComp::MessagesTSRange>::value());
+	ccc.registerCovered(entt::type_hash<FragComp::MessagesContact>::value());
+}
+
+MessageFragmentStore::MessageFragmentStore(
+	ContactStore4I& cs,
+	RegistryMessageModelI& rmm,
+	ObjectStore2& os,
+	StorageBackendIMeta& sbm,
+	StorageBackendIAtomic& sba,
+	MessageSerializerNJ& scnj
+) : _cs(cs), _cs_sr(_cs.newSubRef(this)), _rmm(rmm), _rmm_sr(_rmm.newSubRef(this)), _os(os), _os_sr(_os.newSubRef(this)), _sbm(sbm), _sba(sba), _scnj(scnj) {
+	// fill with preexisting contacts, events keep it up-to-date after
+	for (const auto& [c, id] : _cs.registry().view<Contact::Components::ID>().each()) {
+		_contact_id_lookup.emplace(id.data, c);
+	}
+
+	_cs_sr
+		.subscribe(ContactStore4_Event::contact_construct)
+		.subscribe(ContactStore4_Event::contact_update)
+		.subscribe(ContactStore4_Event::contact_destroy)
+	;
+
+	_rmm_sr
+		.subscribe(RegistryMessageModel_Event::message_construct)
+		.subscribe(RegistryMessageModel_Event::message_updated)
+		.subscribe(RegistryMessageModel_Event::message_destroy)
+	;
+
+	// so views only need to load the rows around them
+	_columnar_writer.setRowIndex(entt::type_hash<Message::Components::Timestamp>::value(), 64);
+
+	// TODO: move somewhere else?
+	registerSerializers(_os.registry().ctx().get<SerializerJsonCallbacks<Object>>());
+	// snapshots (for the writer) copy instead of serializing
+	registerCopies(_os.registry().ctx().emplace<ComponentCopyCallbacks>());
+
+	_os_sr
+		.subscribe(ObjectStore_Event::object_construct)
+		.subscribe(ObjectStore_Event::object_update)
+	;
+}
+
+MessageFragmentStore::~MessageFragmentStore(void) {
+	// results would be discarded anyway
+	_loader_pool.reset();
+
+	flush();
+	_writer.reset();
+
+	if (_catalog && _catalog->needsSave()) {
+		saveCatalog();
+	}
+
+	for (const auto c : _touched_contacts) {
+		auto* mr_ptr = static_cast<const RegistryMessageModelI&>(_rmm).get(c);
+		if (mr_ptr != nullptr) {
+			mr_ptr->ctx().erase<Message::Contexts::OpenFragments>();
+			mr_ptr->ctx().erase<Message::Contexts::ContactFragments>();
+			mr_ptr->ctx().erase<Message::Contexts::LoadedContactFragments>();
+			mr_ptr->ctx().erase<Message::Contexts::FragmentMessages>();
+			mr_ptr->ctx().erase<Message::Contexts::DedupIndex>();
+			mr_ptr->ctx().erase<Message::Contexts::ViewMotion>();
+		}
+	}
+}
+
+void MessageFragmentStore::enableWriteBehind(StorageBackendAtomicFactory backend_factory) {
+	if (_writer) {
+		flush();
+	}
+
+	_writer = std::make_unique<FragmentWriter>([backend_factory = std::move(backend_factory)](ObjectStore2& os) {
+		// the writer needs to be able to write our meta
+		registerSerializers(os.registry().ctx().get<SerializerJsonCallbacks<Object>>());
+		return backend_factory(os);
+	});
+}
+
+void MessageFragmentStore::flush(void) {
+	// everything, ignoring the save delay
+	// copied, a save can drop queued entries (eg. the rest of a partial fragment turns out broken)
+	std::vector<SaveQueueEntry> saves;
+	saves.reserve(_frag_save_queue.size());
+	for (const auto& [_, entry] : _frag_save_queue) {
+		saves.push_back(entry);
+	}
+
+	for (const auto& entry : saves) {
+		if (!_frag_save_queue.contains(entry.id)) {
+			continue;
+		}
+
+		assert(entry.reg != nullptr);
+		size_t bytes {0};
+		_fs_ignore_event = true;
+		syncFragToStorage(entry.id, *entry.reg, bytes);
+		_fs_ignore_event = false;
+		_save_failures.erase(entry.id);
+	}
+	_frag_save_queue.clear(); // unconditionally
+
+	if (_writer) {
+		_writer->flush();
+		collectWrites(false);
+	}
+}
+
+void MessageFragmentStore::collectWrites(bool requeue_failed) {
+	for (auto& res : _writer->collect()) {
+		// keep the largest buffer around
+		if (res.buffer.capacity() > _sync_buffer.capacity()) {
+			_sync_buffer = std::move(res.buffer);
+		}
+
+		auto fh = _os.objectHandle(res.frag);
+		if (!static_cast<bool>(fh)) {
+			continue;
+		}
+
+		if (res.ok) {
+			_metrics.fragments_saved++;
+			_metrics.bytes_written += res.bytes;
+			_metrics.save_latency.record(std::chrono::steady_clock::now() - res.submitted);
+			_save_failures.erase(fh);
+			_fs_ignore_event = true;
+			_os.throwEventUpdate(fh);
+			_fs_ignore_event = false;
+			continue;
+		}
+
+		_metrics.fragments_save_failed++;
+
+		if (!requeue_failed) {
+			continue;
+		}
+
+		auto* reg = _rmm.get(res.c);
+		if (reg == nullptr) {
+			continue;
+		}
+
+		// try again later, with backoff
+		recordSaveFailure(fh);
+		queueFragSave(fh, reg);
+	}
+}
+
+void MessageFragmentStore::collectLoadedFragments(void) {
+	// stop loading for contacts nobody looks at anymore
+	_loader_pool->cancelIf([this](Contact4 c) {
+		auto* msg_reg = _rmm.get(c);
+		return msg_reg == nullptr || msg_reg->view<Message::Components::ViewCurserBegin>().empty();
+	});
+
+	for (auto& res : _loader_pool->collect()) {
+		auto* msg_reg = _rmm.get(res.c);
+		if (msg_reg == nullptr) {
+			continue;
+		}
+
+		auto fh = _os.objectHandle(res.frag);
+		if (!static_cast<bool>(fh)) {
+			continue;
+		}
+
+		if (const auto* lcf = msg_reg->ctx().find<Message::Contexts::LoadedContactFragments>(); lcf != nullptr) {
+			if (lcf->loaded_frags.contains(res.frag)) {
+				// loaded in the meantime
+				continue;
+			}
+
+			const auto partial_it = lcf->partial.find(res.frag);
+			if (
+				res.slice.mode == FragmentSlice::Mode::rest ?
+				(partial_it == lcf->partial.cend() || !(partial_it->second == res.slice.loaded)) :
+				partial_it != lcf->partial.cend()
+			) {
+				// does not fit anymore
+				continue;
+			}
+		}
+
+		if (!res.read_ok) {
+			// wrong data
+			fh.emplace_or_replace<ObjComp::Ephemeral::MessagesEmptyTag>();
+			_metrics.fragments_load_failed++;
+			continue;
+		}
+
+		commitFragmentData(*msg_reg, fh, res.submitted, res.data_size, res.rows, [&res](MessagesDecodeSinkI& sink) {
+			res.msgs.replay(sink);
+			return res.decode_ok;
+		});
+
+		// there might be more to load
+		_potentially_dirty_contacts.emplace(res.c);
+	}
+}
+
+void MessageFragmentStore::recordSaveFailure(Object frag) {
+	auto& failure = _save_failures[frag];
+	failure.count++;
+	failure.ts_last = getTimeMS();
+}
+
+void MessageFragmentStore::queueFragSave(ObjectHandle fh, Message3Registry* reg) {
+	if (fh.all_of<ObjComp::Ephemeral::MessagesDecodeErrorTag>()) {
+		// would overwrite what we could not decode
+		return;
+	}
+
+	const auto ts_now = getTimeMS();
+	if (auto it = _frag_save_queue.find(fh); it != _frag_save_queue.end()) {
+		// already in queue, coalesce
+		it->second.ts_last_dirty = ts_now;
+		return;
+	}
+
+	_frag_save_queue.emplace(fh, SaveQueueEntry{ts_now, ts_now, fh, reg});
+}
+
+uint64_t MessageFragmentStore::saveDueTS(const SaveQueueEntry& entry) const {
+	// wait until 10sec without changes before saving,
+	// but dont hold back a constantly changing fragment for more than 60sec
+	const uint64_t ts_due = std::min(entry.ts_last_dirty + 10*1000, entry.ts_since_dirty + 60*1000);
+
+	const auto failure_it = _save_failures.find(entry.id);
+	if (failure_it == _save_failures.cend()) {
+		return ts_due;
+	}
+
+	// 1s, 2s, 4s ... 5min
+	const uint64_t backoff = std::min<uint64_t>(uint64_t(1000) << std::min<uint32_t>(failure_it->second.count-1, 16), 5*60*1000);
+	return std::max(ts_due, failure_it->second.ts_last + backoff);
+}
+
+void MessageFragmentStore::setSaveBudget(uint64_t time_ms, size_t bytes) {
+	_save_budget_ms = time_ms;
+	_save_budget_bytes = bytes;
+}
+
+void MessageFragmentStore::setMemoryBudget(size_t total_bytes, size_t contact_bytes) {
+	_budget_total_bytes = total_bytes;
+	_budget_contact_bytes = contact_bytes;
+}
+
+void MessageFragmentStore::unloadFragment(Message3Registry& reg, Object frag) {
+	std::vector<Message3> msgs;
+	if (reg.ctx().contains<Message::Contexts::FragmentMessages>()) {
+		auto& frag_msgs = reg.ctx().get<Message::Contexts::FragmentMessages>().frag_msgs;
+		if (auto it = frag_msgs.find(frag); it != frag_msgs.end()) {
+			// copy, destroy events modify the set
+			msgs.assign(it->second.cbegin(), it->second.cend());
+		}
+	}
+
+	for (const Message3 m : msgs) {
+		if (!reg.valid(m) || !reg.all_of<Message::Components::MFSObj>(m) || reg.get<Message::Components::MFSObj>(m).o != frag) {
+			continue; // stale
+		}
+
+		if (reg.any_of<Message::Components::ViewCurserBegin, Message::Components::ViewCurserEnd>(m)) {
+			continue; // never pull the rug
+		}
+
+		_rmm.throwEventDestroy(reg, m);
+		reg.destroy(m);
+		_metrics.messages_unloaded++;
+	}
+
+	if (reg.ctx().contains<Message::Contexts::FragmentMessages>()) {
+		reg.ctx().get<Message::Contexts::FragmentMessages>().frag_msgs.erase(frag);
+	}
+	reg.ctx().get<Message::Contexts::LoadedContactFragments>().erase(frag);
+
+	if (_prefetched.contains(frag)) {
+		// never became visible
+		_prefetched.erase(frag);
+		_prefetch_stats.wasted++;
+	}
+}
+
+// fragments overlapping a view, and the closest neighbours on both sides
+static void collectViewFragments(const Message3Registry& reg, const Message::Contexts::ContactFragments& cf, size_t adjacent, entt::dense_set<Object>& out) {
+	std::vector<Object> overlapping_frags;
+	auto c_b_view = reg.view<Message::Components::Timestamp, Message::Components::ViewCurserBegin>();
+	for (const auto& [m, ts_begin_comp, vcb] : c_b_view.each()) {
+		auto ts_begin = ts_begin_comp.ts;
+		auto ts_end = ts_begin_comp.ts;
+		if (reg.valid(vcb.curser_end) && reg.all_of<Message::Components::ViewCurserEnd, Message::Components::Timestamp>(vcb.curser_end)) {
+			ts_end = reg.get<Message::Components::Timestamp>(vcb.curser_end).ts;
+			if (ts_end > ts_begin) {
+				std::swap(ts_begin, ts_end);
+			}
+		}
+
+		overlapping_frags.clear();
+		cf.overlapping(ts_end, ts_begin, overlapping_frags);
+		for (const auto frag : overlapping_frags) {
+			out.emplace(frag);
+		}
+
+		// newer
+		Object next_frag = cf.firstEndAtOrAfter(ts_begin);
+		for (size_t i = 0; i < adjacent && next_frag != entt::null; i++, next_frag = cf.next(next_frag)) {
+			out.emplace(next_frag);
+		}
+
+		// older
+		Object prev_frag = cf.lastBeginBefore(ts_end);
+		for (size_t i = 0; i < adjacent && prev_frag != entt::null; i++, prev_frag = cf.prev(prev_frag)) {
+			out.emplace(prev_frag);
+		}
+	}
+}
+
+void MessageFragmentStore::evictFragments(void) {
+	const auto ts_now = getTimeMS();
+
+	struct ContactLoad {
+		Contact4 c {entt::null};
+		Message3Registry* reg {nullptr};
+	};
+	std::vector<ContactLoad> loaded_contacts;
+
+	size_t total_bytes {0};
+	size_t total_messages {0};
+	bool contact_over_budget {false};
+	for (const auto c : _touched_contacts) {
+		auto* reg = _rmm.get(c);
+		if (reg == nullptr || !reg->ctx().contains<Message::Contexts::LoadedContactFragments>()) {
+			continue;
+		}
+
+		if (const auto* fm = reg->ctx().find<Message::Contexts::FragmentMessages>(); fm != nullptr) {
+			for (const auto& [_, msgs] : fm->frag_msgs) {
+				total_messages += msgs.size();
+			}
+		}
+
+		const auto contact_bytes = reg->ctx().get<Message::Contexts::LoadedContactFragments>().bytes;
+		total_bytes += contact_bytes;
+		contact_over_budget = contact_over_budget || contact_bytes > _budget_contact_bytes;
+		loaded_contacts.push_back({c, reg});
+	}
+
+	_metrics.loaded_bytes = total_bytes;
+	_metrics.loaded_messages = total_messages;
+
+	if (total_bytes <= _budget_total_bytes && !contact_over_budget) {
+		return;
+	}
+
+	struct Candidate {
+		Message3Registry* reg {nullptr};
+		Object frag {entt::null};
+		size_t bytes {0};
+		uint64_t ts_last_used {0};
+	};
+	const auto lru_order = [](const Candidate& lhs, const Candidate& rhs) {
+		return lhs.ts_last_used < rhs.ts_last_used;
+	};
+
+	std::vector<Candidate> candidates;
+	entt::dense_set<Object> keep;
+	size_t evicted {0};
+	for (const auto& [c, reg] : loaded_contacts) {
+		auto& lcf = reg->ctx().get<Message::Contexts::LoadedContactFragments>();
+
+		keep.clear();
+		if (reg->ctx().contains<Message::Contexts::ContactFragments>()) {
+			collectViewFragments(*reg, reg->ctx().get<Message::Contexts::ContactFragments>(), _evict_keep_adjacent, keep);
+		}
+
+		const auto* open_frags = reg->ctx().contains<Message::Contexts::OpenFragments>() ? &reg->ctx().get<Message::Contexts::OpenFragments>().open_frags : nullptr;
+
+		const size_t contact_candidates_begin = candidates.size();
+		for (auto&& [frag, usage] : lcf.usage) {
+			if (keep.contains(frag)) {
+				usage.ts_last_used = ts_now;
+				continue;
+			}
+
+			if (
+				(open_frags != nullptr && open_frags->contains(frag)) ||
+				_frag_save_queue.contains(frag) || // dirty
+				(_writer && _writer->pending(frag)) // a failed write is requeued, and needs the messages
+			) {
+				continue;
+			}
+
+			candidates.push_back({reg, frag, usage.bytes, usage.ts_last_used});
+		}
+
+		if (lcf.bytes <= _budget_contact_bytes) {
+			continue;
+		}
+
+		// over contact budget, evict the lru ones of this contact first
+		std::sort(candidates.begin() + contact_candidates_begin, candidates.end(), lru_order);
+		auto it = candidates.begin() + contact_candidates_begin;
+		for (; it != candidates.end() && lcf.bytes > _budget_contact_bytes; it++) {
+			total_bytes -= it->bytes;
+			unloadFragment(*reg, it->frag);
+			evicted++;
+		}
+		candidates.erase(candidates.begin() + contact_candidates_begin, it);
+	}
+
+	if (total_bytes > _budget_total_bytes) {
+		std::sort(candidates.begin(), candidates.end(), lru_order);
+		for (auto it = candidates.begin(); it != candidates.end() && total_bytes > _budget_total_bytes; it++) {
+			total_bytes -= it->bytes;
+			unloadFragment(*it->reg, it->frag);
+			evicted++;
+		}
+	}
+
+	_metrics.fragments_evicted += evicted;
+	_metrics.loaded_bytes = total_bytes;
+
+	if (evicted > 0) {
+		if (logs(LogLevel::info)) {
+			std::cout << "MFS: evicted " << evicted << " fragments, " << total_bytes << " bytes loaded\n";
+		}
+	}
+}
+
+// messages that (still) belong to the fragment
+// returns false if any of them would not survive a rewrite
+static bool liveFragmentMessages(const Message3Registry& reg, Object frag, std::vector<Message3>& out) {
+	const auto* fm = reg.ctx().find<Message::Contexts::FragmentMessages>();
+	if (fm == nullptr) {
+		return true;
+	}
+
+	const auto it = fm->frag_msgs.find(frag);
+	if (it == fm->frag_msgs.cend()) {
+		return true;
+	}
+
+	bool all_saved {true};
+	for (const Message3 m : it->second) {
+		if (reg.valid(m) && reg.all_of<Message::Components::MFSObj>(m) && reg.get<Message::Components::MFSObj>(m).o == frag) {
+			out.push_back(m);
+			all_saved = all_saved && savedToFragment(reg, m);
+		}
+	}
+
+	return all_saved;
+}
+
+void MessageFragmentStore::setCompactionPolicy(const FragmentCompactionPolicy& policy) {
+	_compaction_policy = policy;
+}
+
+bool MessageFragmentStore::retireFragment(Message3Registry& reg, ObjectHandle fh) {
+	// there is no delete, so the object stays behind,
+	// but empty and without index entry (the converter drops those)
+	size_t bytes {0};
+	if (!syncFragToStorage(fh, reg, bytes, false)) {
+		std::cerr << "MFS error: failed to empty fragment, retrying later\n";
+		recordSaveFailure(fh);
+		queueFragSave(fh, &reg);
+		return false;
+	}
+
+	fh.emplace_or_replace<ObjComp::Ephemeral::MessagesEmptyTag>();
+	if (_catalog) {
+		// so it is skipped on the next start, instead of being loaded just to find it empty
+		_catalog->retire(fh.get<ObjComp::ID>().v);
+	}
+	if (auto* cf = reg.ctx().find<Message::Contexts::ContactFragments>(); cf != nullptr) {
+		cf->erase(fh);
+	}
+	if (auto* fm = reg.ctx().find<Message::Contexts::FragmentMessages>(); fm != nullptr) {
+		fm->frag_msgs.erase(fh);
+	}
+	reg.ctx().get<Message::Contexts::LoadedContactFragments>().erase(fh);
+	_prefetched.erase(fh);
+
+	if (logs(LogLevel::info)) {
+		std::cout << "MFS: retired fragment " << bin2hex(fh.get<ObjComp::ID>().v) << "\n";
+	}
+	return true;
+}
+
+bool MessageFragmentStore::mergeFragments(Message3Registry& reg, ObjectHandle dst, ObjectHandle src, const std::vector<Message3>& src_msgs) {
+	auto& fm = reg.ctx().get<Message::Contexts::FragmentMessages>();
+	for (const Message3 m : src_msgs) {
+		reg.get<Message::Components::MFSObj>(m).o = dst;
+		fm.add(dst, m);
+	}
+
+	{ // union of both ranges
+		auto& range = dst.get<ObjComp::MessagesTSRange>();
+		const auto& src_range = src.get<ObjComp::MessagesTSRange>();
+		range.begin = std::min(range.begin, src_range.begin);
+		range.end = std::max(range.end, src_range.end);
+
+		// the index caches the range
+		auto& cf = reg.ctx().get<Message::Contexts::ContactFragments>();
+		cf.erase(dst);
+		cf.insert(dst);
+	}
+
+	size_t bytes {0};
+	if (!syncFragToStorage(dst, reg, bytes, false)) {
+		// src still has the messages on disk, duplicates are dropped on load
+		std::cerr << "MFS error: failed to write merged fragment, retrying later\n";
+		recordSaveFailure(dst);
+		queueFragSave(dst, &reg);
+		_compaction_pinned.emplace(src);
+		return false;
+	}
+	reg.ctx().get<Message::Contexts::LoadedContactFragments>().setUsage(dst, bytes, getTimeMS());
+
+	if (logs(LogLevel::info)) {
+		std::cout << "MFS: merged " << src_msgs.size() << " messages of " << bin2hex(src.get<ObjComp::ID>().v) << " into " << bin2hex(dst.get<ObjComp::ID>().v) << "\n";
+	}
+
+	// the merge is the progress, a failed retire is retried by the save queue
+	retireFragment(reg, src);
+	return true;
+}
+
+bool MessageFragmentStore::splitFragment(Message3Registry& reg, ObjectHandle fh, const std::vector<Message3>& msgs) {
+	const size_t chunk_size = std::max<size_t>(_compaction_policy.target_messages, 1);
+	const auto ts_of = [&reg](Message3 m) {
+		return reg.get<Message::Components::Timestamp>(m).ts;
+	};
+
+	auto& fm = reg.ctx().get<Message::Contexts::FragmentMessages>();
+	auto& lcf = reg.ctx().get<Message::Contexts::LoadedContactFragments>();
+
+	// the first chunk stays, the rest moves into new fragments
+	bool all_written {true};
+	for (size_t i = chunk_size; i < msgs.size(); i += chunk_size) {
+		const size_t i_end = std::min(i + chunk_size, msgs.size());
+
+		auto new_fh = newFragment(reg, ts_of(msgs.at(i)), ts_of(msgs.at(i_end-1)));
+		if (!static_cast<bool>(new_fh)) {
+			all_written = false;
+			break;
+		}
+
+		for (size_t j = i; j < i_end; j++) {
+			reg.get<Message::Components::MFSObj>(msgs.at(j)).o = new_fh;
+			fm.add(new_fh, msgs.at(j));
+		}
+
+		size_t bytes {0};
+		if (syncFragToStorage(new_fh, reg, bytes, false)) {
+			lcf.setUsage(new_fh, bytes, getTimeMS());
+		} else {
+			all_written = false;
+			recordSaveFailure(new_fh);
+			queueFragSave(new_fh, &reg);
+		}
+	}
+
+	if (!all_written) {
+		// the original keeps everything on disk, duplicates are dropped on load
+		std::cerr << "MFS error: failed to write split fragment, keeping the original\n";
+		_compaction_pinned.emplace(fh);
+		return false;
+	}
+
+	{ // shrink to the first chunk
+		auto& range = fh.get<ObjComp::MessagesTSRange>();
+		range.begin = ts_of(msgs.front());
+		range.end = ts_of(msgs.at(std::min(chunk_size, msgs.size())-1));
+
+		auto& cf = reg.ctx().get<Message::Contexts::ContactFragments>();
+		cf.erase(fh);
+		cf.insert(fh);
+	}
+
+	size_t bytes {0};
+	if (!syncFragToStorage(fh, reg, bytes, false)) {
+		// still holds everything on disk, which is fine
+		recordSaveFailure(fh);
+		queueFragSave(fh, &reg);
+		return false;
+	}
+	lcf.setUsage(fh, bytes, getTimeMS());
+
+	if (logs(LogLevel::info)) {
+		std::cout << "MFS: split fragment " << bin2hex(fh.get<ObjComp::ID>().v) << " with " << msgs.size() << " messages\n";
+	}
+
+	return true;
+}
+
+bool MessageFragmentStore::compactContact(Message3Registry& reg) {
+	const auto* cf = reg.ctx().find<Message::Contexts::ContactFragments>();
+	const auto* lcf = reg.ctx().find<Message::Contexts::LoadedContactFragments>();
+	if (cf == nullptr || lcf == nullptr) {
+		return false;
+	}
+	const auto* open = reg.ctx().find<Message::Contexts::OpenFragments>();
+
+	// only loaded ones, so every message is in memory and has its final fragment
+	const auto compactable = [&](Object frag) {
+		if (frag == entt::null || !lcf->loaded_frags.contains(frag) || _compaction_pinned.contains(frag) || loadPending(frag)) {
+			return false;
+		}
+
+		if (open != nullptr && open->open_frags.contains(frag)) {
+			return false; // still written to
+		}
+
+		const auto fh = _os.objectHandle(frag);
+		if (!static_cast<bool>(fh) || !fh.all_of<ObjComp::ID, ObjComp::MessagesTSRange, ObjComp::MessagesContact, ObjComp::Ephemeral::BackendAtomic>()) {
+			return false;
+		}
+
+		// a rewrite holds only what we decoded, anything missing would be lost
+		if (fh.all_of<ObjComp::Ephemeral::MessagesDecodeErrorTag>()) {
+			return false;
+		}
+		if (const auto* count = fh.try_get<ObjComp::Ephemeral::MessagesDecodedCount>(); count != nullptr && count->decoded != count->stored) {
+			return false;
+		}
+
+		return true;
+	};
+
+	std::vector<Message3> frag_msgs;
+	std::vector<Message3> prev_msgs;
+
+	// newest to oldest, by range begin
+	Object frag = cf->lastBeginBefore(std::numeric_limits<uint64_t>::max());
+	bool frag_compactable = compactable(frag) && liveFragmentMessages(reg, frag, frag_msgs);
+
+	while (frag != entt::null) {
+		const Object prev = cf->prev(frag);
+		prev_msgs.clear();
+		const bool prev_compactable = compactable(prev) && liveFragmentMessages(reg, prev, prev_msgs);
+
+		if (frag_compactable) {
+			auto fh = _os.objectHandle(frag);
+
+			if (frag_msgs.empty()) {
+				// everything in there was a duplicate (or moved)
+				// only housekeeping, the files stay, so it does not count as progress
+				retireFragment(reg, fh);
+			} else if (frag_msgs.size() > _compaction_policy.split_messages) {
+				std::sort(frag_msgs.begin(), frag_msgs.end(), [&reg](Message3 lhs, Message3 rhs) {
+					return reg.get<Message::Components::Timestamp>(lhs).ts < reg.get<Message::Components::Timestamp>(rhs).ts;
+				});
+				return splitFragment(reg, fh, frag_msgs);
+			} else if (
+				prev_compactable && !prev_msgs.empty() &&
+				(frag_msgs.size() < _compaction_policy.small_messages || prev_msgs.size() < _compaction_policy.small_messages) &&
+				frag_msgs.size() + prev_msgs.size() <= _compaction_policy.target_messages
+			) {
+				auto prev_fh = _os.objectHandle(prev);
+				const auto& range = fh.get<ObjComp::MessagesTSRange>();
+				const auto& prev_range = prev_fh.get<ObjComp::MessagesTSRange>();
+				const uint64_t extent = std::max(range.end, prev_range.end) - std::min(range.begin, prev_range.begin);
+				if (extent <= _compaction_policy.max_ts_extent) {
+					// into the older one
+					return mergeFragments(reg, prev_fh, fh, frag_msgs);
+				}
+			}
+		}
+
+		frag = prev;
+		frag_compactable = prev_compactable;
+		frag_msgs.swap(prev_msgs);
+	}
+
+	return false;
+}
+
+bool MessageFragmentStore::compactFragments(void) {
+	for (const auto c : _touched_contacts) {
+		auto* msg_reg = _rmm.get(c);
+		if (msg_reg == nullptr) {
+			continue;
+		}
 
-	// old frag names
-	sjc.registerSerializer<FragComp::MessagesTSRange>(sjc.component_get_json<ObjComp::MessagesTSRange>);
-	sjc.registerDeSerializer<FragComp::MessagesTSRange>(sjc.component_emplace_or_replace_json<ObjComp::MessagesTSRange>);
-	sjc.registerSerializer<FragComp::MessagesContact>(sjc.component_get_json<ObjComp::MessagesContact>);
-	sjc.registerDeSerializer<FragComp::MessagesContact>(sjc.component_emplace_or_replace_json<ObjComp::MessagesContact>);
+		if (compactContact(*msg_reg)) {
+			return true;
+		}
+	}
 
-	_os_sr
-		.subscribe(ObjectStore_Event::object_construct)
-		.subscribe(ObjectStore_Event::object_update)
-	;
+	return false;
 }
 
-MessageFragmentStore::~MessageFragmentStore(void) {
-	while (!_frag_save_queue.empty()) {
-		auto fh = _frag_save_queue.front().id;
-		auto* reg = _frag_save_queue.front().reg;
-		assert(reg != nullptr);
-		_fs_ignore_event = true;
-		syncFragToStorage(fh, *reg);
-		_fs_ignore_event = false;
-		_frag_save_queue.pop_front(); // pop unconditionally
+// checks if any view of the contact needs fragment loading
+// returns true if the contact needs to be checked again
+bool MessageFragmentStore::serviceDirtyContact(Contact4 c) {
+	auto* msg_reg = _rmm.get(c);
+	if (msg_reg == nullptr) {
+		return false;
 	}
 
-	for (const auto c : _touched_contacts) {
-		auto* mr_ptr = static_cast<const RegistryMessageModelI&>(_rmm).get(c);
-		if (mr_ptr != nullptr) {
-			mr_ptr->ctx().erase<Message::Contexts::OpenFragments>();
-			mr_ptr->ctx().erase<Message::Contexts::ContactFragments>();
-			mr_ptr->ctx().erase<Message::Contexts::LoadedContactFragments>();
+	// with the loader pool we keep requesting, until it is saturated
+	const auto load_more = [this]() {
+		return _loader_pool && !_loader_pool->full();
+	};
+
+	// first do collision check agains every contact associated fragment
+	// that is not already loaded !!
+	if (msg_reg->ctx().contains<Message::Contexts::ContactFragments>()) {
+		auto& cf = msg_reg->ctx().get<Message::Contexts::ContactFragments>();
+		if (!cf.empty()) {
+			if (!msg_reg->ctx().contains<Message::Contexts::LoadedContactFragments>()) {
+				msg_reg->ctx().emplace<Message::Contexts::LoadedContactFragments>();
+			}
+			const auto& lcf = msg_reg->ctx().get<Message::Contexts::LoadedContactFragments>();
+
+			// only query fragments overlapping a view, instead of checking every fragment
+			std::vector<Object> overlapping_frags;
+			auto c_b_view = msg_reg->view<Message::Components::Timestamp, Message::Components::ViewCurserBegin>();
+			c_b_view.use<Message::Components::ViewCurserBegin>();
+			for (const auto& [m, ts_begin_comp, vcb] : c_b_view.each()) {
+				auto ts_begin = ts_begin_comp.ts;
+				auto ts_end = ts_begin_comp.ts;
+				if (msg_reg->valid(vcb.curser_end) && msg_reg->all_of<Message::Components::ViewCurserEnd, Message::Components::Timestamp>(vcb.curser_end)) {
+					ts_end = msg_reg->get<Message::Components::Timestamp>(vcb.curser_end).ts;
+					if (ts_end > ts_begin) {
+						std::swap(ts_begin, ts_end);
+					}
+				}
+
+				overlapping_frags.clear();
+				cf.overlapping(ts_end, ts_begin, overlapping_frags);
+
+				for (const auto fid : overlapping_frags) {
+					const auto partial_it = lcf.partial.find(fid);
+					if (
+						lcf.loaded_frags.contains(fid) || loadPending(fid) ||
+						// the loaded rows still cover the view
+						(partial_it != lcf.partial.cend() && partial_it->second.covers(ts_end, ts_begin))
+					) {
+						if (_prefetched.contains(fid)) {
+							// became visible after we speculatively loaded it
+							_prefetched.erase(fid);
+							_prefetch_stats.hits++;
+						}
+						continue;
+					}
+
+					auto fh = _os.objectHandle(fid);
+
+					if (!static_cast<bool>(fh)) {
+						std::cerr << "MFS error: frag is invalid\n";
+						// WHAT
+						cf.erase(fid);
+						return true;
+					}
+
+					if (!fh.all_of<ObjComp::MessagesTSRange>()) {
+						std::cerr << "MFS error: frag has no range\n";
+						// ????
+						cf.erase(fid);
+						return true;
+					}
+
+					if (fh.all_of<ObjComp::Ephemeral::MessagesEmptyTag>()) {
+						continue; // skip known empty
+					}
+
+					// the index only gives us candidates, the actual hit check is the same as for events
+					const auto& [range_begin, range_end] = fh.get<ObjComp::MessagesTSRange>();
+
+					if (Message::Contexts::rangeVisible(range_begin, range_end, *msg_reg)) {
+						if (logs(LogLevel::debug)) {
+							std::cout << "MFS: frag hit by vis range\n";
+						}
+						_prefetch_stats.misses++; // had to load on demand
+						requestLoadFragment(*msg_reg, fh, ts_end, ts_begin);
+						if (!load_more()) {
+							return true;
+						}
+					}
+				}
+			}
+			// no new visible fragment
+			//std::cout << "MFS: no new frag directly visible\n";
+
+			// now, finally, check for adjecent fragments that need to be loaded
+			// we do this by finding the outermost fragment in a rage, and extend it by one
+
+			// for each view
+			for (const auto& [_, ts_begin_comp, vcb] : c_b_view.each()) {
+				// aka "scroll down"
+				{ // find newest(-ish) frag in range
+					// first frag with end >= range begin
+					Object next_frag = cf.firstEndAtOrAfter(ts_begin_comp.ts);
+					// we checked earlier that cf is not empty
+					if (!_os.registry().valid(next_frag)) {
+						// fall back to closest, cf is not empty
+						next_frag = cf.back();
+					}
+
+					// a single adjacent frag is often not enough
+					// only ok bc next is cheap
+					for (size_t i = 0; i < 5 && _os.registry().valid(next_frag); next_frag = cf.next(next_frag)) {
+						auto fh = _os.objectHandle(next_frag);
+						if (fh.any_of<ObjComp::Ephemeral::MessagesEmptyTag>()) {
+							continue; // skip known empty
+						}
+
+						// pending and partial count as loaded
+						if (!lcf.loaded(next_frag) && !loadPending(next_frag)) {
+							if (logs(LogLevel::debug)) {
+								std::cout << "MFS: next frag of range\n";
+							}
+							requestLoadFragment(*msg_reg, fh);
+							if (!load_more()) {
+								return true;
+							}
+						}
+
+						i++;
+					}
+				}
+
+				// curser end
+				if (!msg_reg->valid(vcb.curser_end) || !msg_reg->all_of<Message::Components::Timestamp>(vcb.curser_end)) {
+					continue;
+				}
+				const auto ts_end = msg_reg->get<Message::Components::Timestamp>(vcb.curser_end).ts;
+
+				// aka "scroll up"
+				{ // find oldest(-ish) frag in range
+					// last frag with begin < range end
+					Object prev_frag = cf.lastBeginBefore(ts_end);
+					// we checked earlier that cf is not empty
+					if (!_os.registry().valid(prev_frag)) {
+						// fall back to closest, cf is not empty
+						prev_frag = cf.front();
+					}
+
+					// a single adjacent frag is often not enough
+					// only ok bc next is cheap
+					for (size_t i = 0; i < 5 && _os.registry().valid(prev_frag); prev_frag = cf.prev(prev_frag)) {
+						auto fh = _os.objectHandle(prev_frag);
+						if (fh.any_of<ObjComp::Ephemeral::MessagesEmptyTag>()) {
+							continue; // skip known empty
+						}
+
+						// pending and partial count as loaded
+						if (!lcf.loaded(prev_frag) && !loadPending(prev_frag)) {
+							if (logs(LogLevel::debug)) {
+								std::cout << "MFS: prev frag of range\n";
+							}
+							requestLoadFragment(*msg_reg, fh);
+							if (!load_more()) {
+								return true;
+							}
+						}
+
+						i++;
+					}
+				}
+			}
+		}
+	} else {
+		// contact has no fragments, skip
+	}
+
+	// finally, speculate in scroll direction
+	if (msg_reg->ctx().contains<Message::Contexts::ContactFragments>()) {
+		if (prefetchViews(*msg_reg, msg_reg->ctx().get<Message::Contexts::ContactFragments>())) {
+			return true;
 		}
 	}
+
+	return false;
 }
 
-// checks range against all cursers in msgreg
-static bool rangeVisible(uint64_t range_begin, uint64_t range_end, const Message3Registry& msg_reg) {
-	// 1D collision checks:
-	//  - for range vs range:
-	//    r1 rhs >= r0 lhs AND r1 lhs <= r0 rhs
-	//  - for range vs point:
-	//    p >= r0 lhs AND p <= r0 rhs
-	// NOTE: directions for us are reversed (begin has larger values as end)
+uint64_t MessageFragmentStore::unloadedFragmentDistance(Message3Registry& reg) const {
+	constexpr uint64_t no_distance {std::numeric_limits<uint64_t>::max()};
 
-	auto c_b_view = msg_reg.view<Message::Components::Timestamp, Message::Components::ViewCurserBegin>();
-	c_b_view.use<Message::Components::ViewCurserBegin>();
-	for (const auto& [m, ts_begin_comp, vcb] : c_b_view.each()) {
-		// p and r1 rhs can be seen as the same
-		// but first we need to know if a curser begin is a point or a range
+	if (!reg.ctx().contains<Message::Contexts::ContactFragments>()) {
+		return no_distance;
+	}
+	const auto& cf = reg.ctx().get<Message::Contexts::ContactFragments>();
+	const auto* lcf = reg.ctx().find<Message::Contexts::LoadedContactFragments>();
 
-		// TODO: margin?
-		auto ts_begin = ts_begin_comp.ts;
-		auto ts_end = ts_begin_comp.ts; // simplyfy code by making a single begin curser act as an infinitly small range
-		if (msg_reg.valid(vcb.curser_end) && msg_reg.all_of<Message::Components::ViewCurserEnd>(vcb.curser_end)) {
-			// TODO: respect curser end's begin?
-			// TODO: remember which ends we checked and check remaining
-			ts_end = msg_reg.get<Message::Components::Timestamp>(vcb.curser_end).ts;
+	const auto needs_load = [this, lcf](Object frag) {
+		if ((lcf != nullptr && lcf->loaded(frag)) || loadPending(frag)) {
+			return false;
+		}
+		const auto fh = _os.objectHandle(frag);
+		return static_cast<bool>(fh) && fh.all_of<ObjComp::MessagesTSRange>() && !fh.all_of<ObjComp::Ephemeral::MessagesEmptyTag>();
+	};
 
-			// sanity check curser order
+	uint64_t distance {no_distance};
+	std::vector<Object> overlapping_frags;
+	for (const auto& [m, ts_begin_comp, vcb] : reg.view<Message::Components::Timestamp, Message::Components::ViewCurserBegin>().each()) {
+		auto ts_begin = ts_begin_comp.ts;
+		auto ts_end = ts_begin_comp.ts;
+		if (reg.valid(vcb.curser_end) && reg.all_of<Message::Components::ViewCurserEnd, Message::Components::Timestamp>(vcb.curser_end)) {
+			ts_end = reg.get<Message::Components::Timestamp>(vcb.curser_end).ts;
 			if (ts_end > ts_begin) {
-				std::cerr << "MFS warning: begin curser and end curser of view swapped!!\n";
 				std::swap(ts_begin, ts_end);
 			}
 		}
 
-		// perform both checks here
-		if (ts_begin < range_end || ts_end > range_begin) {
-			continue;
+		overlapping_frags.clear();
+		cf.overlapping(ts_end, ts_begin, overlapping_frags);
+		for (const auto frag : overlapping_frags) {
+			if (needs_load(frag)) {
+				return 0;
+			}
 		}
 
-		// range hits a view
-		return true;
+		// same reach as the adjacency loading
+		Object next_frag = cf.firstEndAtOrAfter(ts_begin);
+		for (size_t i = 0; i < 5 && next_frag != entt::null; i++, next_frag = cf.next(next_frag)) {
+			if (needs_load(next_frag)) {
+				const auto frag_begin = _os.registry().get<ObjComp::MessagesTSRange>(next_frag).begin;
+				distance = std::min<uint64_t>(distance, frag_begin > ts_begin ? frag_begin - ts_begin : 0);
+				break;
+			}
+		}
+
+		Object prev_frag = cf.lastBeginBefore(ts_end);
+		for (size_t i = 0; i < 5 && prev_frag != entt::null; i++, prev_frag = cf.prev(prev_frag)) {
+			if (needs_load(prev_frag)) {
+				const auto frag_end = _os.registry().get<ObjComp::MessagesTSRange>(prev_frag).end;
+				distance = std::min<uint64_t>(distance, ts_end > frag_end ? ts_end - frag_end : 0);
+				break;
+			}
+		}
 	}
 
-	return false;
+	return distance;
+}
+
+std::vector<Contact4> MessageFragmentStore::dirtyContactsByPriority(void) {
+	struct Prio {
+		Contact4 c {entt::null};
+		bool has_view {false};
+		uint8_t distance_class {0};
+		uint64_t last_serviced {0};
+	};
+
+	std::vector<Prio> prios;
+	prios.reserve(_potentially_dirty_contacts.size());
+	for (const auto c : _potentially_dirty_contacts) {
+		Prio prio;
+		prio.c = c;
+		if (const auto it = _contact_last_serviced.find(c); it != _contact_last_serviced.cend()) {
+			prio.last_serviced = it->second;
+		}
+
+		auto* reg = _rmm.get(c);
+		prio.has_view = reg != nullptr && !reg->view<Message::Components::ViewCurserBegin>().empty();
+		if (prio.has_view) {
+			// coarse, so contacts in the same class take turns
+			// 0 is visible, then doubling seconds
+			const auto distance = unloadedFragmentDistance(*reg);
+			if (distance == std::numeric_limits<uint64_t>::max()) {
+				prio.distance_class = 0xff;
+			} else if (distance > 0) {
+				uint64_t distance_s = distance / 1000;
+				prio.distance_class = 1;
+				while (distance_s > 0) {
+					distance_s >>= 1;
+					prio.distance_class++;
+				}
+			}
+		}
+
+		prios.push_back(prio);
+	}
+
+	std::sort(prios.begin(), prios.end(), [](const Prio& lhs, const Prio& rhs) {
+		if (lhs.has_view != rhs.has_view) {
+			return lhs.has_view;
+		}
+		if (lhs.distance_class != rhs.distance_class) {
+			return lhs.distance_class < rhs.distance_class;
+		}
+		// round robin, least recently serviced first
+		return lhs.last_serviced < rhs.last_serviced;
+	});
+
+	std::vector<Contact4> order;
+	order.reserve(prios.size());
+	for (const auto& prio : prios) {
+		order.push_back(prio.c);
+	}
+	return order;
+}
+
+void MessageFragmentStore::setTickBudget(float seconds) {
+	_tick_budget = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(seconds));
+}
+
+void MessageFragmentStore::updateMetricGauges(uint64_t ts_now) {
+	_metrics.save_queue_depth = _frag_save_queue.size();
+	_metrics.save_queue_oldest_ms = 0;
+	for (const auto& [_, entry] : _frag_save_queue) {
+		_metrics.save_queue_oldest_ms = std::max(_metrics.save_queue_oldest_ms, ts_now - std::min(ts_now, entry.ts_since_dirty));
+	}
+	_metrics.save_failures_pending = _save_failures.size();
+	_metrics.event_check_queue_depth = _event_check_queue.size();
+	_metrics.dirty_contacts = _potentially_dirty_contacts.size();
+}
+
+void MessageFragmentStore::setLogLevel(LogLevel level) {
+	_log_level = level;
 }
 
 float MessageFragmentStore::tick(float) {
 	const auto ts_now = getTimeMS();
+
+	// every phase works until it is done or the budget is spent
+	const auto tick_start = std::chrono::steady_clock::now();
+	const auto deadline = tick_start + _tick_budget;
+	const auto budget_left = [&deadline]() {
+		return std::chrono::steady_clock::now() < deadline;
+	};
+
 	// sync dirty fragments here
-	if (!_frag_save_queue.empty()) {
-		// wait 10sec before saving
-		if (_frag_save_queue.front().ts_since_dirty + 10*1000 <= ts_now) {
-			auto fh = _frag_save_queue.front().id;
-			auto* reg = _frag_save_queue.front().reg;
-			assert(reg != nullptr);
-			if (syncFragToStorage(fh, *reg)) {
-				_frag_save_queue.pop_front();
-			}
+	// every due one, until we run out of budget
+	// (we always save at least one)
+	std::vector<SaveQueueEntry> due_saves;
+	for (const auto& [_, entry] : _frag_save_queue) {
+		if (saveDueTS(entry) <= ts_now) {
+			due_saves.push_back(entry);
+		}
+	}
+	// oldest first
+	std::sort(due_saves.begin(), due_saves.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.ts_since_dirty < rhs.ts_since_dirty;
+	});
+
+	size_t bytes_saved {0};
+	bool saves_left {false};
+	for (const auto& entry : due_saves) {
+		if (bytes_saved >= _save_budget_bytes || getTimeMS() - ts_now >= _save_budget_ms || !budget_left()) {
+			saves_left = true;
+			break;
+		}
+
+		assert(entry.reg != nullptr);
+
+		size_t bytes {0};
+		if (syncFragToStorage(entry.id, *entry.reg, bytes)) {
+			_metrics.save_age.record(std::chrono::milliseconds(getTimeMS() - entry.ts_since_dirty));
+			_save_failures.erase(entry.id);
+			_frag_save_queue.erase(entry.id);
+		} else if (_frag_save_queue.contains(entry.id)) {
+			// does not block the others
+			std::cerr << "MFS error: failed to save fragment, retrying later\n";
+			recordSaveFailure(entry.id);
 		}
+		bytes_saved += bytes;
+	}
+
+	if (_writer) {
+		collectWrites(true);
+	}
+
+	if (_loader_pool) {
+		collectLoadedFragments();
+	}
+
+	if (_ts_last_eviction_check + 1000 <= ts_now) {
+		_ts_last_eviction_check = ts_now;
+		evictFragments();
 	}
 
 	// load needed fragments here
 
-	// last check event frags
+	// first check event frags
 	// only checks if it collides with ranges, not adjacent
-	// bc ~range~ msgreg will be marked dirty and checked next tick
-	const bool had_events = !_event_check_queue.empty();
-	for (size_t i = 0; i < 50 && !_event_check_queue.empty(); i++) {
+	// bc ~range~ msgreg will be marked dirty and checked below
+	while (!_event_check_queue.empty() && budget_left()) {
 		//std::cout << "MFS: event check\n";
 		auto fh = _event_check_queue.front().fid;
 		auto c = _event_check_queue.front().c;
 		_event_check_queue.pop_front();
 
 		if (!static_cast<bool>(fh)) {
-			return 0.05f;
+			continue;
 		}
 
 		if (!fh.all_of<ObjComp::MessagesTSRange>()) {
-			return 0.05f;
+			continue;
 		}
 
 		if (!fh.all_of<ObjComp::MessagesVersion>()) {
@@ -644,9 +2336,9 @@ float MessageFragmentStore::tick(float) {
 		}
 		const auto object_version = fh.get<ObjComp::MessagesVersion>().v;
 		// TODO: move this early version check somewhere else
-		if (object_version != 1 && object_version != 2) {
+		if (object_version < 1 || object_version > 3) {
 			std::cerr << "MFS: object with version mismatch\n";
-			return 0.05f;
+			continue;
 		}
 
 		// get ts range of frag and collide with all curser(s/ranges)
@@ -654,191 +2346,91 @@ float MessageFragmentStore::tick(float) {
 
 		auto* msg_reg = _rmm.get(c);
 		if (msg_reg == nullptr) {
-			return 0.05f;
+			continue;
 		}
 
-		if (rangeVisible(frag_range.begin, frag_range.end, !msg_reg)) {
-			loadFragment(*msg_reg, fh);
+		if (Message::Contexts::rangeVisible(frag_range.begin, frag_range.end, *msg_reg)) {
+			requestLoadFragment(*msg_reg, fh);
 			_potentially_dirty_contacts.emplace(c);
-			return 0.05f; // only one but soon again
 		}
 	}
-	if (had_events) {
-		//std::cout << "MFS: event check none\n";
-		return 0.05f; // only check events, even if non where hit
-	}
 
-	if (!_potentially_dirty_contacts.empty()) {
+	// then check if any view of the dirty contacts needs more fragments
+	const auto loads_blocked = [this]() {
+		// wait for results
+		return _loader_pool && _loader_pool->full();
+	};
+	if (!_potentially_dirty_contacts.empty() && budget_left() && !loads_blocked()) {
 		//std::cout << "MFS: pdc\n";
-		// here we check if any view of said contact needs frag loading
-		// only once per tick tho
-
-		// TODO: this makes order depend on internal order and is not fair
-		auto it = _potentially_dirty_contacts.cbegin();
-
-		auto* msg_reg = _rmm.get(*it);
-
-		// first do collision check agains every contact associated fragment
-		// that is not already loaded !!
-		if (msg_reg->ctx().contains<Message::Contexts::ContactFragments>()) {
-			const auto& cf = msg_reg->ctx().get<Message::Contexts::ContactFragments>();
-			if (!cf.sorted_frags.empty()) {
-				if (!msg_reg->ctx().contains<Message::Contexts::LoadedContactFragments>()) {
-					msg_reg->ctx().emplace<Message::Contexts::LoadedContactFragments>();
-				}
-				const auto& loaded_frags = msg_reg->ctx().get<Message::Contexts::LoadedContactFragments>().loaded_frags;
-
-				for (const auto& [fid, si] : msg_reg->ctx().get<Message::Contexts::ContactFragments>().sorted_frags) {
-					if (loaded_frags.contains(fid)) {
-						continue;
-					}
-
-					auto fh = _os.objectHandle(fid);
-
-					if (!static_cast<bool>(fh)) {
-						std::cerr << "MFS error: frag is invalid\n";
-						// WHAT
-						msg_reg->ctx().get<Message::Contexts::ContactFragments>().erase(fid);
-						return 0.05f;
-					}
-
-					if (!fh.all_of<ObjComp::MessagesTSRange>()) {
-						std::cerr << "MFS error: frag has no range\n";
-						// ????
-						msg_reg->ctx().get<Message::Contexts::ContactFragments>().erase(fid);
-						return 0.05f;
-					}
-
-					if (fh.all_of<ObjComp::Ephemeral::MessagesEmptyTag>()) {
-						continue; // skip known empty
-					}
-
-					// get ts range of frag and collide with all curser(s/ranges)
-					const auto& [range_begin, range_end] = fh.get<ObjComp::MessagesTSRange>();
-
-					if (rangeVisible(range_begin, range_end, *msg_reg)) {
-						std::cout << "MFS: frag hit by vis range\n";
-						loadFragment(*msg_reg, fh);
-						return 0.05f;
-					}
+		auto order = dirtyContactsByPriority();
+
+		// one service per contact and round, most important first
+		// so every visible contact makes progress
+		while (!order.empty() && budget_left() && !loads_blocked()) {
+			for (auto it = order.begin(); it != order.end() && budget_left() && !loads_blocked();) {
+				const auto c = *it;
+				_contact_last_serviced[c] = ++_service_seq;
+				if (!serviceDirtyContact(c)) {
+					_potentially_dirty_contacts.erase(c);
+					it = order.erase(it);
+				} else {
+					it++;
 				}
-				// no new visible fragment
-				//std::cout << "MFS: no new frag directly visible\n";
-
-				// now, finally, check for adjecent fragments that need to be loaded
-				// we do this by finding the outermost fragment in a rage, and extend it by one
-
-				// TODO: rewrite using some bounding range tree to perform collision checks !!!
-				// (this is now performing better, but still)
-
-
-				// for each view
-				auto c_b_view = msg_reg->view<Message::Components::Timestamp, Message::Components::ViewCurserBegin>();
-				c_b_view.use<Message::Components::ViewCurserBegin>();
-				for (const auto& [_, ts_begin_comp, vcb] : c_b_view.each()) {
-					// aka "scroll down"
-					{ // find newest(-ish) frag in range
-						// or in reverse frag end <= range begin
-
-
-						// lower bound of frag end and range begin
-						const auto right = std::lower_bound(
-							cf.sorted_end.crbegin(),
-							cf.sorted_end.crend(),
-							ts_begin_comp.ts,
-							[&](const Object element, const auto& value) -> bool {
-								return _os.registry().get<ObjComp::MessagesTSRange>(element).end >= value;
-							}
-						);
-
-						Object next_frag{entt::null};
-						if (right != cf.sorted_end.crend()) {
-							next_frag = cf.next(*right);
-						}
-						// we checked earlier that cf is not empty
-						if (!_os.registry().valid(next_frag)) {
-							// fall back to closest, cf is not empty
-							next_frag = cf.sorted_end.front();
-						}
-
-						// a single adjacent frag is often not enough
-						// only ok bc next is cheap
-						for (size_t i = 0; i < 5 && _os.registry().valid(next_frag); next_frag = cf.next(next_frag)) {
-							auto fh = _os.objectHandle(next_frag);
-							if (fh.any_of<ObjComp::Ephemeral::MessagesEmptyTag>()) {
-								continue; // skip known empty
-							}
+			}
+		}
+	}
 
-							if (!loaded_frags.contains(next_frag)) {
-								std::cout << "MFS: next frag of range\n";
-								loadFragment(*msg_reg, fh);
-								return 0.05f;
-							}
+	// idle time maintenance, only with everything saved
+	// (compaction relies on every loaded message being on disk)
+	const bool idle =
+		!saves_left && _frag_save_queue.empty() &&
+		_event_check_queue.empty() && _potentially_dirty_contacts.empty() &&
+		(!_loader_pool || _loader_pool->idle()) && (!_writer || _writer->idle())
+	;
+	if (idle && _compaction_policy.enabled && _ts_next_compaction <= ts_now && budget_left()) {
+		_compaction_active = compactFragments();
+		// keep going while there is work
+		_ts_next_compaction = ts_now + (_compaction_active ? 1000 : 30*1000);
+	}
 
-							i++;
-						}
-					}
+	// checkpoint, after compaction wrote its fragments
+	if (idle && !_compaction_active && _catalog && _catalog->needsSave() && _ts_next_catalog_save <= ts_now && budget_left()) {
+		saveCatalog();
+		// its a full rewrite
+		_ts_next_catalog_save = ts_now + 60*1000;
+	}
 
-					// curser end
-					if (!msg_reg->valid(vcb.curser_end) || !msg_reg->all_of<Message::Components::Timestamp>(vcb.curser_end)) {
-						continue;
-					}
-					const auto ts_end = msg_reg->get<Message::Components::Timestamp>(vcb.curser_end).ts;
-
-					// aka "scroll up"
-					{ // find oldest(-ish) frag in range
-						// frag begin >= range end
-
-						// lower bound of frag begin and range end
-						const auto left = std::lower_bound(
-							cf.sorted_begin.cbegin(),
-							cf.sorted_begin.cend(),
-							ts_end,
-							[&](const Object element, const auto& value) -> bool {
-								return _os.registry().get<ObjComp::MessagesTSRange>(element).begin < value;
-							}
-						);
+	updateMetricGauges(ts_now);
+	_metrics.tick_time.record(std::chrono::steady_clock::now() - tick_start);
 
-						Object prev_frag{entt::null};
-						if (left != cf.sorted_begin.cend()) {
-							prev_frag = cf.prev(*left);
-						}
-						// we checked earlier that cf is not empty
-						if (!_os.registry().valid(prev_frag)) {
-							// fall back to closest, cf is not empty
-							prev_frag = cf.sorted_begin.back();
-						}
+	// when do we need to run again?
 
-						// a single adjacent frag is often not enough
-						// only ok bc next is cheap
-						for (size_t i = 0; i < 5 && _os.registry().valid(prev_frag); prev_frag = cf.prev(prev_frag)) {
-							auto fh = _os.objectHandle(prev_frag);
-							if (fh.any_of<ObjComp::Ephemeral::MessagesEmptyTag>()) {
-								continue; // skip known empty
-							}
+	if (saves_left || !_event_check_queue.empty() || (!_potentially_dirty_contacts.empty() && !loads_blocked())) {
+		// out of budget
+		return 0.f;
+	}
 
-							if (!loaded_frags.contains(prev_frag)) {
-								std::cout << "MFS: prev frag of range\n";
-								loadFragment(*msg_reg, fh);
-								return 0.05f;
-							}
+	float next_tick = 1000.f*60.f*60.f;
 
-							i++;
-						}
-					}
-				}
-			}
-		} else {
-			// contact has no fragments, skip
-		}
+	if ((_loader_pool && !_loader_pool->idle()) || (_writer && !_writer->idle())) {
+		// come back for the results
+		next_tick = 0.02f;
+	}
 
-		_potentially_dirty_contacts.erase(it);
+	for (const auto& [_, entry] : _frag_save_queue) {
+		const auto due = saveDueTS(entry);
+		next_tick = std::min(next_tick, due > ts_now ? (due - ts_now)/1000.f : 0.f);
+	}
 
-		return 0.05f;
+	if (_compaction_active) {
+		next_tick = std::min(next_tick, _ts_next_compaction > ts_now ? (_ts_next_compaction - ts_now)/1000.f : 0.f);
 	}
 
+	if (_catalog && _catalog->needsSave()) {
+		next_tick = std::min(next_tick, _ts_next_catalog_save > ts_now ? (_ts_next_catalog_save - ts_now)/1000.f : 0.f);
+	}
 
-	return 1000.f*60.f*60.f;
+	return next_tick;
 }
 
 bool MessageFragmentStore::onEvent(const Message::Events::MessageConstruct& e) {
@@ -851,6 +2443,31 @@ bool MessageFragmentStore::onEvent(const Message::Events::MessageUpdated& e) {
 	return false;
 }
 
+bool MessageFragmentStore::onEvent(const Message::Events::MessageDestory& e) {
+	if (e.e.all_of<Message::Components::ViewCurserBegin>() && e.e.registry()->ctx().contains<Message::Contexts::ViewMotion>()) {
+		e.e.registry()->ctx().get<Message::Contexts::ViewMotion>().views.erase(e.e);
+	}
+
+	if (
+		e.e.registry()->ctx().contains<Message::Contexts::DedupIndex>() &&
+		e.e.all_of<Message::Components::Timestamp, Message::Components::ContactFrom, Message::Components::ContactTo>()
+	) {
+		if (const auto* dk = dedupKeyOf(*e.e.registry()); dk != nullptr) {
+			e.e.registry()->ctx().get<Message::Contexts::DedupIndex>().remove(dk->fn(e.e), e.e);
+		}
+	}
+
+	if (!e.e.all_of<Message::Components::MFSObj>()) {
+		return false;
+	}
+
+	if (e.e.registry()->ctx().contains<Message::Contexts::FragmentMessages>()) {
+		e.e.registry()->ctx().get<Message::Contexts::FragmentMessages>().remove(e.e.get<Message::Components::MFSObj>().o, e.e);
+	}
+
+	return false;
+}
+
 // TODO: handle deletes? diff between unload?
 
 bool MessageFragmentStore::onEvent(const ObjectStore::Events::ObjectConstruct& e) {
@@ -858,9 +2475,17 @@ bool MessageFragmentStore::onEvent(const ObjectStore::Events::ObjectConstruct& e
 		return false; // skip self
 	}
 
+	// new fragments only after they are written (update)
+	catalogUpdate(e.e);
+
 	if (!e.e.all_of<ObjComp::MessagesTSRange, ObjComp::MessagesContact>()) {
 		return false; // not for us
 	}
+	if (_catalog && e.e.all_of<ObjComp::ID>() && _catalog->retired(e.e.get<ObjComp::ID>().v)) {
+		// emptied by compaction, found by a scan
+		e.e.emplace_or_replace<ObjComp::Ephemeral::MessagesEmptyTag>();
+		return false;
+	}
 	if (!e.e.all_of<ObjComp::MessagesVersion>()) {
 		// missing version, adding
 		// version check is later
@@ -871,14 +2496,7 @@ bool MessageFragmentStore::onEvent(const ObjectStore::Events::ObjectConstruct& e
 
 	Contact4 frag_contact = entt::null;
 	{ // get contact
-		const auto& frag_contact_id = e.e.get<ObjComp::MessagesContact>().id;
-		// TODO: id lookup table, this is very inefficent
-		for (const auto& [c_it, id_it] : _cs.registry().view<Contact::Components::ID>().each()) {
-			if (frag_contact_id == id_it.data) {
-				frag_contact = c_it;
-				break;
-			}
-		}
+		frag_contact = contactFromID(e.e.get<ObjComp::MessagesContact>().id);
 		if (!_cs.registry().valid(frag_contact)) {
 			// unkown contact
 			return false;
@@ -907,6 +2525,9 @@ bool MessageFragmentStore::onEvent(const ObjectStore::Events::ObjectConstruct& e
 }
 
 bool MessageFragmentStore::onEvent(const ObjectStore::Events::ObjectUpdate& e) {
+	// including our own writes
+	catalogUpdate(e.e);
+
 	if (_fs_ignore_event) {
 		return false; // skip self
 	}
@@ -916,8 +2537,8 @@ bool MessageFragmentStore::onEvent(const ObjectStore::Events::ObjectUpdate& e) {
 	}
 
 	// since its an update, we might have it associated, or not
-	// its also possible it was tagged as empty
-	e.e.remove<ObjComp::Ephemeral::MessagesEmptyTag>();
+	// its also possible it was tagged as empty or broken
+	e.e.remove<ObjComp::Ephemeral::MessagesEmptyTag, ObjComp::Ephemeral::MessagesDecodeErrorTag, ObjComp::Ephemeral::MessagesDecodedCount>();
 
 	Contact4 frag_contact = entt::null;
 	{ // get contact
@@ -927,14 +2548,7 @@ bool MessageFragmentStore::onEvent(const ObjectStore::Events::ObjectUpdate& e) {
 		}
 
 		if (!_cs.registry().valid(frag_contact)) {
-			const auto& frag_contact_id = e.e.get<ObjComp::MessagesContact>().id;
-			// TODO: id lookup table, this is very inefficent
-			for (const auto& [c_it, id_it] : _cs.registry().view<Contact::Components::ID>().each()) {
-				if (frag_contact_id == id_it.data) {
-					frag_contact = c_it;
-					break;
-				}
-			}
+			frag_contact = contactFromID(e.e.get<ObjComp::MessagesContact>().id);
 			if (!_cs.registry().valid(frag_contact)) {
 				// unkown contact
 				return false;
@@ -964,3 +2578,29 @@ bool MessageFragmentStore::onEvent(const ObjectStore::Events::ObjectUpdate& e) {
 	return false;
 }
 
+bool MessageFragmentStore::onEvent(const Contact::Events::Contact4Construct& e) {
+	if (e.e.all_of<Contact::Components::ID>()) {
+		_contact_id_lookup.insert_or_assign(e.e.get<Contact::Components::ID>().data, e.e.entity());
+	}
+	return false;
+}
+
+bool MessageFragmentStore::onEvent(const Contact::Events::Contact4Update& e) {
+	// the old id (if changed) gets dropped lazily on lookup
+	if (e.e.all_of<Contact::Components::ID>()) {
+		_contact_id_lookup.insert_or_assign(e.e.get<Contact::Components::ID>().data, e.e.entity());
+	}
+	return false;
+}
+
+bool MessageFragmentStore::onEvent(const Contact::Events::Contact4Destory& e) {
+	if (e.e.all_of<Contact::Components::ID>()) {
+		const auto it = _contact_id_lookup.find(e.e.get<Contact::Components::ID>().data);
+		if (it != _contact_id_lookup.end() && it->second == e.e.entity()) {
+			_contact_id_lookup.erase(it);
+		}
+	}
+	_contact_last_serviced.erase(e.e.entity());
+	return false;
+}
+
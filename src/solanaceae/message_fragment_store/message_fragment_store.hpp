@@ -2,21 +2,35 @@
 
 #include <solanaceae/object_store/object_store.hpp>
 #include <solanaceae/object_store/meta_components.hpp>
+#include <solanaceae/object_store/serializer_json.hpp>
 
 #include <solanaceae/message3/message_serializer.hpp>
 
 #include <solanaceae/util/uuid_generator.hpp>
 
 #include "./meta_messages_components.hpp"
+#include "./id_hash.hpp"
+#include "./fragment_codec.hpp"
+#include "./fragment_dictionary.hpp"
+#include "./fragment_loader_pool.hpp"
+#include "./fragment_writer.hpp"
+#include "./fragment_catalog.hpp"
+#include "./fragment_store_metrics.hpp"
 
 #include <entt/container/dense_map.hpp>
 #include <entt/container/dense_set.hpp>
 
 #include <solanaceae/contact/fwd.hpp>
+#include <solanaceae/contact/contact_store_i.hpp>
 #include <solanaceae/message3/registry_message_model.hpp>
 
 #include <deque>
+#include <chrono>
+#include <memory>
+#include <filesystem>
 #include <vector>
+#include <functional>
+#include <limits>
 #include <cstdint>
 
 namespace Message::Components {
@@ -41,16 +55,63 @@ namespace Message::Components {
 
 } // Message::Components
 
+namespace Contact::Components {
+
+	// optional, next to MessageIsSame
+	// messages MessageIsSame considers the same HAVE to produce the same key
+	// used to avoid comparing every message on fragment load
+	// (same key -> MessageIsSame decides, different key -> not the same)
+	struct MessageDedupKey {
+		std::function<uint64_t(const Message3Handle m)> fn;
+	};
+
+} // Contact::Components
+
+// when to stop putting new messages into an open fragment
+// keeps fragments small, since they are rewritten completely on every save
+struct FragmentSealPolicy final {
+	size_t max_messages {1024};
+	size_t max_bytes {256*1024}; // serialized, checked on save
+	uint64_t max_ts_extent {1000*60*60}; // ms
+};
+
+// idle time rewriting of fragments that are not open (anymore)
+// only loaded fragments are touched, the messages are already in memory
+struct FragmentCompactionPolicy final {
+	bool enabled {true};
+	// adjacent fragments are merged if one of them has less messages
+	size_t small_messages {64};
+	// and the result stays below
+	size_t target_messages {512};
+	uint64_t max_ts_extent {1000ull*60*60*24*7}; // ms, of the merged fragment
+	// fragments with more messages are split into target_messages sized ones
+	size_t split_messages {2048};
+};
+
+namespace Message::Contexts {
+	struct DedupIndex;
+	struct ContactFragments;
+} // Message::Contexts
+
 // handles fragments for messages
 // on new message: assign fuid
 // on new and update: mark as fragment dirty
 // on delete: mark as fragment dirty?
-class MessageFragmentStore : public RegistryMessageModelEventI, public ObjectStoreEventI {
+class MessageFragmentStore : public RegistryMessageModelEventI, public ObjectStoreEventI, public ContactStore4EventI {
 	public:
 		static constexpr const char* version {"3"};
 
+		// errors are always logged
+		enum class LogLevel : uint8_t {
+			error,
+			warning,
+			info, // fragment lifecycle (create, merge, evict ...)
+			debug, // per load, per range hit
+		};
+
 	protected:
 		ContactStore4I& _cs;
+		ContactStore4I::SubscriptionReference _cs_sr;
 		RegistryMessageModelI& _rmm;
 		RegistryMessageModelI::SubscriptionReference _rmm_sr;
 		ObjectStore2& _os;
@@ -64,17 +125,116 @@ class MessageFragmentStore : public RegistryMessageModelEventI, public ObjectSto
 
 		void handleMessage(const Message3Handle& m);
 
-		void loadFragment(Message3Registry& reg, ObjectHandle oh);
+		// creates, indexes and marks loaded, but does not open
+		ObjectHandle newFragment(Message3Registry& reg, uint64_t ts_begin, uint64_t ts_end);
+
+		// format of new fragments, see setFragmentVersion()
+		uint16_t _new_fragment_version {2};
+
+		FragmentSealPolicy _seal_policy;
+		// seals the fragment if full
+		bool placeableInto(Message3Registry& reg, Object frag);
+
+		// returns nullptr if the contact does not provide a MessageDedupKey
+		const Contact::Components::MessageDedupKey* dedupKeyOf(const Message3Registry& reg) const;
+		// creates and fills the index on first use
+		Message::Contexts::DedupIndex& dedupIndex(Message3Registry& reg, const Contact::Components::MessageDedupKey& dk);
 
-		bool syncFragToStorage(ObjectHandle oh, Message3Registry& reg);
+		// [view_lo, view_hi] is the ts range of the view that needs the fragment,
+		// only the rows around it are loaded if the fragment has a row index.
+		// partially loaded fragments load the rest
+		void loadFragment(Message3Registry& reg, ObjectHandle oh, uint64_t view_lo = 0, uint64_t view_hi = std::numeric_limits<uint64_t>::max());
+		// loads on the loader pool, if enabled, otherwise same as loadFragment()
+		void requestLoadFragment(Message3Registry& reg, ObjectHandle fh, uint64_t view_lo = 0, uint64_t view_hi = std::numeric_limits<uint64_t>::max());
+		FragmentSlice fragmentSlice(Message3Registry& reg, ObjectHandle fh, uint16_t version, uint64_t view_lo, uint64_t view_hi) const;
+		bool loadPending(Object frag) const;
+		// creates the messages, decode_fn feeds them into the sink
+		// data_size is used as memory estimate
+		// partial_rows is read after decoding, partial() if only a part was decoded
+		// requested is when the load was asked for, for the load latency
+		void commitFragmentData(Message3Registry& reg, ObjectHandle fh, std::chrono::steady_clock::time_point requested, size_t data_size, const MessageRows& partial_rows, const std::function<bool(MessagesDecodeSinkI&)>& decode_fn);
+
+		// destroys the messages of a loaded fragment
+		void unloadFragment(Message3Registry& reg, Object frag);
+
+		// memory budget for loaded fragments (serialized size)
+		size_t _budget_total_bytes {64*1024*1024};
+		size_t _budget_contact_bytes {16*1024*1024};
+		// fragments this close (in fragments) to a view are never evicted
+		size_t _evict_keep_adjacent {8};
+		uint64_t _ts_last_eviction_check {0};
+		// lru eviction of loaded fragments far away from any view, until within budget
+		void evictFragments(void);
+
+		FragmentCompactionPolicy _compaction_policy;
+		uint64_t _ts_next_compaction {0};
+		bool _compaction_active {false}; // last run did something
+		// still hold messages that failed to be written elsewhere
+		entt::dense_set<Object> _compaction_pinned;
+		// one merge or split, returns false if there was nothing to do
+		bool compactFragments(void);
+		bool compactContact(Message3Registry& reg);
+		// moves the messages into dst, which is written before src is retired
+		bool mergeFragments(Message3Registry& reg, ObjectHandle dst, ObjectHandle src, const std::vector<Message3>& src_msgs);
+		// msgs sorted by ts, the new fragments are written before fh shrinks
+		bool splitFragment(Message3Registry& reg, ObjectHandle fh, const std::vector<Message3>& msgs);
+		// writes an empty message array and forgets the fragment
+		bool retireFragment(Message3Registry& reg, ObjectHandle fh);
+
+		// optional, see enableCatalog()
+		std::unique_ptr<FragmentCatalog> _catalog;
+		uint64_t _ts_next_catalog_save {0};
+		// fragments of our backend only
+		void catalogUpdate(ObjectHandle fh);
+		void saveCatalog(void);
+
+		// optional, see enableLoaderPool()
+		std::unique_ptr<FragmentLoaderPool> _loader_pool;
+		void collectLoadedFragments(void);
+		// dedup and throw construct for a freshly deserialized message
+		void commitLoadedMessage(Message3Registry& reg, ObjectHandle fh, Message3Handle new_real_msg, const Contact::Components::MessageDedupKey* dk, size_t& messages_new_or_updated);
+
+		// bytes is the size of the serialized messages
+		// write_behind=false always writes now, to know the result
+		bool syncFragToStorage(ObjectHandle oh, Message3Registry& reg, size_t& bytes, bool write_behind = true);
+		MessagesMsgPackWriter _msgpack_writer;
+		MessagesColumnarWriter _columnar_writer;
+		std::vector<uint8_t> _sync_buffer;
+
+		// optional, see enableWriteBehind()
+		std::unique_ptr<FragmentWriter> _writer;
+		// throws the update events, failed writes get queued again
+		void collectWrites(bool requeue_failed);
 
 		struct SaveQueueEntry final {
 			uint64_t ts_since_dirty{0};
+			// pushed back by every change, we save once it is quiet
+			uint64_t ts_last_dirty{0};
 			//std::vector<uint8_t> id;
 			ObjectHandle id;
 			Message3Registry* reg{nullptr};
 		};
-		std::deque<SaveQueueEntry> _frag_save_queue;
+		// one entry per fragment
+		entt::dense_map<Object, SaveQueueEntry> _frag_save_queue;
+		void queueFragSave(ObjectHandle fh, Message3Registry* reg);
+
+		// saves per tick are limited by time and size
+		uint64_t _save_budget_ms {5};
+		size_t _save_budget_bytes {4*1024*1024};
+
+		// failed saves are retried with exponential backoff
+		struct SaveFailure final {
+			uint32_t count {0};
+			uint64_t ts_last {0};
+		};
+		entt::dense_map<Object, SaveFailure> _save_failures;
+		void recordSaveFailure(Object frag);
+		uint64_t saveDueTS(const SaveQueueEntry& entry) const;
+
+		// wall clock time per tick()
+		std::chrono::steady_clock::duration _tick_budget {std::chrono::milliseconds(5)};
+
+		bool serviceDirtyContact(Contact4 c);
 
 		struct ECQueueEntry final {
 			ObjectHandle fid;
@@ -87,9 +247,59 @@ class MessageFragmentStore : public RegistryMessageModelEventI, public ObjectSto
 		// so we need to keep them dirty until nothing was loaded.
 		entt::dense_set<Contact4> _potentially_dirty_contacts;
 
+		// serviced in order of: has a view, distance to the closest unloaded fragment,
+		// and least recently serviced (round robin)
+		uint64_t _service_seq {0};
+		entt::dense_map<Contact4, uint64_t> _contact_last_serviced;
+		// in ms, max if nothing to load near a view
+		uint64_t unloadedFragmentDistance(Message3Registry& reg) const;
+
+		// speculative loading in scroll direction
+		uint64_t _prefetch_lookahead_ms {2000};
+		size_t _prefetch_max_frags {8};
+		// prefetched, but not yet visible
+		entt::dense_set<Object> _prefetched;
+		void sampleViewMotion(const Message3Handle& curser);
+		// returns true if it requested a load and can not request more
+		bool prefetchViews(Message3Registry& reg, const Message::Contexts::ContactFragments& cf);
+		std::vector<Contact4> dirtyContactsByPriority(void);
+
 		// for cleaning up the ctx vars we create
 		entt::dense_set<Contact4> _touched_contacts;
 
+		// kept up-to-date by contact events
+		// used to find the contact of a fragment
+		entt::dense_map<std::vector<uint8_t>, Contact4, IDHash> _contact_id_lookup;
+
+		Contact4 contactFromID(const std::vector<uint8_t>& id);
+
+		// zstd dictionaries by id, see FragmentDictionary
+		entt::dense_map<uint32_t, std::shared_ptr<const FragmentDictionary>> _dictionaries;
+		// for new fragments, 0 is none
+		uint32_t _default_dictionary {0};
+		entt::dense_map<std::vector<uint8_t>, uint32_t, IDHash> _contact_dictionaries;
+		// dict is nullptr if the fragment does not use one
+		// returns false if it does, but we dont have it
+		bool fragmentDictionary(ObjectHandle fh, std::shared_ptr<const FragmentDictionary>& dict) const;
+		std::vector<uint8_t> _dict_buffer;
+
+	public:
+		struct PrefetchStats final {
+			uint64_t issued {0};
+			uint64_t hits {0}; // prefetched fragment became visible
+			uint64_t misses {0}; // visible fragment had to be loaded on demand
+			uint64_t wasted {0}; // prefetched fragment was unloaded before becoming visible
+		};
+
+	protected:
+		PrefetchStats _prefetch_stats;
+
+		FragmentStoreMetrics _metrics;
+		void updateMetricGauges(uint64_t ts_now);
+
+		LogLevel _log_level {LogLevel::info};
+		bool logs(LogLevel level) const { return level <= _log_level; }
+
 	public:
 		MessageFragmentStore(
 			ContactStore4I& cr,
@@ -101,14 +311,86 @@ class MessageFragmentStore : public RegistryMessageModelEventI, public ObjectSto
 		);
 		virtual ~MessageFragmentStore(void);
 
+		// the message fragment meta components, for stores without an mfs (eg. on other threads)
+		// (the constructor registers them for os)
+		static void registerSerializers(SerializerJsonCallbacks<Object>& sjc);
+		// plain copies of the same (and the object store's data meta), for ObjectSnapshot
+		// (the constructor registers them for os)
+		static void registerCopies(ComponentCopyCallbacks& ccc);
+
+		// read and decode fragments on worker threads
+		// each worker gets its own backend instance from backend_factory
+		void enableLoaderPool(FragmentLoaderPool::BackendFactory backend_factory, size_t worker_count = 2, size_t max_in_flight = 8);
+
+		// compress and write fragments on a writer thread
+		// the writer gets its own backend instance from backend_factory
+		void enableWriteBehind(StorageBackendAtomicFactory backend_factory);
+
+		// limits how much is saved per tick (time and serialized size)
+		// at least one due fragment is saved every tick
+		void setSaveBudget(uint64_t time_ms, size_t bytes);
+
+		// unload fragments far outside of any view, when over budget
+		// limits are estimated by the serialized size of the fragments
+		void setMemoryBudget(size_t total_bytes, size_t contact_bytes);
+
+		// how far ahead (in time the user scrolls) fragments are prefetched, 0 disables
+		void setPrefetch(float lookahead_seconds, size_t max_frags);
+		const PrefetchStats& prefetchStats(void) const { return _prefetch_stats; }
+
+		// counters, latency histograms and queue gauges (as of the last tick)
+		const FragmentStoreMetrics& metrics(void) const { return _metrics; }
+
+		void setLogLevel(LogLevel level);
+
+		// makes the dictionary available for reading (and writing)
+		// returns the dictionary id, 0 on failure
+		uint32_t addDictionary(ByteSpan dict_data);
+		// new fragments are compressed with this dictionary, 0 is none
+		void setDictionary(uint32_t dict_id);
+		// overrides the default for a contact (by contact id)
+		void setContactDictionary(const std::vector<uint8_t>& contact_id, uint32_t dict_id);
+
+		// keep a catalog of all fragments in storage_path (the backend's directory) at catalog_path
+		// needs to be outside of storage_path, it is checkpointed at idle time and on destruction
+		void enableCatalog(std::filesystem::path catalog_path, std::filesystem::path storage_path);
+		// creates the fragment objects from the catalog, instead of scanning the backend
+		// returns false if the catalog is missing or stale, the backend needs to scan then
+		// (call before any scan)
+		bool loadCatalog(void);
+
+		// format new fragments are written in, 2 (msgpack) or 3 (columnar)
+		// stores written with 3 can not be read by readers that only know 1 and 2,
+		// so keep 2 until every reader of the store has v3 support
+		// (existing fragments keep their version)
+		void setFragmentVersion(uint16_t version);
+
+		void setSealPolicy(const FragmentSealPolicy& policy);
+		void setCompactionPolicy(const FragmentCompactionPolicy& policy);
+
+		// saves all dirty fragments now and waits for the writes to finish
+		// (called on destruction)
+		void flush(void);
+
+		// runs until there is nothing left to do, or the tick budget is spent
+		// returns the time until it wants to run again (0 if the budget ran out)
 		float tick(float time_delta);
 
+		// wall clock time tick() can spend per call, trades latency for throughput
+		void setTickBudget(float seconds);
+
 	protected: // rmm
 		bool onEvent(const Message::Events::MessageConstruct& e) override;
 		bool onEvent(const Message::Events::MessageUpdated& e) override;
+		bool onEvent(const Message::Events::MessageDestory& e) override;
 
 	protected: // fs
 		bool onEvent(const ObjectStore::Events::ObjectConstruct& e) override;
 		bool onEvent(const ObjectStore::Events::ObjectUpdate& e) override;
+
+	protected: // cs
+		bool onEvent(const Contact::Events::Contact4Construct& e) override;
+		bool onEvent(const Contact::Events::Contact4Update& e) override;
+		bool onEvent(const Contact::Events::Contact4Destory& e) override;
 };
 
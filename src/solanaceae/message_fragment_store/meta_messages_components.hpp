@@ -7,6 +7,8 @@ namespace ObjectStore::Components {
 		// messages Object version
 		// 1 -> text_json
 		// 2 -> msgpack
+		// 3 -> columnar (see MessagesColumnarWriter)
+		// new fragments are 3, the default is for objects missing the version
 		uint16_t v {2};
 	};
 
@@ -20,6 +22,12 @@ namespace ObjectStore::Components {
 		std::vector<uint8_t> id;
 	};
 
+	// data is a zstd frame compressed with this (trained) dictionary,
+	// backend data compression is none (see FragmentDictionary)
+	struct MessagesDictionary {
+		uint32_t id {0}; // zstd dictionary id
+	};
+
 	// TODO: add src contact (self id)
 
 } // ObjectStore::Components
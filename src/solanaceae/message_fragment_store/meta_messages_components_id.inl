@@ -21,6 +21,7 @@ constexpr std::string_view entt::type_name<x>::value() noexcept { \
 DEFINE_COMP_ID(ObjComp::MessagesVersion)
 DEFINE_COMP_ID(ObjComp::MessagesTSRange)
 DEFINE_COMP_ID(ObjComp::MessagesContact)
+DEFINE_COMP_ID(ObjComp::MessagesDictionary)
 
 // old stuff
 //DEFINE_COMP_ID(FragComp::MessagesTSRange)
@@ -0,0 +1,74 @@
+#include "./object_snapshot.hpp"
+
+#include <solanaceae/object_store/serializer_json.hpp>
+
+#include <iostream>
+
+ObjectSnapshot ObjectSnapshot::take(ObjectHandle oh, bool with_serialized) {
+	ObjectSnapshot snap;
+
+	if (oh.all_of<ObjComp::ID>()) {
+		snap.id = oh.get<ObjComp::ID>().v;
+	}
+
+	snap.known.take(oh);
+
+	if (with_serialized) {
+		auto* sjc = oh.registry()->ctx().find<SerializerJsonCallbacks<Object>>();
+		const auto* ccc = oh.registry()->ctx().find<ComponentCopyCallbacks>();
+		if (sjc != nullptr) {
+			for (const auto& [type, fn] : sjc->_serl) {
+				if (ccc != nullptr) {
+					const auto take_it = ccc->_take.find(type);
+					if (take_it != ccc->_take.cend()) {
+						auto copy = take_it->second(oh);
+						if (copy) {
+							snap.copied.push_back(std::move(copy));
+						}
+						continue;
+					}
+				}
+
+				// fn fails if the object does not have the component
+				nlohmann::json j;
+				if (fn(oh, j)) {
+					snap.serialized.emplace_back(type, std::move(j));
+				}
+			}
+		}
+	}
+
+	return snap;
+}
+
+ObjectHandle ObjectSnapshot::apply(ObjectStore2& os) const {
+	ObjectHandle oh{os.registry(), os.registry().create()};
+
+	oh.emplace<ObjComp::ID>(id);
+	known.apply(oh);
+	applyMeta(oh);
+
+	return oh;
+}
+
+void ObjectSnapshot::applyMeta(ObjectHandle oh) const {
+	for (const auto& copy : copied) {
+		copy(oh);
+	}
+
+	if (serialized.empty()) {
+		return;
+	}
+
+	auto& sjc = oh.registry()->ctx().get<SerializerJsonCallbacks<Object>>();
+	for (const auto& [type, j] : serialized) {
+		const auto deserl_it = sjc._deserl.find(type);
+		if (deserl_it == sjc._deserl.cend()) {
+			std::cerr << "MFS error: no deserializer for component " << type << " in snapshot\n";
+			continue;
+		}
+
+		deserl_it->second(oh, j);
+	}
+}
+
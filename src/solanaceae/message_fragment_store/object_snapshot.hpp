@@ -0,0 +1,100 @@
+#pragma once
+
+#include <solanaceae/object_store/object_store.hpp>
+#include <solanaceae/object_store/meta_components.hpp>
+
+#include "./meta_messages_components.hpp"
+
+#include <entt/core/fwd.hpp>
+#include <entt/core/type_info.hpp>
+#include <entt/container/dense_map.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <memory>
+#include <functional>
+#include <optional>
+#include <tuple>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+// creates a backend instance for a thread owned ObjectStore2
+// it needs to be able to read/write the same objects as the main backend
+using StorageBackendAtomicFactory = std::function<std::shared_ptr<StorageBackendIAtomic>(ObjectStore2& os)>;
+
+// plain copies of some components, for types we know
+template<typename... Comps>
+struct ComponentSnapshot {
+	std::tuple<std::optional<Comps>...> comps;
+
+	void take(ObjectHandle oh) {
+		((std::get<std::optional<Comps>>(comps) = oh.all_of<Comps>() ? std::optional<Comps>{oh.get<Comps>()} : std::nullopt), ...);
+	}
+
+	void apply(ObjectHandle oh) const {
+		((std::get<std::optional<Comps>>(comps).has_value() ? (void)oh.emplace_or_replace<Comps>(*std::get<std::optional<Comps>>(comps)) : (void)0), ...);
+	}
+};
+
+// plain copies of meta components by type, instead of a json round trip
+// lives in the ObjectStore2's registry ctx, next to SerializerJsonCallbacks<Object>,
+// types without a copy fall back to the json serializers (see ObjectSnapshot)
+struct ComponentCopyCallbacks {
+	// copies the component off the object, the result emplaces the copy onto another object
+	// (empty if the object does not have the component)
+	using take_fn = std::function<void(ObjectHandle)>(*)(ObjectHandle oh);
+	entt::dense_map<entt::id_type, take_fn> _take;
+
+	template<typename Comp>
+	void registerCopy(entt::id_type type_id = entt::type_hash<Comp>::value()) {
+		_take[type_id] = [](ObjectHandle oh) -> std::function<void(ObjectHandle)> {
+			if (!oh.all_of<Comp>()) {
+				return {};
+			}
+			return [comp = oh.get<Comp>()](ObjectHandle dst) {
+				dst.emplace_or_replace<Comp>(comp);
+			};
+		};
+	}
+
+	// for serializer aliases of a copied component (eg. old names), the copy already covers them
+	void registerCovered(entt::id_type type_id) {
+		_take[type_id] = [](ObjectHandle) -> std::function<void(ObjectHandle)> {
+			return {};
+		};
+	}
+};
+
+// copy of an object's meta, that can be applied to a different ObjectStore2
+// eg. owned by a different thread, since the object registry is not thread safe
+struct ObjectSnapshot {
+	std::vector<uint8_t> id;
+
+	// what backends need to find and read/write the data
+	ComponentSnapshot<
+		ObjComp::DataEncryptionType,
+		ObjComp::DataCompressionType,
+		ObjComp::Ephemeral::FilePath,
+		ObjComp::Ephemeral::MetaFileType,
+		ObjComp::Ephemeral::MetaEncryptionType,
+		ObjComp::Ephemeral::MetaCompressionType,
+		ObjComp::MessagesVersion
+	> known;
+
+	// every other component with a json serializer (optional, needed to write meta)
+	// taken as plain copies if the ComponentCopyCallbacks have the type
+	std::vector<std::function<void(ObjectHandle)>> copied;
+	std::vector<std::pair<entt::id_type, nlohmann::json>> serialized;
+
+	// take on the thread owning oh
+	static ObjectSnapshot take(ObjectHandle oh, bool with_serialized);
+
+	// creates a new object in os, take care to destroy it again
+	// serialized components are deserialized using the os's SerializerJsonCallbacks
+	ObjectHandle apply(ObjectStore2& os) const;
+
+	// only the copied and serialized components, onto an existing object (eg. one created by a backend)
+	void applyMeta(ObjectHandle oh) const;
+};
+
@@ -0,0 +1,230 @@
+#include "./memory_storage.hpp"
+
+#include <solanaceae/object_store/meta_components.hpp>
+
+#include <zstd.h>
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+#include <iostream>
+
+namespace Backends {
+
+MemoryStorage::clock::time_point MemoryStorage::Device::reserve(bool write, size_t bytes) {
+	std::lock_guard lg{_mutex};
+
+	const auto latency = write ? _limits.write_latency : _limits.read_latency;
+	const size_t bytes_per_second = write ? _limits.write_bytes_per_second : _limits.read_bytes_per_second;
+	auto& busy_until = write ? _write_busy_until : _read_busy_until;
+
+	const auto now = clock::now();
+	if (bytes_per_second == 0) {
+		return now + latency;
+	}
+
+	// transfers queue up behind each other
+	const auto start = std::max(now, busy_until);
+	busy_until = start + std::chrono::microseconds{static_cast<int64_t>(bytes * 1'000'000ull / bytes_per_second)};
+	return busy_until + latency;
+}
+
+void MemoryStorage::Device::setLimits(const Limits& limits) {
+	std::lock_guard lg{_mutex};
+	_limits = limits;
+}
+
+size_t MemoryStorage::Device::objectCount(void) const {
+	std::lock_guard lg{_mutex};
+	return _entries.size();
+}
+
+size_t MemoryStorage::Device::storedBytes(void) const {
+	std::lock_guard lg{_mutex};
+	size_t bytes {0};
+	for (const auto& [_, entry] : _entries) {
+		bytes += entry.data.size();
+	}
+	return bytes;
+}
+
+bool MemoryStorage::Device::lastWrite(const std::vector<uint8_t>& id, clock::time_point& time) const {
+	std::lock_guard lg{_mutex};
+	const auto it = _entries.find(id);
+	if (it == _entries.cend() || !it->second.has_data) {
+		return false;
+	}
+	time = it->second.last_write;
+	return true;
+}
+
+bool MemoryStorage::Device::storedData(const std::vector<uint8_t>& id, std::vector<uint8_t>& data) const {
+	std::lock_guard lg{_mutex};
+	const auto it = _entries.find(id);
+	if (it == _entries.cend() || !it->second.has_data) {
+		return false;
+	}
+	data = it->second.data;
+	return true;
+}
+
+bool MemoryStorage::Device::modifyData(const std::vector<uint8_t>& id, const std::function<void(std::vector<uint8_t>& data)>& fn) {
+	std::lock_guard lg{_mutex};
+	const auto it = _entries.find(id);
+	if (it == _entries.end() || !it->second.has_data) {
+		return false;
+	}
+	auto& entry = it->second;
+
+	if (!entry.zstd) {
+		fn(entry.data);
+		return true;
+	}
+
+	const auto content_size = ZSTD_getFrameContentSize(entry.data.data(), entry.data.size());
+	if (content_size == ZSTD_CONTENTSIZE_UNKNOWN || content_size == ZSTD_CONTENTSIZE_ERROR) {
+		return false;
+	}
+	std::vector<uint8_t> data(content_size);
+	if (ZSTD_isError(ZSTD_decompress(data.data(), data.size(), entry.data.data(), entry.data.size()))) {
+		return false;
+	}
+
+	fn(data);
+
+	entry.data.resize(ZSTD_compressBound(data.size()));
+	const size_t ret = ZSTD_compress(entry.data.data(), entry.data.size(), data.data(), data.size(), ZSTD_CLEVEL_DEFAULT);
+	if (ZSTD_isError(ret)) {
+		return false;
+	}
+	entry.data.resize(ret);
+	return true;
+}
+
+MemoryStorage::MemoryStorage(ObjectStore2& os, std::shared_ptr<Device> device) : _os(os), _device(std::move(device)) {
+}
+
+MemoryStorage::~MemoryStorage(void) {
+}
+
+void MemoryStorage::scan(void) {
+	std::vector<ObjectSnapshot> metas;
+	{
+		std::lock_guard lg{_device->_mutex};
+		for (const auto& [_, entry] : _device->_entries) {
+			if (entry.has_data) {
+				metas.push_back(entry.meta);
+			}
+		}
+	}
+
+	for (const auto& meta : metas) {
+		auto oh = meta.apply(_os);
+		oh.emplace_or_replace<ObjComp::Ephemeral::BackendMeta>(this);
+		oh.emplace_or_replace<ObjComp::Ephemeral::BackendAtomic>(this);
+		_os.throwEventConstruct(oh);
+	}
+}
+
+ObjectHandle MemoryStorage::newObject(ByteSpan id, bool throw_construct) {
+	std::vector<uint8_t> id_vec{id.cbegin(), id.cend()};
+	{
+		std::lock_guard lg{_device->_mutex};
+		if (!_device->_entries.emplace(id_vec, Device::Entry{}).second) {
+			std::cerr << "MemoryStorage error: object already exists\n";
+			return {};
+		}
+	}
+
+	ObjectHandle oh{_os.registry(), _os.registry().create()};
+	oh.emplace<ObjComp::ID>(std::move(id_vec));
+	oh.emplace<ObjComp::Ephemeral::BackendMeta>(this);
+	oh.emplace<ObjComp::Ephemeral::BackendAtomic>(this);
+
+	if (throw_construct) {
+		_os.throwEventConstruct(oh);
+	}
+
+	return oh;
+}
+
+bool MemoryStorage::write(Object o, ByteSpan data) {
+	auto oh = _os.objectHandle(o);
+	if (!static_cast<bool>(oh) || !oh.all_of<ObjComp::ID>()) {
+		return false;
+	}
+
+	Device::Entry entry;
+	entry.meta = ObjectSnapshot::take(oh, true);
+
+	if (oh.all_of<ObjComp::DataCompressionType>() && oh.get<ObjComp::DataCompressionType>().comp == Compression::ZSTD) {
+		entry.data.resize(ZSTD_compressBound(data.size));
+		const size_t ret = ZSTD_compress(entry.data.data(), entry.data.size(), data.ptr, data.size, ZSTD_CLEVEL_DEFAULT);
+		if (ZSTD_isError(ret)) {
+			std::cerr << "MemoryStorage error: compressing failed: " << ZSTD_getErrorName(ret) << "\n";
+			return false;
+		}
+		entry.data.resize(ret);
+		entry.zstd = true;
+	} else {
+		entry.data.assign(data.cbegin(), data.cend());
+	}
+	entry.has_data = true;
+
+	std::this_thread::sleep_until(_device->reserve(true, entry.data.size()));
+
+	_device->_stats.writes++;
+	_device->_stats.bytes_written += entry.data.size();
+
+	entry.last_write = clock::now();
+	std::lock_guard lg{_device->_mutex};
+	_device->_entries.insert_or_assign(oh.get<ObjComp::ID>().v, std::move(entry));
+
+	return true;
+}
+
+bool MemoryStorage::read(Object o, std::function<read_from_storage_put_data_cb>& data_cb) {
+	auto oh = _os.objectHandle(o);
+	if (!static_cast<bool>(oh) || !oh.all_of<ObjComp::ID>()) {
+		return false;
+	}
+
+	std::vector<uint8_t> stored;
+	{
+		std::lock_guard lg{_device->_mutex};
+		const auto it = _device->_entries.find(oh.get<ObjComp::ID>().v);
+		if (it == _device->_entries.cend() || !it->second.has_data) {
+			return false;
+		}
+		stored = it->second.data;
+	}
+
+	std::this_thread::sleep_until(_device->reserve(false, stored.size()));
+
+	_device->_stats.reads++;
+	_device->_stats.bytes_read += stored.size();
+
+	if (oh.all_of<ObjComp::DataCompressionType>() && oh.get<ObjComp::DataCompressionType>().comp == Compression::ZSTD) {
+		const auto content_size = ZSTD_getFrameContentSize(stored.data(), stored.size());
+		if (content_size == ZSTD_CONTENTSIZE_UNKNOWN || content_size == ZSTD_CONTENTSIZE_ERROR) {
+			std::cerr << "MemoryStorage error: broken zstd frame\n";
+			return false;
+		}
+
+		std::vector<uint8_t> data(content_size);
+		const size_t ret = ZSTD_decompress(data.data(), data.size(), stored.data(), stored.size());
+		if (ZSTD_isError(ret)) {
+			std::cerr << "MemoryStorage error: decompressing failed: " << ZSTD_getErrorName(ret) << "\n";
+			return false;
+		}
+
+		data_cb(ByteSpan{data});
+	} else {
+		data_cb(ByteSpan{stored});
+	}
+
+	return true;
+}
+
+} // Backends
+
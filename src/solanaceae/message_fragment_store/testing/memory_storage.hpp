@@ -0,0 +1,110 @@
+#pragma once
+
+#include <solanaceae/object_store/object_store.hpp>
+
+#include "../object_snapshot.hpp"
+#include "../id_hash.hpp"
+
+#include <entt/container/dense_map.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+namespace Backends {
+
+// objects and data kept in process, for reproducible load tests without a disk
+// data is zstd compressed if the object says so, like the filesystem backend.
+// meta is kept as an ObjectSnapshot, scan() recreates the objects from it.
+// every backend instance on the same Device sees the same objects, so workers
+// (loader pool, writer) can get their own instance for their own ObjectStore2.
+class MemoryStorage : public StorageBackendIMeta, public StorageBackendIAtomic {
+	public:
+		using clock = std::chrono::steady_clock;
+
+		// injected costs, applied to every read and write (the calling thread sleeps)
+		struct Limits {
+			std::chrono::microseconds read_latency {0};
+			std::chrono::microseconds write_latency {0};
+			// shared by all instances, like a single disk, 0 is unlimited
+			size_t read_bytes_per_second {0};
+			size_t write_bytes_per_second {0};
+		};
+
+		struct Stats {
+			std::atomic_size_t reads {0};
+			std::atomic_size_t writes {0};
+			std::atomic_size_t bytes_read {0}; // stored (compressed) size
+			std::atomic_size_t bytes_written {0};
+		};
+
+		// the shared "disk"
+		class Device {
+			friend MemoryStorage;
+
+			struct Entry {
+				ObjectSnapshot meta;
+				std::vector<uint8_t> data; // stored, maybe compressed
+				bool zstd {false};
+				bool has_data {false};
+				clock::time_point last_write;
+			};
+
+			mutable std::mutex _mutex;
+			entt::dense_map<std::vector<uint8_t>, Entry, IDHash> _entries;
+
+			Limits _limits;
+			clock::time_point _read_busy_until;
+			clock::time_point _write_busy_until;
+
+			Stats _stats;
+
+			// reserves transfer time for bytes, returns when the transfer would be done
+			clock::time_point reserve(bool write, size_t bytes);
+
+			public:
+				void setLimits(const Limits& limits);
+
+				const Stats& stats(void) const { return _stats; }
+				size_t objectCount(void) const;
+				size_t storedBytes(void) const;
+
+				// of the last completed write of the object, false if never written
+				bool lastWrite(const std::vector<uint8_t>& id, clock::time_point& time) const;
+
+				// the stored bytes of the object (maybe compressed), false if never written
+				bool storedData(const std::vector<uint8_t>& id, std::vector<uint8_t>& data) const;
+
+				// changes the (uncompressed) data behind the backends back, eg. to simulate a torn write
+				// not a write, so lastWrite() stays, false if never written
+				bool modifyData(const std::vector<uint8_t>& id, const std::function<void(std::vector<uint8_t>& data)>& fn);
+		};
+
+	private:
+		ObjectStore2& _os;
+		std::shared_ptr<Device> _device;
+
+	public:
+		MemoryStorage(ObjectStore2& os, std::shared_ptr<Device> device);
+		~MemoryStorage(void);
+
+		Device& device(void) { return *_device; }
+
+		// creates objects for everything on the device (that has data), and throws the construct events
+		// synchronous, unlike the filesystem backend's scanAsync(), call once on a fresh os
+		void scan(void);
+
+	public: // meta
+		ObjectHandle newObject(ByteSpan id, bool throw_construct = true) override;
+
+	public: // atomic
+		bool write(Object o, ByteSpan data) override;
+		bool read(Object o, std::function<read_from_storage_put_data_cb>& data_cb) override;
+};
+
+} // Backends
+
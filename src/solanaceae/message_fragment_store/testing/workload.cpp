@@ -0,0 +1,183 @@
+#include "./workload.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <cmath>
+
+WorkloadGenerator::WorkloadGenerator(const WorkloadConfig& config, uint64_t ts_start) :
+	_config(config),
+	_rng(config.seed),
+	_ts_now(ts_start)
+{
+	_msgs_per_ms.resize(_config.contacts);
+	for (size_t i = 0; i < _config.contacts; i++) {
+		_msgs_per_ms[i] = _config.max_msgs_per_hour / std::pow(float(i+1), _config.zipf_s) / (3600.f*1000.f);
+	}
+	_contact_ts.resize(_config.contacts);
+}
+
+std::vector<uint8_t> WorkloadGenerator::contactID(size_t contact) const {
+	// stable, independent of the rng state
+	std::mt19937_64 id_rng{_config.seed ^ (0x9e3779b97f4a7c15ull * (contact+1))};
+	std::vector<uint8_t> id(32);
+	for (auto& byte : id) {
+		byte = static_cast<uint8_t>(id_rng());
+	}
+	return id;
+}
+
+std::string WorkloadGenerator::text(void) {
+	std::exponential_distribution<float> len_dist{1.f / std::max<float>(_config.text_size_mean, 1.f)};
+	const size_t len = 1 + static_cast<size_t>(len_dist(_rng));
+
+	// words, so it compresses somewhat like text
+	static constexpr const char* words[] {
+		"the", "a", "to", "and", "is", "it", "you", "that", "of", "in",
+		"this", "for", "on", "with", "not", "but", "what", "just", "so", "have",
+		"message", "store", "fragment", "tomorrow", "yes", "no", "maybe", "ok",
+	};
+
+	std::string str;
+	while (str.size() < len) {
+		if (!str.empty()) {
+			str += ' ';
+		}
+		str += words[_rng() % std::size(words)];
+	}
+	str.resize(len);
+	return str;
+}
+
+bool WorkloadGenerator::expectsMessages(size_t contact, uint64_t ts_begin, uint64_t ts_end) const {
+	const auto& tss = _contact_ts.at(contact);
+	const auto it = std::lower_bound(tss.cbegin(), tss.cend(), ts_end);
+	return it != tss.cend() && *it <= ts_begin;
+}
+
+std::vector<WorkloadGenerator::HistoryMessage> WorkloadGenerator::history(size_t contact) {
+	std::vector<HistoryMessage> msgs;
+
+	const float rate = _msgs_per_ms.at(contact);
+	if (rate <= 0.f) {
+		return msgs;
+	}
+
+	std::exponential_distribution<float> gap_dist{rate};
+	const uint64_t history_ms = static_cast<uint64_t>(_config.history_days * 24.f*3600.f*1000.f);
+	uint64_t ts = _ts_now - std::min(_ts_now, history_ms);
+	while (true) {
+		ts += 1 + static_cast<uint64_t>(gap_dist(_rng));
+		if (ts >= _ts_now) {
+			break;
+		}
+		msgs.push_back({ts, (_rng() % 2) == 0, text()});
+		_contact_ts.at(contact).push_back(ts);
+	}
+
+	return msgs;
+}
+
+WorkloadGenerator::Event WorkloadGenerator::viewEvent(Event::Type type, size_t view_i) {
+	const auto& view = _views.at(view_i);
+
+	Event e;
+	e.type = type;
+	e.contact = view.contact;
+
+	const uint64_t center = view.center == 0 ? _ts_now : view.center;
+	e.view_ts_begin = center + _config.view_span_ms/2;
+	e.view_ts_end = center - std::min(center, _config.view_span_ms/2);
+	e.expects_messages = type != Event::Type::view_close && expectsMessages(e.contact, e.view_ts_begin, e.view_ts_end);
+
+	return e;
+}
+
+size_t WorkloadGenerator::pickFreeContact(void) {
+	// busy contacts are looked at more
+	std::vector<float> weights = _msgs_per_ms;
+	for (const auto& view : _views) {
+		weights.at(view.contact) = 0.f;
+	}
+	if (std::all_of(weights.cbegin(), weights.cend(), [](float w) { return w <= 0.f; })) {
+		return _rng() % _config.contacts;
+	}
+	std::discrete_distribution<size_t> dist{weights.cbegin(), weights.cend()};
+	return dist(_rng);
+}
+
+std::vector<WorkloadGenerator::Event> WorkloadGenerator::begin(void) {
+	std::vector<Event> events;
+
+	const size_t view_count = std::min(_config.open_views, _config.contacts);
+	for (size_t i = 0; i < view_count; i++) {
+		_views.push_back({pickFreeContact(), 0});
+		events.push_back(viewEvent(Event::Type::view_open, _views.size()-1));
+	}
+
+	return events;
+}
+
+std::vector<WorkloadGenerator::Event> WorkloadGenerator::advance(uint64_t ts_now) {
+	std::vector<Event> events;
+	if (ts_now <= _ts_now) {
+		return events;
+	}
+
+	const float dt_ms = float(ts_now - _ts_now);
+	_ts_now = ts_now;
+
+	// poisson, for short steps it is mostly 0 or 1
+	for (size_t c = 0; c < _config.contacts; c++) {
+		std::poisson_distribution<size_t> count_dist{_msgs_per_ms[c] * dt_ms};
+		for (size_t n = count_dist(_rng); n > 0; n--) {
+			Event e;
+			e.type = Event::Type::message;
+			e.contact = c;
+			e.ts = ts_now;
+			e.outgoing = (_rng() % 2) == 0;
+			e.text = text();
+			events.push_back(std::move(e));
+			_contact_ts[c].push_back(ts_now);
+		}
+	}
+
+	std::uniform_real_distribution<float> chance{0.f, 1.f};
+	for (size_t view_i = 0; view_i < _views.size(); view_i++) {
+		auto& view = _views[view_i];
+
+		if (chance(_rng) < _config.view_switch_rate * dt_ms / 1000.f) {
+			events.push_back(viewEvent(Event::Type::view_close, view_i));
+			view.contact = pickFreeContact();
+			view.center = 0;
+			events.push_back(viewEvent(Event::Type::view_open, view_i));
+			continue;
+		}
+
+		if (chance(_rng) >= _config.scroll_rate * dt_ms / 1000.f) {
+			continue;
+		}
+
+		const auto& tss = _contact_ts.at(view.contact);
+		if (tss.empty()) {
+			continue;
+		}
+
+		if (chance(_rng) < _config.jump_chance) {
+			// onto a random message
+			view.center = tss.at(_rng() % tss.size());
+		} else {
+			// mostly back in time, like reading up
+			const uint64_t center = view.center == 0 ? _ts_now : view.center;
+			const uint64_t step = _config.view_span_ms/2;
+			if (_rng() % 4 != 0) {
+				view.center = center - std::min(center - std::min(center, tss.front()), step);
+			} else {
+				view.center = center + step >= _ts_now ? 0 : center + step;
+			}
+		}
+		events.push_back(viewEvent(Event::Type::view_move, view_i));
+	}
+
+	return events;
+}
+
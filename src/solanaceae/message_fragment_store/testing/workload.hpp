@@ -0,0 +1,105 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// synthetic chat usage, for load tests
+// deterministic for a given config (and seed), so runs can be compared
+struct WorkloadConfig {
+	uint64_t seed {1};
+
+	size_t contacts {20};
+
+	// live message rate of the busiest contact, the others fall off zipf like (rank^-zipf_s)
+	float max_msgs_per_hour {120.f};
+	float zipf_s {1.f};
+
+	// history already in storage when the session starts, at the same rates
+	float history_days {7.f};
+
+	// message text length, exponentially distributed
+	size_t text_size_mean {64};
+
+	// views (cursor pairs) open at the same time, on different contacts
+	size_t open_views {3};
+	// time range a view covers
+	uint64_t view_span_ms {30*60*1000};
+	// scroll steps per second, per view (each step moves about half a span)
+	float scroll_rate {0.5f};
+	// chance per step to jump somewhere random into the history instead
+	float jump_chance {0.05f};
+	// per second, a view moves to another contact (at the newest messages)
+	float view_switch_rate {0.05f};
+};
+
+class WorkloadGenerator {
+	public:
+		struct HistoryMessage {
+			uint64_t ts {0};
+			bool outgoing {false};
+			std::string text;
+		};
+
+		struct Event {
+			enum class Type : uint8_t {
+				message, // new live message
+				view_open,
+				view_move,
+				view_close,
+			} type {Type::message};
+
+			size_t contact {0};
+
+			// message
+			uint64_t ts {0};
+			bool outgoing {false};
+			std::string text;
+
+			// view, begin is the newer end
+			uint64_t view_ts_begin {0};
+			uint64_t view_ts_end {0};
+			// the view covers history messages, so something needs to get loaded
+			bool expects_messages {false};
+		};
+
+	private:
+		const WorkloadConfig _config;
+		std::mt19937_64 _rng;
+
+		std::vector<float> _msgs_per_ms; // per contact
+		// sorted timestamps of all messages of each contact (history and live), for expects_messages
+		std::vector<std::vector<uint64_t>> _contact_ts;
+
+		struct View {
+			size_t contact {0};
+			uint64_t center {0}; // 0 is "at the newest messages"
+		};
+		std::vector<View> _views;
+
+		uint64_t _ts_now {0};
+
+		std::string text(void);
+		bool expectsMessages(size_t contact, uint64_t ts_begin, uint64_t ts_end) const;
+		Event viewEvent(Event::Type type, size_t view_i);
+		size_t pickFreeContact(void);
+
+	public:
+		WorkloadGenerator(const WorkloadConfig& config, uint64_t ts_start);
+
+		const WorkloadConfig& config(void) const { return _config; }
+
+		// contact ids are derived from the seed and the index
+		std::vector<uint8_t> contactID(size_t contact) const;
+
+		// messages before ts_start, call once per contact, before any events
+		std::vector<HistoryMessage> history(size_t contact);
+
+		// opens the initial views
+		std::vector<Event> begin(void);
+
+		// everything that happens in (last ts_now, ts_now]
+		std::vector<Event> advance(uint64_t ts_now);
+};
+
@@ -0,0 +1,235 @@
+#include <solanaceae/contact/contact_store_impl.hpp>
+#include <solanaceae/object_store/object_store.hpp>
+#include <solanaceae/object_store/backends/filesystem_storage_atomic.hpp>
+#include <solanaceae/object_store/meta_components.hpp>
+#include <solanaceae/message_fragment_store/message_fragment_store.hpp>
+#include <solanaceae/message_fragment_store/fragment_codec.hpp>
+#include <solanaceae/message3/message_serializer.hpp>
+
+#include <solanaceae/message3/registry_message_model_impl.hpp>
+#include <solanaceae/message3/components.hpp>
+
+#include <solanaceae/util/utils.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <zdict.h>
+
+#include <entt/container/dense_map.hpp>
+#include <entt/core/type_info.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// trains zstd dictionaries on the fragments of an existing store
+// samples are transcoded to the version new fragments are written in (v2, or v3 with --v3, see MessageFragmentStore::setFragmentVersion())
+// writes <output_folder>/global.zdict and, with --per-contact, <output_folder>/<contact id hex>.zdict
+// the plugin picks them up from <store>.dicts/ (next to the store, not in it)
+
+struct Samples {
+	std::vector<uint8_t> data; // concatenated
+	std::vector<size_t> sizes;
+};
+
+static bool trainDict(const Samples& samples, size_t max_dict_size, const std::filesystem::path& path) {
+	if (samples.sizes.empty()) {
+		return false;
+	}
+
+	std::vector<uint8_t> dict(max_dict_size);
+	const size_t ret = ZDICT_trainFromBuffer(dict.data(), dict.size(), samples.data.data(), samples.sizes.data(), samples.sizes.size());
+	if (ZDICT_isError(ret)) {
+		std::cerr << "training " << path << " failed: " << ZDICT_getErrorName(ret) << "\n";
+		return false;
+	}
+	dict.resize(ret);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(dict.data()), dict.size());
+	if (!file.good()) {
+		std::cerr << "failed to write " << path << "\n";
+		return false;
+	}
+
+	std::cout << "wrote " << path << " (" << dict.size() << " bytes, id " << ZDICT_getDictID(dict.data(), dict.size()) << ", from " << samples.sizes.size() << " fragments)\n";
+	return true;
+}
+
+int main(int argc, const char** argv) {
+	if (argc < 3 || argc > 6) {
+		std::cerr << "wrong paramter count, do " << argv[0] << " <input_folder> <output_folder> [max_dict_size] [--per-contact] [--v3]\n";
+		return 1;
+	}
+
+	if (!std::filesystem::is_directory(argv[1])) {
+		std::cerr << "input folder is no folder\n";
+		return 1;
+	}
+
+	size_t max_dict_size {64*1024};
+	bool per_contact {false};
+	uint16_t target_version {2};
+	for (int i = 3; i < argc; i++) {
+		if (std::string_view{argv[i]} == "--per-contact") {
+			per_contact = true;
+		} else if (std::string_view{argv[i]} == "--v3") {
+			target_version = 3;
+		} else {
+			max_dict_size = std::stoull(argv[i]);
+		}
+	}
+
+	std::filesystem::create_directories(argv[2]);
+
+	ObjectStore2 os;
+	Backends::FilesystemStorageAtomic fsb(os, argv[1]);
+
+	ContactStore4Impl cs; // dummy
+	RegistryMessageModelImpl rmm(cs); // dummy
+	// they only exist for the serializers
+	MessageSerializerNJ msnj{cs, os, {}, {}};
+	MessageFragmentStore mfs(cs, rmm, os, fsb, fsb, msnj);
+
+	struct EventListener : public ObjectStoreEventI {
+		Backends::FilesystemStorageAtomic& _fsb;
+		const bool _per_contact;
+		const uint16_t _target_version;
+
+		Samples _global;
+		entt::dense_map<std::string, Samples> _contacts;
+		size_t _skipped {0};
+
+		MessagesMsgPackWriter _msgpack_writer;
+		MessagesColumnarWriter _columnar_writer;
+
+		// zstd recommends about 100x the dictionary size, more does not help much
+		static constexpr size_t max_sample_bytes {256*1024*1024};
+		// larger fragments compress fine on their own
+		static constexpr size_t max_fragment_bytes {128*1024};
+
+		EventListener(ObjectStore2& os, Backends::FilesystemStorageAtomic& fsb, bool per_contact, uint16_t target_version) : _fsb(fsb), _per_contact(per_contact), _target_version(target_version) {
+			os.subscribe(this, ObjectStore_Event::object_construct);
+			// like the mfs
+			_columnar_writer.setRowIndex(entt::type_hash<Message::Components::Timestamp>::value(), 64);
+		}
+
+		protected: // os
+			bool onEvent(const ObjectStore::Events::ObjectConstruct& e) override {
+				if (!e.e.all_of<ObjComp::MessagesVersion, ObjComp::MessagesContact>()) {
+					return false; // not a message fragment
+				}
+
+				if (e.e.all_of<ObjComp::MessagesDictionary>()) {
+					_skipped++; // already using one
+					return false;
+				}
+
+				if (_global.data.size() >= max_sample_bytes) {
+					_skipped++;
+					return false;
+				}
+
+				std::vector<uint8_t> data;
+				std::function<StorageBackendIAtomic::read_from_storage_put_data_cb> cb = [&data](const ByteSpan buffer) {
+					data.insert(data.end(), buffer.cbegin(), buffer.cend());
+				};
+				if (!static_cast<StorageBackendIAtomic&>(_fsb).read(e.e, cb)) {
+					std::cerr << "failed to read obj '" << bin2hex(e.e.get<ObjComp::ID>().v) << "'\n";
+					return false;
+				}
+
+				const auto version = e.e.get<ObjComp::MessagesVersion>().v;
+				if (version < 1 || version > 3) {
+					_skipped++;
+					return false;
+				}
+
+				if (version != _target_version) {
+					// train on what new fragments look like
+					DecodedMessages msgs;
+					if (!decodeMessages(version, ByteSpan{data}, msgs)) {
+						_skipped++;
+						return false;
+					}
+					data.clear();
+
+					// the writers can not stream, so we need to push into them manually
+					if (_target_version == 3) {
+						_columnar_writer.begin(msgs.entry_ends.size());
+					} else {
+						_msgpack_writer.beginArray(data, msgs.entry_ends.size());
+					}
+					size_t comp_i {0};
+					for (const size_t entry_end : msgs.entry_ends) {
+						if (_target_version == 3) {
+							_columnar_writer.beginEntry();
+						} else {
+							_msgpack_writer.beginEntry();
+						}
+						for (; comp_i < entry_end; comp_i++) {
+							const auto& comp = msgs.components.at(comp_i);
+							if (_target_version == 3) {
+								_columnar_writer.component(comp.type_id, comp.name, comp.value);
+							} else {
+								_msgpack_writer.component(comp.type_id, comp.name, comp.value);
+							}
+						}
+						if (_target_version == 3) {
+							_columnar_writer.endEntry();
+						} else {
+							_msgpack_writer.endEntry(data);
+						}
+					}
+					if (_target_version == 3) {
+						_columnar_writer.end(data);
+					}
+				}
+
+				if (data.size() <= 2 || data.size() > max_fragment_bytes) {
+					// empty, or too big
+					_skipped++;
+					return false;
+				}
+
+				const auto add = [&data](Samples& samples) {
+					samples.data.insert(samples.data.end(), data.cbegin(), data.cend());
+					samples.sizes.push_back(data.size());
+				};
+				add(_global);
+				if (_per_contact) {
+					add(_contacts[bin2hex(e.e.get<ObjComp::MessagesContact>().id)]);
+				}
+
+				return false;
+			}
+
+			bool onEvent(const ObjectStore::Events::ObjectUpdate&) override {
+				return false;
+			}
+	} el {os, fsb, per_contact, target_version};
+
+	// perform scan (which triggers events)
+	fsb.scanAsync();
+
+	std::cout << "collected " << el._global.sizes.size() << " fragments (" << el._global.data.size() << " bytes), skipped " << el._skipped << "\n";
+
+	const std::filesystem::path out_dir{argv[2]};
+	if (!trainDict(el._global, max_dict_size, out_dir / "global.zdict")) {
+		return 2;
+	}
+
+	for (const auto& [contact_hex, samples] : el._contacts) {
+		// not worth it for small contacts, they use the global one
+		if (samples.data.size() < 10*max_dict_size) {
+			continue;
+		}
+
+		trainDict(samples, max_dict_size, out_dir / (contact_hex + ".zdict"));
+	}
+
+	return 0;
+}
+
@@ -0,0 +1,71 @@
+#include "./test_session.hpp"
+
+#include <solanaceae/util/utils.hpp>
+#include <solanaceae/util/time.hpp>
+
+#include <filesystem>
+#include <fstream>
+
+// the catalog is only used while the store directories are unchanged,
+// otherwise the caller has to scan
+
+int main(void) {
+	const auto dir = std::filesystem::temp_directory_path() / ("mfs_catalog_stale_test_" + std::to_string(getTimeMS()));
+	// the backend concatenates
+	const std::string store_path = (dir / "store").generic_string() + "/";
+	auto catalog_path = dir / "store";
+	catalog_path += ".catalog";
+
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir);
+
+	const uint64_t ts0 = getTimeMS() - 60*60*1000;
+
+	std::vector<uint8_t> frag_id;
+	{ // write a fragment, the catalog is saved on destruction
+		FilesystemTestSession s{store_path};
+		s.mfs.enableCatalog(catalog_path, store_path);
+		CHECK(!s.mfs.loadCatalog()); // first run
+
+		Message3 first {entt::null};
+		for (size_t i = 0; i < 8; i++) {
+			const auto m = s.addMessage(ts0 + i*1000, "message number " + std::to_string(i));
+			if (i == 0) {
+				first = m;
+			}
+		}
+		frag_id = s.fragmentID(first);
+		CHECK(!frag_id.empty());
+		s.mfs.flush();
+	}
+	CHECK(std::filesystem::exists(catalog_path));
+
+	{ // unchanged, so it is used
+		FilesystemTestSession s{store_path};
+		s.mfs.enableCatalog(catalog_path, store_path);
+		CHECK(s.mfs.loadCatalog());
+		CHECK(s.os.registry().view<ObjComp::ID>().size() == 1);
+	}
+	CHECK(std::filesystem::exists(catalog_path));
+
+	{ // eg. another tool adds a file to the fragment's directory
+		const auto frag_dir = std::filesystem::path{store_path + bin2hex(frag_id).substr(0, 2)};
+		CHECK(std::filesystem::is_directory(frag_dir));
+		std::ofstream{frag_dir / "other_file"} << "other\n";
+		// dont depend on the mtime resolution
+		std::filesystem::last_write_time(frag_dir, std::filesystem::last_write_time(frag_dir) + std::chrono::seconds{2});
+	}
+
+	{ // stale, the caller has to scan
+		FilesystemTestSession s{store_path};
+		s.mfs.enableCatalog(catalog_path, store_path);
+		CHECK(!s.mfs.loadCatalog());
+		CHECK(s.os.registry().view<ObjComp::ID>().size() == 0);
+		CHECK(!std::filesystem::exists(catalog_path));
+	}
+
+	std::filesystem::remove_all(dir);
+
+	return 0;
+}
+
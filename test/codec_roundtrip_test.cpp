@@ -0,0 +1,102 @@
+#include "./test_codec.hpp"
+
+#include <limits>
+
+// v3 (columnar) gives the same component stream as v2 (msgpack),
+// for every column kind, with and without gaps
+
+static nlohmann::json testMessages(void) {
+	auto messages = nlohmann::json::array();
+	for (uint64_t i = 0; i < 37; i++) {
+		auto msg = nlohmann::json::object();
+
+		// kind 2, not monotonic
+		msg["Timestamp"] = {{"ts", 1700000000000ull + ((i * 7919) % 37) * 1000}};
+
+		// kind 1, with large values (the deltas wrap)
+		const uint64_t counters[] {0, 1, std::numeric_limits<uint64_t>::max(), 42, std::numeric_limits<uint64_t>::max() - 1, uint64_t(1) << 63};
+		msg["Counter"] = counters[i % std::size(counters)];
+
+		// signed, so kind 0
+		msg["Signed"] = i % 2 == 0 ? int64_t(-1) * int64_t(i) : std::numeric_limits<int64_t>::min() + int64_t(i);
+
+		// single member, but not an unsigned integer
+		msg["Reaction"] = {{"emoji", "+" + std::to_string(i)}};
+
+		// single member unsigned, but the key changes, so kind 0
+		msg[i < 20 ? "Unread" : "Read"] = {{i < 20 ? "count" : "at", i}};
+
+		if (i % 3 != 0) {
+			// gaps, present bitmap
+			msg["MessageText"] = {{"text", "text " + std::to_string(i)}};
+		}
+		if (i == 5 || i == 36) {
+			// only two, in different bitmap bytes
+			msg["Edited"] = {{"ts", i}, {"by", "someone"}};
+		}
+		if (i > 8) {
+			// missing from the first byte of the bitmap
+			msg["Float"] = 0.5 * double(i);
+		}
+
+		messages.push_back(std::move(msg));
+	}
+
+	// no components at all
+	messages.push_back(nlohmann::json::object());
+
+	return messages;
+}
+
+int main(void) {
+	const auto messages = testMessages();
+	const auto expected = expectedMessages(messages);
+
+	DecodedMessages v2;
+	CHECK(decodeMessages(2, ByteSpan{encodeV2(messages)}, v2));
+	CHECK(sameMessages(v2, expected));
+	CHECK(v2.has_message_count && v2.message_count == messages.size());
+
+	const auto v3_data = encodeV3(messages);
+
+	DecodedMessages v3;
+	CHECK(decodeMessages(3, ByteSpan{v3_data}, v3));
+	CHECK(sameMessages(v3, v2));
+	CHECK(v3.has_message_count && v3.message_count == messages.size());
+
+	{ // the column decoder, every column
+		DecodedMessages v3_columns;
+		CHECK(decodeMessageColumns(ByteSpan{v3_data}, v3_columns, [](entt::id_type, std::string_view) { return true; }));
+		CHECK(sameMessages(v3_columns, v2));
+	}
+
+	{ // skipping columns is the same as the messages without them
+		auto messages_without = messages;
+		for (auto& msg : messages_without) {
+			msg.erase("MessageText");
+			msg.erase("Counter");
+		}
+
+		DecodedMessages v3_columns;
+		CHECK(decodeMessageColumns(ByteSpan{v3_data}, v3_columns, [](entt::id_type, std::string_view name) {
+			return name != "MessageText" && name != "Counter";
+		}));
+		CHECK(sameMessages(v3_columns, expectedMessages(messages_without)));
+	}
+
+	{ // empty
+		DecodedMessages v3_empty;
+		CHECK(decodeMessages(3, ByteSpan{encodeV3(nlohmann::json::array())}, v3_empty));
+		CHECK(v3_empty.entry_ends.empty());
+	}
+
+	{ // truncated data is an error
+		auto v3_truncated = v3_data;
+		v3_truncated.resize(v3_truncated.size() - 3);
+		DecodedMessages v3_broken;
+		CHECK(!decodeMessages(3, ByteSpan{v3_truncated}, v3_broken));
+	}
+
+	return 0;
+}
+
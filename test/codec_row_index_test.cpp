@@ -0,0 +1,164 @@
+#include "./test_codec.hpp"
+
+#include <algorithm>
+
+// v3 row index: a view load decodes exactly the rows the index names for the view,
+// the rest load decodes the others, together they are the whole fragment
+
+static constexpr size_t interval {64};
+static constexpr size_t message_count {200}; // last checkpoint block is not full
+
+// sorted, two messages per timestamp, so equal timestamps straddle the checkpoints (63/64)
+static uint64_t messageTS(size_t i) {
+	return 100000 + 1000 * ((i+1)/2);
+}
+
+static nlohmann::json testMessages(void) {
+	auto messages = nlohmann::json::array();
+	for (size_t i = 0; i < message_count; i++) {
+		auto msg = nlohmann::json::object();
+		msg["Timestamp"] = {{"ts", messageTS(i)}};
+		if (i % 5 != 0) {
+			msg["MessageText"] = {{"text", "text " + std::to_string(i)}};
+		}
+		msg["Counter"] = i * 3;
+		messages.push_back(std::move(msg));
+	}
+	return messages;
+}
+
+// appends the entries [entry_begin, entry_end) of from
+static void appendEntries(const DecodedMessages& from, size_t entry_begin, size_t entry_end, DecodedMessages& to) {
+	for (size_t entry = entry_begin; entry < entry_end; entry++) {
+		to.beginEntry();
+		for (size_t i = entry == 0 ? 0 : from.entry_ends.at(entry-1); i < from.entry_ends.at(entry); i++) {
+			const auto& comp = from.components.at(i);
+			to.component(comp.type_id, comp.name, comp.value);
+		}
+		to.endEntry();
+	}
+}
+
+static int checkView(const nlohmann::json& messages, const std::vector<uint8_t>& data, const DecodedMessages& full, uint64_t ts_lo, uint64_t ts_hi) {
+	MessageRows rows;
+	CHECK(messageRowsForRange(ByteSpan{data}, ts_lo, ts_hi, rows));
+	CHECK(rows.total == message_count);
+	CHECK(rows.begin < rows.end);
+	CHECK(rows.begin % interval == 0);
+	CHECK(rows.end % interval == 0 || rows.end == rows.total);
+	CHECK(rows.covers(ts_lo, ts_hi));
+
+	// every message of the view is in the rows, and the ts_after/ts_before promise holds
+	for (size_t i = 0; i < message_count; i++) {
+		const uint64_t ts = messageTS(i);
+		const bool in_rows = i >= rows.begin && i < rows.end;
+		if (ts >= ts_lo && ts <= ts_hi) {
+			CHECK(in_rows);
+		}
+		if ((rows.begin == 0 || ts > rows.ts_after) && (rows.end == rows.total || ts < rows.ts_before)) {
+			CHECK(in_rows);
+		}
+	}
+
+	FragmentSlice view_slice;
+	view_slice.mode = FragmentSlice::Mode::view;
+	view_slice.ts_lo = ts_lo;
+	view_slice.ts_hi = ts_hi;
+
+	DecodedMessages view;
+	MessageRows loaded_rows;
+	CHECK(decodeFragmentSlice(3, ByteSpan{data}, view_slice, view, loaded_rows));
+
+	if (!rows.partial()) {
+		// everything, not marked partial
+		CHECK(loaded_rows.total == 0);
+		CHECK(sameMessages(view, full));
+		return 0;
+	}
+
+	// exactly the rows
+	CHECK(loaded_rows == rows);
+	CHECK(sameMessages(view, expectedMessages(messages, rows.begin, rows.end)));
+
+	FragmentSlice rest_slice;
+	rest_slice.mode = FragmentSlice::Mode::rest;
+	rest_slice.loaded = loaded_rows;
+
+	DecodedMessages rest;
+	MessageRows rest_rows;
+	CHECK(decodeFragmentSlice(3, ByteSpan{data}, rest_slice, rest, rest_rows));
+	CHECK(rest_rows.total == 0);
+	CHECK(rest.entry_ends.size() == message_count - (rows.end - rows.begin));
+
+	// the complement, in order
+	DecodedMessages before_and_after;
+	appendEntries(full, 0, rows.begin, before_and_after);
+	appendEntries(full, rows.end, message_count, before_and_after);
+	CHECK(sameMessages(rest, before_and_after));
+
+	// and together the full decode
+	DecodedMessages joined;
+	appendEntries(rest, 0, rows.begin, joined);
+	appendEntries(view, 0, rows.end - rows.begin, joined);
+	appendEntries(rest, rows.begin, rest.entry_ends.size(), joined);
+	CHECK(sameMessages(joined, full));
+
+	return 0;
+}
+
+int main(void) {
+	const auto messages = testMessages();
+	const auto data = encodeV3(messages, "Timestamp", interval);
+
+	DecodedMessages full;
+	CHECK(decodeMessages(3, ByteSpan{data}, full));
+	CHECK(sameMessages(full, expectedMessages(messages)));
+
+	// every checkpoint ts (and its neighbours) as either end of the view,
+	// plus views before and after all messages
+	std::vector<uint64_t> edges {0, messageTS(0) - 1, messageTS(message_count-1) + 1, UINT64_MAX};
+	for (size_t cp_row = 0; cp_row < message_count; cp_row += interval) {
+		for (const size_t row : {cp_row - (cp_row > 0 ? 1 : 0), cp_row, cp_row + 1}) {
+			edges.push_back(messageTS(row) - 1);
+			edges.push_back(messageTS(row));
+			edges.push_back(messageTS(row) + 1);
+		}
+	}
+	edges.push_back(messageTS(message_count-1));
+	std::sort(edges.begin(), edges.end());
+	edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+	for (const uint64_t ts_lo : edges) {
+		for (const uint64_t ts_hi : edges) {
+			if (ts_lo > ts_hi) {
+				continue;
+			}
+			if (checkView(messages, data, full, ts_lo, ts_hi) != 0) {
+				std::cerr << "for view " << ts_lo << "-" << ts_hi << "\n";
+				return 1;
+			}
+		}
+	}
+
+	{ // unsorted timestamps get no index, the view loads everything
+		auto unsorted = messages;
+		std::swap(unsorted.at(10), unsorted.at(150));
+		const auto unsorted_data = encodeV3(unsorted, "Timestamp", interval);
+
+		MessageRows rows;
+		CHECK(!messageRowsForRange(ByteSpan{unsorted_data}, messageTS(0), messageTS(5), rows));
+
+		FragmentSlice view_slice;
+		view_slice.mode = FragmentSlice::Mode::view;
+		view_slice.ts_lo = messageTS(0);
+		view_slice.ts_hi = messageTS(5);
+		DecodedMessages view;
+		MessageRows loaded_rows;
+		CHECK(decodeFragmentSlice(3, ByteSpan{unsorted_data}, view_slice, view, loaded_rows));
+		CHECK(loaded_rows.total == 0);
+		CHECK(sameMessages(view, expectedMessages(unsorted)));
+	}
+
+	return 0;
+}
+
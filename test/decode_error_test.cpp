@@ -0,0 +1,165 @@
+#include "./test_session.hpp"
+
+#include <solanaceae/util/time.hpp>
+
+#include <algorithm>
+
+// a fragment that can only be decoded partially (eg. torn write) is shown,
+// but never written back, which would drop the messages we could not decode
+
+static std::string messageText(size_t i) {
+	return "message number " + std::to_string(i) + ", long enough to span some bytes";
+}
+
+// writes one fragment with messages 1s apart, returns its id
+static std::vector<uint8_t> writeFragment(std::shared_ptr<Backends::MemoryStorage::Device> device, uint16_t version, uint64_t ts0, size_t message_count) {
+	MemoryTestSession s{std::move(device)};
+	s.mfs.setFragmentVersion(version);
+	Message3 first {entt::null};
+	for (size_t i = 0; i < message_count; i++) {
+		const auto m = s.addMessage(ts0 + i*1000, messageText(i));
+		if (i == 0) {
+			first = m;
+		}
+	}
+	const auto frag_id = s.fragmentID(first);
+	s.mfs.flush();
+	return frag_id;
+}
+
+// changes the text of one loaded message
+static void editOneMessage(MemoryTestSession& s) {
+	for (auto [m, text] : s.reg().view<Message::Components::MessageText>().each()) {
+		text.text += " (edited)";
+		s.rmm.throwEventUpdate(s.reg(), m);
+		break;
+	}
+}
+
+static int truncatedV2(void) {
+	auto device = std::make_shared<Backends::MemoryStorage::Device>();
+
+	constexpr size_t message_count {32};
+	const uint64_t ts0 = getTimeMS() - 60*60*1000;
+	const uint64_t ts_last = ts0 + (message_count-1)*1000;
+
+	const auto frag_id = writeFragment(device, 2, ts0, message_count);
+	CHECK(!frag_id.empty());
+	CHECK(device->objectCount() == 1);
+
+	// cut off the second half of the messages
+	CHECK(device->modifyData(frag_id, [](std::vector<uint8_t>& data) { data.resize(data.size()/2); }));
+
+	std::chrono::steady_clock::time_point write_before;
+	CHECK(device->lastWrite(frag_id, write_before));
+	std::vector<uint8_t> data_before;
+	CHECK(device->storedData(frag_id, data_before));
+
+	{ // load it, and do everything that could rewrite it
+		MemoryTestSession s{device};
+		s.mfs.setFragmentVersion(2);
+		FragmentCompactionPolicy compaction;
+		compaction.small_messages = 1000; // merge anything
+		compaction.target_messages = 1000;
+		s.mfs.setCompactionPolicy(compaction);
+
+		s.backend.scan();
+		s.openView(ts_last + 1000, ts0 - 1000);
+		s.tick(16);
+
+		// the decodable prefix is shown
+		const size_t loaded = s.messageCount();
+		CHECK(loaded > 0);
+		CHECK(loaded < message_count);
+
+		editOneMessage(s);
+
+		// a new message in the same range ends up in a new fragment, which compaction would like to merge
+		s.addMessage(ts0 + 500, "new message");
+		s.mfs.flush();
+		s.tick(16); // idle time compaction
+
+		// destruction flushes too
+	}
+
+	std::chrono::steady_clock::time_point write_after;
+	CHECK(device->lastWrite(frag_id, write_after));
+	CHECK(write_after == write_before);
+	std::vector<uint8_t> data_after;
+	CHECK(device->storedData(frag_id, data_after));
+	CHECK(data_after == data_before);
+
+	// the new message was still saved
+	CHECK(device->objectCount() == 2);
+
+	return 0;
+}
+
+// only the rows of a view are loaded, the broken part is in the rest,
+// which is only loaded (and found broken) by the save on shutdown
+static int tornPartialV3(void) {
+	auto device = std::make_shared<Backends::MemoryStorage::Device>();
+
+	constexpr size_t message_count {200}; // row index every 64
+	const uint64_t ts0 = getTimeMS() - 60*60*1000;
+
+	const auto frag_id = writeFragment(device, 3, ts0, message_count);
+	CHECK(!frag_id.empty());
+	CHECK(device->objectCount() == 1);
+
+	// break the text of a message far from the view
+	// (its msgpack str8 header becomes the never used 0xc1)
+	CHECK(device->modifyData(frag_id, [](std::vector<uint8_t>& data) {
+		const auto text = messageText(190);
+		const auto it = std::search(data.begin(), data.end(), text.cbegin(), text.cend());
+		if (it - data.begin() >= 2 && *(it-2) == 0xd9) {
+			*(it-2) = 0xc1;
+		}
+	}));
+
+	std::chrono::steady_clock::time_point write_before;
+	CHECK(device->lastWrite(frag_id, write_before));
+	std::vector<uint8_t> data_before;
+	CHECK(device->storedData(frag_id, data_before));
+
+	{
+		MemoryTestSession s{device};
+		s.mfs.setFragmentVersion(3);
+
+		s.backend.scan();
+		s.openView(ts0 + 20*1000, ts0 - 1000);
+		s.tick(16);
+
+		// only the first checkpoint interval
+		const size_t loaded = s.messageCount();
+		CHECK(loaded > 0);
+		CHECK(loaded < 190);
+
+		// queued, saving it needs the rest
+		editOneMessage(s);
+
+		// destruction flushes
+	}
+
+	std::chrono::steady_clock::time_point write_after;
+	CHECK(device->lastWrite(frag_id, write_after));
+	CHECK(write_after == write_before);
+	std::vector<uint8_t> data_after;
+	CHECK(device->storedData(frag_id, data_after));
+	CHECK(data_after == data_before);
+
+	return 0;
+}
+
+int main(void) {
+	if (truncatedV2() != 0) {
+		return 1;
+	}
+
+	if (tornPartialV3() != 0) {
+		return 1;
+	}
+
+	return 0;
+}
+
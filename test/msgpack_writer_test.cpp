@@ -0,0 +1,118 @@
+#include "./test_check.hpp"
+
+#include <solanaceae/message_fragment_store/fragment_codec.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// v2 fragments are written entry by entry, the bytes have to be the same as
+// nlohmann::json::to_msgpack() of the whole array, for every header size class
+
+// one writer for all cases, so its key cache is reused.
+// ids are handed out per name, 65536 hashed names would likely collide
+struct TestWriter {
+	MessagesMsgPackWriter writer;
+	std::map<std::string, entt::id_type> ids;
+
+	// reversed gives the writer the components against the name order
+	std::vector<uint8_t> encode(const nlohmann::json& messages, bool reversed) {
+		std::vector<uint8_t> out;
+		writer.beginArray(out, messages.size());
+		for (const auto& msg : messages) {
+			std::vector<std::pair<const std::string*, const nlohmann::json*>> comps;
+			for (auto it = msg.cbegin(); it != msg.cend(); it++) {
+				const auto [id_it, _] = ids.emplace(it.key(), entt::id_type(ids.size()+1));
+				comps.emplace_back(&id_it->first, &it.value());
+			}
+			if (reversed) {
+				std::reverse(comps.begin(), comps.end());
+			}
+
+			writer.beginEntry();
+			for (const auto& [name, value] : comps) {
+				writer.component(ids.at(*name), *name, *value);
+			}
+			writer.endEntry(out);
+		}
+		return out;
+	}
+};
+
+static int sameAsToMsgPack(TestWriter& w, const nlohmann::json& messages, bool reversed = false) {
+	const auto expected = nlohmann::json::to_msgpack(messages);
+	const auto written = w.encode(messages, reversed);
+	if (written != expected) {
+		size_t i = 0;
+		while (i < written.size() && i < expected.size() && written.at(i) == expected.at(i)) {
+			i++;
+		}
+		std::cerr << "different bytes at " << i << " of " << written.size() << " vs " << expected.size() << "\n";
+		return 1;
+	}
+	return 0;
+}
+
+static nlohmann::json messageWithComponents(size_t count) {
+	auto msg = nlohmann::json::object();
+	for (size_t i = 0; i < count; i++) {
+		msg["Comp" + std::to_string(i)] = i;
+	}
+	return msg;
+}
+
+int main(void) {
+	TestWriter w;
+
+	// message counts: fixarray, array16, array32
+	for (const size_t message_count : {0, 1, 15, 16, 65535, 65536}) {
+		auto messages = nlohmann::json::array();
+		for (size_t i = 0; i < message_count; i++) {
+			messages.push_back({{"MessageText", {{"text", "m" + std::to_string(i)}}}, {"Timestamp", {{"ts", i}}}});
+		}
+		if (sameAsToMsgPack(w, messages) != 0) {
+			std::cerr << "for " << message_count << " messages\n";
+			return 1;
+		}
+	}
+
+	// components per message: fixmap, map16, map32
+	for (const size_t component_count : {0, 1, 15, 16, 65535, 65536}) {
+		if (sameAsToMsgPack(w, nlohmann::json::array({messageWithComponents(component_count)})) != 0) {
+			std::cerr << "for " << component_count << " components\n";
+			return 1;
+		}
+	}
+
+	{ // names and values of every size class and type
+		auto msg = nlohmann::json::object();
+		for (const size_t name_size : {1, 31, 32, 255, 256, 65535, 65536}) {
+			msg[std::string(name_size, 'N')] = std::string(name_size, 'v');
+		}
+		msg["Null"] = nullptr;
+		msg["Bool"] = {{"a", true}, {"b", false}};
+		msg["Signed"] = {-1, -32, -33, -128, -129, -32768, -32769, INT64_MIN};
+		msg["Unsigned"] = {0, 127, 128, 255, 256, 65535, 65536, UINT32_MAX, uint64_t(UINT32_MAX)+1, UINT64_MAX};
+		msg["Float"] = 0.1;
+		msg["Binary"] = nlohmann::json::binary({1, 2, 3, 4});
+		msg["Nested"] = {{"array", nlohmann::json::array({1, "two", nlohmann::json::object()})}, {"object", messageWithComponents(20)}};
+
+		const auto messages = nlohmann::json::array({msg, messageWithComponents(3), msg});
+		if (sameAsToMsgPack(w, messages) != 0) {
+			std::cerr << "for mixed names and values\n";
+			return 1;
+		}
+		if (sameAsToMsgPack(w, messages, true) != 0) {
+			std::cerr << "for mixed names and values, reversed\n";
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
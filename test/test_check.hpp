@@ -0,0 +1,12 @@
+#pragma once
+
+#include <iostream>
+
+// for int returning test functions
+#define CHECK(cond) do { \
+		if (!(cond)) { \
+			std::cerr << __FILE__ << ":" << __LINE__ << " check failed: " #cond "\n"; \
+			return 1; \
+		} \
+	} while (false)
+
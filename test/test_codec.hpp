@@ -0,0 +1,88 @@
+#pragma once
+
+#include "./test_check.hpp"
+
+#include <solanaceae/message_fragment_store/fragment_codec.hpp>
+
+#include <entt/core/hashed_string.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// messages are given as a json array of objects (component name -> value),
+// the writers get the components in name order, like the mfs serializes them
+
+inline entt::id_type componentTypeID(std::string_view name) {
+	return entt::hashed_string::value(name.data(), name.size());
+}
+
+inline std::vector<uint8_t> encodeV2(const nlohmann::json& messages) {
+	MessagesMsgPackWriter writer;
+	std::vector<uint8_t> out;
+	writer.beginArray(out, messages.size());
+	for (const auto& msg : messages) {
+		writer.beginEntry();
+		for (const auto& [name, value] : msg.items()) {
+			writer.component(componentTypeID(name), name, value);
+		}
+		writer.endEntry(out);
+	}
+	return out;
+}
+
+// index_interval 0 is no row index
+inline std::vector<uint8_t> encodeV3(const nlohmann::json& messages, std::string_view ts_name = {}, size_t index_interval = 0) {
+	MessagesColumnarWriter writer;
+	if (index_interval != 0) {
+		writer.setRowIndex(componentTypeID(ts_name), index_interval);
+	}
+	std::vector<uint8_t> out;
+	writer.begin(messages.size());
+	for (const auto& msg : messages) {
+		writer.beginEntry();
+		for (const auto& [name, value] : msg.items()) {
+			writer.component(componentTypeID(name), name, value);
+		}
+		writer.endEntry();
+	}
+	writer.end(out);
+	return out;
+}
+
+// what a decoder should pass to the sink
+inline DecodedMessages expectedMessages(const nlohmann::json& messages, size_t begin = 0, size_t end = SIZE_MAX) {
+	DecodedMessages expected;
+	for (size_t i = begin; i < messages.size() && i < end; i++) {
+		expected.beginEntry();
+		for (const auto& [name, value] : messages.at(i).items()) {
+			expected.component(componentTypeID(name), name, value);
+		}
+		expected.endEntry();
+	}
+	return expected;
+}
+
+// prints the first difference
+inline bool sameMessages(const DecodedMessages& lhs, const DecodedMessages& rhs) {
+	if (lhs.entry_ends != rhs.entry_ends) {
+		std::cerr << "different entries: " << lhs.entry_ends.size() << " vs " << rhs.entry_ends.size() << " messages\n";
+		return false;
+	}
+
+	for (size_t i = 0; i < lhs.components.size(); i++) {
+		const auto& l = lhs.components.at(i);
+		const auto& r = rhs.components.at(i);
+		if (l.type_id != r.type_id || l.name != r.name || l.value != r.value) {
+			std::cerr << "different component " << i << ": " << l.name << "=" << l.value.dump() << " vs " << r.name << "=" << r.value.dump() << "\n";
+			return false;
+		}
+	}
+
+	return true;
+}
+
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "./test_check.hpp"
+
+#include <solanaceae/contact/contact_store_impl.hpp>
+#include <solanaceae/contact/components.hpp>
+#include <solanaceae/object_store/object_store.hpp>
+#include <solanaceae/object_store/meta_components.hpp>
+#include <solanaceae/object_store/backends/filesystem_storage_atomic.hpp>
+#include <solanaceae/message_fragment_store/message_fragment_store.hpp>
+#include <solanaceae/message_fragment_store/testing/memory_storage.hpp>
+#include <solanaceae/message3/message_serializer.hpp>
+#include <solanaceae/message3/registry_message_model_impl.hpp>
+#include <solanaceae/message3/components.hpp>
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+// one contact and an mfs on a backend (constructed with os + args)
+// sessions on the same storage are like app restarts
+template<typename Backend>
+struct TestSession {
+	ContactStore4Impl cs;
+	const Contact4 self;
+	const Contact4 contact;
+	RegistryMessageModelImpl rmm{cs};
+	ObjectStore2 os;
+	Backend backend;
+	MessageSerializerNJ msnj{cs, os, {}, {}};
+	MessageFragmentStore mfs;
+
+	Message3 view_begin {entt::null};
+	Message3 view_end {entt::null};
+
+	static Contact4 createContact(ContactStore4Impl& cs, uint8_t id_byte) {
+		// before the mfs, it only gets events for later ones
+		const auto c = cs.registry().create();
+		cs.registry().emplace<Contact::Components::ID>(c, std::vector<uint8_t>(32, id_byte));
+		return c;
+	}
+
+	template<typename... Args>
+	explicit TestSession(Args&&... args) :
+		self(createContact(cs, 0x42)),
+		contact(createContact(cs, 0x23)),
+		backend(os, std::forward<Args>(args)...),
+		mfs(cs, rmm, os, backend, backend, msnj)
+	{
+		registerMessageComponents(msnj);
+		mfs.setLogLevel(MessageFragmentStore::LogLevel::warning);
+	}
+
+	Message3Registry& reg(void) {
+		return *rmm.get(contact);
+	}
+
+	Message3 addMessage(uint64_t ts, const std::string& text) {
+		auto& msg_reg = reg();
+		const auto m = msg_reg.create();
+		msg_reg.emplace<Message::Components::Timestamp>(m, ts);
+		msg_reg.emplace<Message::Components::ContactFrom>(m, contact);
+		msg_reg.emplace<Message::Components::ContactTo>(m, self);
+		msg_reg.emplace<Message::Components::MessageText>(m, text);
+		rmm.throwEventConstruct(msg_reg, m);
+		return m;
+	}
+
+	// ts_begin is the newer end
+	void openView(uint64_t ts_begin, uint64_t ts_end) {
+		auto& msg_reg = reg();
+		view_begin = msg_reg.create();
+		view_end = msg_reg.create();
+		msg_reg.emplace<Message::Components::Timestamp>(view_begin, ts_begin);
+		msg_reg.emplace<Message::Components::ViewCurserBegin>(view_begin, view_end);
+		msg_reg.emplace<Message::Components::Timestamp>(view_end, ts_end);
+		msg_reg.emplace<Message::Components::ViewCurserEnd>(view_end, view_begin);
+		rmm.throwEventConstruct(msg_reg, view_begin);
+		rmm.throwEventConstruct(msg_reg, view_end);
+	}
+
+	void tick(size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			mfs.tick(0.f);
+		}
+	}
+
+	size_t messageCount(void) {
+		return reg().view<Message::Components::MessageText>().size();
+	}
+
+	// of the message's fragment, empty if it has none
+	std::vector<uint8_t> fragmentID(Message3 m) {
+		auto& msg_reg = reg();
+		if (!msg_reg.valid(m) || !msg_reg.all_of<Message::Components::MFSObj>(m)) {
+			return {};
+		}
+		const auto fh = os.objectHandle(msg_reg.get<Message::Components::MFSObj>(m).o);
+		if (!static_cast<bool>(fh) || !fh.all_of<ObjComp::ID>()) {
+			return {};
+		}
+		return fh.get<ObjComp::ID>().v;
+	}
+};
+
+using MemoryTestSession = TestSession<Backends::MemoryStorage>;
+using FilesystemTestSession = TestSession<Backends::FilesystemStorageAtomic>;
+